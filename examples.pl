@@ -12,7 +12,27 @@ for $file (<examples/*>){
 		if($diff){
 			print "Test file $file differs\n$diff";
 		}
+
+		# The same trace converted to the binary format must give the same results
+		`./csv2trace examples/proc$1.csv output.trace > /dev/null`;
+		`./simulator -c $2 -s $3 output.trace | tail -7 > output1`;
+		$diff = `diff output1 output2`;
+		if($diff){
+			print "Test file $file differs with a binary trace\n$diff";
+		}
+	}
+}
+
+# Streaming (-l) must give the same results as loading the whole trace.  The
+# trace has simultaneous arrivals after jobs have finished; one core, so no two
+# jobs finish in the same time unit.
+for $scheme ("fcfs", "sjf", "psjf", "pri", "ppri", "rr1", "rr2", "rr4"){
+	`./simulator -c 1 -s $scheme examples/burst.csv | tail -n +2 > output1`;
+	`./simulator -c 1 -s $scheme -l examples/burst.csv | tail -n +2 > output2`;
+	$diff = `diff output1 output2`;
+	if($diff){
+		print "Scheme $scheme differs when streaming examples/burst.csv\n$diff";
 	}
 }
 #cleanup
-`rm output1 output2`;
+`rm output1 output2 output.trace`;
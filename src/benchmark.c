@@ -0,0 +1,416 @@
+/** @file benchmark.c
+ *  @brief Micro-benchmarks of libpriqueue and end-to-end timings of every scheme
+ *
+ *  Every result is printed and also written as one CSV line of
+ *  suite,name,variant,size,operation,count,seconds,per_second,p50_ns,p99_ns,max_ns
+ *  so that runs can be compared with each other.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "libmetrics/libmetrics.h"
+#include "libpriqueue/libpriqueue.h"
+#include "libtrace/libtrace.h"
+#include "libworkload/libworkload.h"
+
+/* Operations timed on every queue, in the order they are run */
+enum { OP_OFFER = 0, OP_AT, OP_REMOVE, OP_POLL, OP_COUNT };
+
+/* Number of priqueue_at() and priqueue_remove() calls timed per queue, at most */
+#define AT_SAMPLES 1000
+#define REMOVE_SAMPLES 100
+
+typedef struct _op_timing_t {
+  long count;
+  double seconds;
+  histogram_t latency;  // nanoseconds per call, only filled in by the timed pass
+} op_timing_t;
+
+typedef struct _bench_options_t {
+  long max_size;       // largest queue
+  long max_list_size;  // largest PRIQUEUE_LIST queue, whose offers are O(n)
+  int *cores;
+  int core_count;
+  int jobs;  // jobs per generated trace
+  int quantum;
+  char *simulator;
+  FILE *csv;
+} bench_options_t;
+
+void print_usage(char *program_name) {
+  fprintf(stderr,
+          "Usage: %s [-n <max size>] [-l <max list size>] [-c <cores>] [-j <jobs>] [-q <quantum>] [-s <simulator>] "
+          "[-o <file>]\n",
+          program_name);
+  fprintf(stderr, "\n");
+  fprintf(stderr, "  -n  time queues of 10, 100, ... up to this many elements (default: 1000000)\n");
+  fprintf(stderr, "  -l  largest PRIQUEUE_LIST queue, whose offers are O(n) (default: 10000)\n");
+  fprintf(stderr, "  -c  comma separated core counts to time every scheme on (default: 1,4,16)\n");
+  fprintf(stderr, "  -j  number of jobs of each generated trace (default: 1000000)\n");
+  fprintf(stderr, "  -q  quantum of RR and of the top level of MLFQ (default: 4)\n");
+  fprintf(stderr, "  -s  simulator to time (default: ./simulator)\n");
+  fprintf(stderr, "  -o  write the results as CSV to <file> (default: bench.csv)\n");
+}
+
+/*
+ * Returns the time of a monotonic clock in nanoseconds.
+ */
+static inline uint64_t now_ns() {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (uint64_t)now.tv_sec * 1000000000 + now.tv_nsec;
+}
+
+/*
+ * Returns the next number of a xorshift generator, so that every run times
+ * the same keys.
+ */
+static inline uint64_t next_random(uint64_t *state) {
+  *state ^= *state << 13;
+  *state ^= *state >> 7;
+  *state ^= *state << 17;
+  return *state;
+}
+
+int compare_keys(const void *a, const void *b) {
+  return (*(const int *)a > *(const int *)b) - (*(const int *)a < *(const int *)b);
+}
+
+/*
+ * Writes one result as a line of the CSV file and prints it.  latency may be
+ * NULL for results without per-call timings.
+ */
+void report(bench_options_t *options,
+            const char *suite,
+            const char *name,
+            const char *variant,
+            long size,
+            const char *operation,
+            long count,
+            double seconds,
+            const histogram_t *latency) {
+  double per_second = (seconds > 0) ? count / seconds : 0.0;
+
+  fprintf(options->csv, "%s,%s,%s,%ld,%s,%ld,%.6f,%.0f", suite, name, variant, size, operation, count, seconds, per_second);
+  printf("%-9s  %-4s  %-7s  %9ld  %-9s  %12.0f/s", suite, name, variant, size, operation, per_second);
+  if (latency != NULL && latency->count > 0) {
+    fprintf(options->csv,
+            ",%lld,%lld,%lld\n",
+            (long long)histogram_percentile(latency, 50),
+            (long long)histogram_percentile(latency, 99),
+            (long long)latency->max);
+    printf("  p50 %6lld ns  p99 %6lld ns  max %8lld ns\n",
+           (long long)histogram_percentile(latency, 50),
+           (long long)histogram_percentile(latency, 99),
+           (long long)latency->max);
+  }
+  else {
+    fprintf(options->csv, ",,,\n");
+    printf("\n");
+  }
+}
+
+/*
+ * Offers every key to an empty queue, then looks up and removes a sample of
+ * them and polls the rest.  With each set, every call is also timed on its
+ * own into the latency histograms; otherwise only whole operations are timed.
+ */
+void run_queue(priqueue_backend_t backend, int *keys, long size, int each, op_timing_t *timings) {
+  priqueue_t q;
+  uint64_t random = 88172645463325252ULL;
+  uint64_t start, before = 0;
+  long i;
+
+  priqueue_init_backend(&q, compare_keys, backend);
+
+  start = now_ns();
+  for (i = 0; i < size; i++) {
+    if (each)
+      before = now_ns();
+    priqueue_offer(&q, &keys[i]);
+    if (each)
+      histogram_record(&timings[OP_OFFER].latency, now_ns() - before);
+  }
+  timings[OP_OFFER].count = size;
+  timings[OP_OFFER].seconds = (now_ns() - start) / 1e9;
+
+  long samples = (size < AT_SAMPLES) ? size : AT_SAMPLES;
+  start = now_ns();
+  for (i = 0; i < samples; i++) {
+    unsigned int index = next_random(&random) % size;
+    if (each)
+      before = now_ns();
+    priqueue_at(&q, index);
+    if (each)
+      histogram_record(&timings[OP_AT].latency, now_ns() - before);
+  }
+  timings[OP_AT].count = samples;
+  timings[OP_AT].seconds = (now_ns() - start) / 1e9;
+
+  samples = (size < REMOVE_SAMPLES) ? size : REMOVE_SAMPLES;
+  start = now_ns();
+  for (i = 0; i < samples; i++) {
+    int *key = &keys[next_random(&random) % size];
+    if (each)
+      before = now_ns();
+    priqueue_remove(&q, key);
+    if (each)
+      histogram_record(&timings[OP_REMOVE].latency, now_ns() - before);
+  }
+  timings[OP_REMOVE].count = samples;
+  timings[OP_REMOVE].seconds = (now_ns() - start) / 1e9;
+
+  long polled = priqueue_size(&q);
+  start = now_ns();
+  for (i = 0; i < polled; i++) {
+    if (each)
+      before = now_ns();
+    priqueue_poll(&q);
+    if (each)
+      histogram_record(&timings[OP_POLL].latency, now_ns() - before);
+  }
+  timings[OP_POLL].count = polled;
+  timings[OP_POLL].seconds = (now_ns() - start) / 1e9;
+
+  priqueue_destroy(&q);
+}
+
+/*
+ * Times every queue operation for every backend and key order, at sizes of
+ * 10, 100, ... up to options->max_size.
+ */
+void bench_queues(bench_options_t *options) {
+  const char *backends[] = {"list", "heap", "fifo"};
+  const char *orders[] = {"sorted", "reverse", "random"};
+  const char *operations[] = {"offer", "at", "remove", "poll"};
+  op_timing_t *bulk = malloc(OP_COUNT * sizeof(op_timing_t));
+  op_timing_t *each = malloc(OP_COUNT * sizeof(op_timing_t));
+  int *keys = malloc(options->max_size * sizeof(int));
+  int backend, order, op;
+  long size, i;
+
+  for (backend = PRIQUEUE_LIST; backend <= PRIQUEUE_FIFO; backend++) {
+    for (order = 0; order < 3; order++) {
+      for (size = 10; size <= options->max_size; size *= 10) {
+        if (backend == PRIQUEUE_LIST && size > options->max_list_size)
+          break;
+
+        uint64_t random = 2463534242ULL;
+        for (i = 0; i < size; i++) {
+          if (order == 0)
+            keys[i] = i;
+          else if (order == 1)
+            keys[i] = size - i;
+          else
+            keys[i] = next_random(&random) % size;
+        }
+
+        // The totals come from the untimed pass, so per-call clock reads do not count
+        for (op = 0; op < OP_COUNT; op++)
+          histogram_init(&each[op].latency);
+        run_queue(backend, keys, size, 0, bulk);
+        run_queue(backend, keys, size, 1, each);
+
+        for (op = 0; op < OP_COUNT; op++)
+          report(options,
+                 "priqueue",
+                 backends[backend],
+                 orders[order],
+                 size,
+                 operations[op],
+                 bulk[op].count,
+                 bulk[op].seconds,
+                 &each[op].latency);
+      }
+    }
+  }
+
+  free(keys);
+  free(bulk);
+  free(each);
+}
+
+/*
+ * Writes a binary trace of jobs that keeps about 90% of cores busy, with
+ * Poisson arrivals and run times uniform in 1..19.  Returns 0 on success.
+ */
+int generate_trace(const char *file_name, int jobs, int cores) {
+  trace_t trace = {malloc(jobs * sizeof(trace_job_t)), jobs, NULL, 0};
+  double *arrivals = malloc(WORKLOAD_CHUNK_JOBS * sizeof(double));
+  double time = 0.0;
+  workload_t workload;
+  int first, status = 0;
+
+  workload_init(&workload);
+  workload.rate = 0.9 * cores / 10.0;
+  workload.run_b = 19;
+
+  for (first = 0; status == 0 && first < jobs; first += WORKLOAD_CHUNK_JOBS) {
+    int count = (jobs - first < WORKLOAD_CHUNK_JOBS) ? jobs - first : WORKLOAD_CHUNK_JOBS;
+    double span = workload_generate_chunk(&workload, first / WORKLOAD_CHUNK_JOBS, count, &trace.jobs[first], arrivals);
+    status = workload_place_chunk(&trace.jobs[first], arrivals, count, time);
+    time += span;
+  }
+
+  if (status == 0)
+    status = trace_write_binary(&trace, file_name);
+  free(arrivals);
+  free(trace.jobs);
+  return status;
+}
+
+/*
+ * Runs the simulator quietly on a trace and returns its exit status, or -1 if
+ * it could not be run.
+ */
+int run_simulator(const char *simulator, int cores, const char *scheme, const char *file_name) {
+  char core_arg[16];
+  pid_t pid;
+  int status;
+
+  snprintf(core_arg, sizeof(core_arg), "%d", cores);
+
+  // Otherwise the child would write out what is still buffered a second time
+  fflush(stdout);
+  fflush(stderr);
+  pid = fork();
+  if (pid == -1)
+    return -1;
+  if (pid == 0) {
+    freopen("/dev/null", "w", stdout);
+    execl(simulator, simulator, "-c", core_arg, "-s", scheme, "-q", file_name, (char *)NULL);
+    _exit(127);
+  }
+
+  if (waitpid(pid, &status, 0) == -1 || !WIFEXITED(status))
+    return -1;
+  return WEXITSTATUS(status);
+}
+
+/*
+ * Times the simulator end to end for every scheme and core count, each on a
+ * generated trace loaded to match its core count.  Returns 0 if every run
+ * succeeded.
+ */
+int bench_schemes(bench_options_t *options) {
+  const char *schemes[] = {"fcfs", "sjf", "psjf", "pri", "ppri", "rr", "mlfq"};
+  char file_name[] = "/tmp/benchmark-XXXXXX";
+  char scheme[16], variant[16];
+  int i, s, status = 0;
+
+  int fd = mkstemp(file_name);
+  if (fd == -1) {
+    fprintf(stderr, "Unable to create a temporary trace.\n");
+    return 2;
+  }
+  close(fd);
+
+  for (i = 0; i < options->core_count; i++) {
+    int cores = options->cores[i];
+    if (generate_trace(file_name, options->jobs, cores) != 0) {
+      fprintf(stderr, "Unable to write file \"%s\".\n", file_name);
+      status = 2;
+      break;
+    }
+
+    for (s = 0; s < 7; s++) {
+      if (strcmp(schemes[s], "rr") == 0 || strcmp(schemes[s], "mlfq") == 0)
+        snprintf(scheme, sizeof(scheme), "%s%d", schemes[s], options->quantum);
+      else
+        snprintf(scheme, sizeof(scheme), "%s", schemes[s]);
+      snprintf(variant, sizeof(variant), "%dc", cores);
+
+      uint64_t start = now_ns();
+      int exit_status = run_simulator(options->simulator, cores, scheme, file_name);
+      double seconds = (now_ns() - start) / 1e9;
+
+      if (exit_status != 0) {
+        fprintf(stderr, "%s -c %d -s %s failed with status %d.\n", options->simulator, cores, scheme, exit_status);
+        status = 3;
+        continue;
+      }
+      report(options, "scheduler", scheme, variant, options->jobs, "simulate", options->jobs, seconds, NULL);
+    }
+  }
+
+  unlink(file_name);
+  return status;
+}
+
+int main(int argc, char **argv) {
+  int default_cores[] = {1, 4, 16};
+  bench_options_t options = {1000000, 10000, default_cores, 3, 1000000, 4, "./simulator", NULL};
+  char *csv_name = "bench.csv";
+  int c, status;
+
+  while ((c = getopt(argc, argv, "n:l:c:j:q:s:o:")) != -1) {
+    switch (c) {
+      case 'n':
+        options.max_size = atol(optarg);
+        break;
+
+      case 'l':
+        options.max_list_size = atol(optarg);
+        break;
+
+      case 'c': {
+        char *save, *token;
+        options.cores = malloc(strlen(optarg) * sizeof(int));
+        options.core_count = 0;
+        for (token = strtok_r(optarg, ",", &save); token != NULL; token = strtok_r(NULL, ",", &save))
+          options.cores[options.core_count++] = atoi(token);
+        break;
+      }
+
+      case 'j':
+        options.jobs = atoi(optarg);
+        break;
+
+      case 'q':
+        options.quantum = atoi(optarg);
+        break;
+
+      case 's':
+        options.simulator = optarg;
+        break;
+
+      case 'o':
+        csv_name = optarg;
+        break;
+
+      default:
+        print_usage(argv[0]);
+        return 1;
+    }
+  }
+
+  int valid = options.max_size >= 10 && options.jobs > 0 && options.quantum > 0 && optind == argc;
+  for (c = 0; c < options.core_count; c++)
+    valid = valid && options.cores[c] > 0;
+  if (!valid) {
+    print_usage(argv[0]);
+    return 1;
+  }
+
+  options.csv = fopen(csv_name, "w");
+  if (options.csv == NULL) {
+    fprintf(stderr, "Unable to write file \"%s\".\n", csv_name);
+    return 2;
+  }
+  fprintf(options.csv, "suite,name,variant,size,operation,count,seconds,per_second,p50_ns,p99_ns,max_ns\n");
+
+  bench_queues(&options);
+  status = bench_schemes(&options);
+
+  fclose(options.csv);
+  if (options.cores != default_cores)
+    free(options.cores);
+  printf("\nWrote %s.\n", csv_name);
+  return status;
+}
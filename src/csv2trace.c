@@ -0,0 +1,38 @@
+/** @file csv2trace.c
+ *  @brief Converts a CSV job file into the binary trace format
+ */
+
+#include <stdio.h>
+
+#include "libtrace/libtrace.h"
+
+
+int main(int argc, char **argv) {
+  trace_t trace;
+
+  if (argc != 3) {
+    fprintf(stderr, "Usage: %s <input csv> <output trace>\n", argv[0]);
+    fprintf(stderr, "       %s examples/proc1.csv proc1.trace\n", argv[0]);
+    return 1;
+  }
+
+  int loaded = trace_load(&trace, argv[1], 0);
+  if (loaded == -1) {
+    fprintf(stderr, "Unable to open file \"%s\".\n", argv[1]);
+    return 2;
+  }
+  if (loaded == -2) {
+    fprintf(stderr, "Illegal file format.\n");
+    return 2;
+  }
+
+  if (trace_write_binary(&trace, argv[2]) != 0) {
+    fprintf(stderr, "Unable to write file \"%s\".\n", argv[2]);
+    trace_free(&trace);
+    return 2;
+  }
+
+  printf("Converted %d job(s).\n", trace.count);
+  trace_free(&trace);
+  return 0;
+}
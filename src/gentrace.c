@@ -0,0 +1,296 @@
+/** @file gentrace.c
+ *  @brief Generates synthetic traces, as CSV or in the binary trace format
+ */
+
+#include <limits.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "libsweep/libsweep.h"
+#include "libtrace/libtrace.h"
+#include "libworkload/libworkload.h"
+
+/*
+ * Chunks are generated one round at a time: in parallel, then placed one
+ * after another, then formatted in parallel and written in order.
+ */
+typedef struct _generator_t {
+  const workload_t *workload;
+  uint64_t first_chunk;  // chunk number of slot 0 of this round
+  long jobs;             // number of jobs of the whole trace
+  int binary;
+  trace_job_t **jobs_of;  // per slot: the jobs of the chunk
+  double **arrivals_of;   // per slot: arrival times from the start of the chunk
+  char **text_of;         // per slot: the CSV lines of the chunk
+  size_t *text_size;
+  double *span;   // per slot: length of the chunk
+  double *start;  // per slot: time the chunk starts at
+  int *failed;    // per slot: an arrival time did not fit in an int
+} generator_t;
+
+void print_usage(char *program_name) {
+  fprintf(stderr,
+          "Usage: %s -n <jobs> [-a <arrivals>] [-r <run times>] [-m <max run time>] [-p <priorities>] [-S <seed>] "
+          "[-j <threads>] [-b] <output file>\n",
+          program_name);
+  fprintf(stderr, "       %s -n 1000000 -a bursty:2:50 -r pareto:1:1.5 -p 5,3,1 big.csv\n", program_name);
+  fprintf(stderr, "\n");
+  fprintf(stderr, "  -n  number of jobs\n");
+  fprintf(stderr, "  -a  poisson:<jobs per time unit> (default: poisson:1), or\n");
+  fprintf(stderr, "      bursty:<jobs per time unit>:<mean jobs per burst>\n");
+  fprintf(stderr, "  -r  uniform:<min>:<max> (default: uniform:1:10), exp:<mean> or\n");
+  fprintf(stderr, "      pareto:<min>:<shape> (heavy tailed: the lower the shape, the heavier the tail)\n");
+  fprintf(stderr, "  -m  longest run time; longer ones are cut down to it\n");
+  fprintf(stderr, "  -p  number of equally likely priorities (default: 8), or comma separated\n");
+  fprintf(stderr, "      weights of priorities 0, 1, ... (Eg: 5,3,1)\n");
+  fprintf(stderr, "  -S  seed of the random numbers (default: 1); the same options give the same trace\n");
+  fprintf(stderr, "  -j  number of threads (default: one per online CPU)\n");
+  fprintf(stderr, "  -b  write a binary trace instead of CSV\n");
+  fprintf(stderr, "\n");
+  fprintf(stderr, "The output file may be - for the standard output.\n");
+}
+
+/*
+ * Parses the argument of -p.  Returns 0, or -1 if it is not a number of
+ * priorities or a list of weights.
+ */
+int parse_priorities(char *arg, workload_t *workload) {
+  char *save, *token;
+  double total = 0;
+
+  if (strchr(arg, ',') == NULL) {
+    int levels = atoi(arg);
+    if (levels <= 0 || levels > WORKLOAD_MAX_PRIORITIES)
+      return -1;
+    workload->priority_levels = levels;
+    for (int i = 0; i < levels; i++)
+      workload->priority_weights[i] = 1.0;
+    return 0;
+  }
+
+  workload->priority_levels = 0;
+  for (token = strtok_r(arg, ",", &save); token != NULL; token = strtok_r(NULL, ",", &save)) {
+    double weight = atof(token);
+    if (weight < 0 || workload->priority_levels == WORKLOAD_MAX_PRIORITIES)
+      return -1;
+    workload->priority_weights[workload->priority_levels++] = weight;
+    total += weight;
+  }
+
+  return (total > 0) ? 0 : -1;
+}
+
+void generate_task(int task, void *arg) {
+  generator_t *generator = (generator_t *)arg;
+  uint64_t chunk = generator->first_chunk + task;
+  long left = generator->jobs - (long)chunk * WORKLOAD_CHUNK_JOBS;
+  int count = (left < WORKLOAD_CHUNK_JOBS) ? (int)left : WORKLOAD_CHUNK_JOBS;
+
+  generator->span[task] =
+      workload_generate_chunk(generator->workload, chunk, count, generator->jobs_of[task], generator->arrivals_of[task]);
+}
+
+void place_task(int task, void *arg) {
+  generator_t *generator = (generator_t *)arg;
+  uint64_t chunk = generator->first_chunk + task;
+  long left = generator->jobs - (long)chunk * WORKLOAD_CHUNK_JOBS;
+  int count = (left < WORKLOAD_CHUNK_JOBS) ? (int)left : WORKLOAD_CHUNK_JOBS;
+
+  generator->failed[task] =
+      workload_place_chunk(generator->jobs_of[task], generator->arrivals_of[task], count, generator->start[task]);
+  if (!generator->binary)
+    generator->text_size[task] = trace_format_csv(generator->jobs_of[task], count, generator->text_of[task]);
+}
+
+int main(int argc, char **argv) {
+  workload_t workload;
+  long jobs = -1;
+  int threads = 0, binary = 0, max_run_time = 0;
+  int c, i;
+
+  workload_init(&workload);
+
+  while ((c = getopt(argc, argv, "n:a:r:m:p:S:j:b")) != -1) {
+    switch (c) {
+      case 'n':
+        jobs = atol(optarg);
+        break;
+
+      case 'a':
+        if (sscanf(optarg, "poisson:%lf", &workload.rate) == 1)
+          workload.arrivals = WORKLOAD_POISSON;
+        else if (sscanf(optarg, "bursty:%lf:%lf", &workload.rate, &workload.burst) == 2 && workload.burst >= 1)
+          workload.arrivals = WORKLOAD_BURSTY;
+        else
+          workload.rate = -1;
+
+        if (!(workload.rate > 0)) {
+          fprintf(stderr, "Option -a <arrivals> requires poisson:<rate> or bursty:<rate>:<burst>. (Eg: -a bursty:2:50)\n");
+          print_usage(argv[0]);
+          return 1;
+        }
+        break;
+
+      case 'r':
+        if (sscanf(optarg, "uniform:%lf:%lf", &workload.run_a, &workload.run_b) == 2 && workload.run_a >= 1 &&
+            workload.run_b >= workload.run_a)
+          workload.run_times = WORKLOAD_UNIFORM;
+        else if (sscanf(optarg, "exp:%lf", &workload.run_a) == 1 && workload.run_a > 0)
+          workload.run_times = WORKLOAD_EXPONENTIAL;
+        else if (sscanf(optarg, "pareto:%lf:%lf", &workload.run_a, &workload.run_b) == 2 && workload.run_a >= 1 &&
+                 workload.run_b > 0)
+          workload.run_times = WORKLOAD_PARETO;
+        else {
+          fprintf(stderr,
+                  "Option -r <run times> requires uniform:<min>:<max>, exp:<mean> or pareto:<min>:<shape>. (Eg: -r "
+                  "pareto:1:1.5)\n");
+          print_usage(argv[0]);
+          return 1;
+        }
+        break;
+
+      case 'm':
+        max_run_time = atoi(optarg);
+
+        if (max_run_time <= 0) {
+          fprintf(stderr, "Option -m <max run time> requires a positive number.\n");
+          print_usage(argv[0]);
+          return 1;
+        }
+        break;
+
+      case 'p':
+        if (parse_priorities(optarg, &workload) == -1) {
+          fprintf(stderr,
+                  "Option -p <priorities> requires a number of priorities up to %d or a list of weights. (Eg: -p "
+                  "5,3,1)\n",
+                  WORKLOAD_MAX_PRIORITIES);
+          print_usage(argv[0]);
+          return 1;
+        }
+        break;
+
+      case 'S':
+        workload.seed = strtoull(optarg, NULL, 10);
+        break;
+
+      case 'j':
+        threads = atoi(optarg);
+
+        if (threads <= 0) {
+          fprintf(stderr, "Option -j <threads> requires a positive number.\n");
+          print_usage(argv[0]);
+          return 1;
+        }
+        break;
+
+      case 'b':
+        binary = 1;
+        break;
+
+      default:
+        print_usage(argv[0]);
+        return 1;
+    }
+  }
+
+  if (jobs < 0 || jobs > INT_MAX) {
+    fprintf(stderr, "Required option -n <jobs> is not present or is not a number of jobs up to %d.\n", INT_MAX);
+    print_usage(argv[0]);
+    return 1;
+  }
+  if (optind != argc - 1) {
+    fprintf(stderr, "A single output file is required.\n");
+    print_usage(argv[0]);
+    return 1;
+  }
+  if (max_run_time > 0)
+    workload.run_max = max_run_time;
+  if (threads == 0)
+    threads = sweep_threads();
+
+  char *file_name = argv[optind];
+  FILE *file = (strcmp(file_name, "-") == 0) ? stdout : fopen(file_name, binary ? "wb" : "w");
+  if (file == NULL) {
+    fprintf(stderr, "Unable to write file \"%s\".\n", file_name);
+    return 2;
+  }
+
+  /*
+   * Generate and write two chunks per thread at a time.
+   */
+  int slots = 2 * threads;
+  generator_t generator = {&workload, 0, jobs, binary, NULL, NULL, NULL, NULL, NULL, NULL, NULL};
+  generator.jobs_of = malloc(slots * sizeof(trace_job_t *));
+  generator.arrivals_of = malloc(slots * sizeof(double *));
+  generator.text_of = malloc(slots * sizeof(char *));
+  generator.text_size = malloc(slots * sizeof(size_t));
+  generator.span = malloc(slots * sizeof(double));
+  generator.start = malloc(slots * sizeof(double));
+  generator.failed = malloc(slots * sizeof(int));
+  for (i = 0; i < slots; i++) {
+    generator.jobs_of[i] = malloc(WORKLOAD_CHUNK_JOBS * sizeof(trace_job_t));
+    generator.arrivals_of[i] = malloc(WORKLOAD_CHUNK_JOBS * sizeof(double));
+    generator.text_of[i] = binary ? NULL : malloc((size_t)WORKLOAD_CHUNK_JOBS * TRACE_MAX_LINE);
+  }
+
+  int status = 0;
+  if (binary)
+    status = trace_write_header(file, (uint64_t)jobs);
+  else
+    status = (fputs(TRACE_CSV_HEADER, file) == EOF) ? -1 : 0;
+
+  uint64_t chunks = (jobs + WORKLOAD_CHUNK_JOBS - 1) / WORKLOAD_CHUNK_JOBS;
+  double time = 0.0;
+  while (status == 0 && generator.first_chunk < chunks) {
+    int round = (chunks - generator.first_chunk < (uint64_t)slots) ? (int)(chunks - generator.first_chunk) : slots;
+
+    sweep_run(round, threads, generate_task, &generator);
+    for (i = 0; i < round; i++) {
+      generator.start[i] = time;
+      time += generator.span[i];
+    }
+    sweep_run(round, threads, place_task, &generator);
+
+    for (i = 0; status == 0 && i < round; i++) {
+      long left = jobs - (long)(generator.first_chunk + i) * WORKLOAD_CHUNK_JOBS;
+      size_t count = (left < WORKLOAD_CHUNK_JOBS) ? (size_t)left : WORKLOAD_CHUNK_JOBS;
+
+      if (generator.failed[i] != 0) {
+        fprintf(stderr, "Arrival times do not fit in an int; use a higher rate or fewer jobs.\n");
+        status = 3;
+      }
+      else if (binary ? fwrite(generator.jobs_of[i], sizeof(trace_job_t), count, file) != count
+                      : fwrite(generator.text_of[i], 1, generator.text_size[i], file) != generator.text_size[i])
+        status = -1;
+    }
+    generator.first_chunk += round;
+  }
+
+  if ((file != stdout && fclose(file) != 0) || (file == stdout && fflush(file) != 0))
+    status = (status == 0) ? -1 : status;
+  if (status == -1) {
+    fprintf(stderr, "Unable to write file \"%s\".\n", file_name);
+    status = 2;
+  }
+
+  for (i = 0; i < slots; i++) {
+    free(generator.jobs_of[i]);
+    free(generator.arrivals_of[i]);
+    free(generator.text_of[i]);
+  }
+  free(generator.jobs_of);
+  free(generator.arrivals_of);
+  free(generator.text_of);
+  free(generator.text_size);
+  free(generator.span);
+  free(generator.start);
+  free(generator.failed);
+
+  if (status == 0 && file != stdout)
+    printf("Generated %ld job(s).\n", jobs);
+  return status;
+}
@@ -0,0 +1,197 @@
+/** @file libcheckpoint.c
+ */
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "libcheckpoint.h"
+
+
+/**
+  Returns the time of CLOCK_MONOTONIC.
+
+  @return the time in seconds
+*/
+static double now() {
+  struct timespec clock;
+  clock_gettime(CLOCK_MONOTONIC, &clock);
+  return (double)clock.tv_sec + (double)clock.tv_nsec / 1e9;
+}
+
+
+/**
+  Initializes the checkpoint_writer_t data structure. The first checkpoint is
+  due interval seconds from now.
+
+  @param writer a pointer to an instance of the checkpoint_writer_t data structure
+  @param file_name the name of the checkpoint file, replaced by each checkpoint
+  @param interval the least number of seconds between two checkpoints
+*/
+void checkpoint_writer_init(checkpoint_writer_t *writer, const char *file_name, double interval) {
+  writer->file_name = strdup(file_name);
+  writer->temp_name = (char *)malloc(strlen(file_name) + 5);
+  sprintf(writer->temp_name, "%s.tmp", file_name);
+  writer->interval = interval;
+  writer->next = now() + interval;
+  writer->sequence = 0;
+  writer->stream = NULL;
+  writer->buffer = NULL;
+  writer->size = 0;
+  writer->writing = 0;
+  atomic_init(&writer->done, 0);
+  atomic_init(&writer->failed, 0);
+}
+
+
+/**
+  Waits for the thread writing the last checkpoint, if there is one.
+
+  @param writer a pointer to an instance of the checkpoint_writer_t data structure
+*/
+static void join(checkpoint_writer_t *writer) {
+  if (writer->writing) {
+    pthread_join(writer->thread, NULL);
+    writer->writing = 0;
+    free(writer->buffer);
+    writer->buffer = NULL;
+  }
+}
+
+
+/**
+  Starts a checkpoint if one is due and the last one has been written.
+
+  The state is saved to the returned stream, which is in memory, so saving
+  only costs a copy of the state; checkpoint_commit() then writes it to the
+  file from another thread while the caller carries on. A checkpoint is never
+  begun while the last one is still being written, so a slow disk delays
+  checkpoints rather than the caller.
+
+  @param writer a pointer to an instance of the checkpoint_writer_t data structure
+  @return a stream to save the state to, with the checkpoint_header_t already written
+  @return NULL if no checkpoint is due
+*/
+FILE *checkpoint_begin(checkpoint_writer_t *writer) {
+  if (writer->writing && !atomic_load(&writer->done)) {
+    return NULL;
+  }
+
+  double time = now();
+  if (time < writer->next) {
+    return NULL;
+  }
+
+  join(writer);
+  writer->next = time + writer->interval;
+  writer->stream = open_memstream(&writer->buffer, &writer->size);
+  if (writer->stream == NULL) {
+    atomic_store(&writer->failed, 1);
+    return NULL;
+  }
+
+  checkpoint_header_t header;
+  memcpy(header.magic, CHECKPOINT_MAGIC, 4);
+  header.reserved = 0;
+  header.sequence = writer->sequence++;
+  CHECKPOINT_SAVE(writer->stream, header);
+  return writer->stream;
+}
+
+
+/**
+  Writes a checkpoint to a temporary file, then renames it over the
+  checkpoint file, so the checkpoint file is always a whole checkpoint even
+  if the process dies while writing.
+
+  @param arg the checkpoint_writer_t
+  @return NULL
+*/
+static void *write_checkpoint(void *arg) {
+  checkpoint_writer_t *writer = (checkpoint_writer_t *)arg;
+  FILE *file = fopen(writer->temp_name, "wb");
+  int failed = (file == NULL);
+
+  if (file != NULL) {
+    failed = (fwrite(writer->buffer, 1, writer->size, file) != writer->size);
+    failed |= (fflush(file) != 0 || fsync(fileno(file)) != 0);
+    failed |= (fclose(file) != 0);
+  }
+  if (!failed) {
+    failed = (rename(writer->temp_name, writer->file_name) != 0);
+  }
+
+  if (failed) {
+    atomic_store(&writer->failed, 1);
+  }
+  atomic_store(&writer->done, 1);
+  return NULL;
+}
+
+
+/**
+  Finishes the checkpoint begun by checkpoint_begin() and hands it to a
+  thread that writes it to the file.
+
+  @param writer a pointer to an instance of the checkpoint_writer_t data structure
+*/
+void checkpoint_commit(checkpoint_writer_t *writer) {
+  int failed = ferror(writer->stream);
+  fclose(writer->stream);
+  writer->stream = NULL;
+
+  atomic_store(&writer->done, 0);
+  if (failed || pthread_create(&writer->thread, NULL, write_checkpoint, writer) != 0) {
+    atomic_store(&writer->failed, 1);
+    free(writer->buffer);
+    writer->buffer = NULL;
+    return;
+  }
+  writer->writing = 1;
+}
+
+
+/**
+  Waits for the last checkpoint to be written and frees all the memory
+  associated with the checkpoint_writer_t data structure.
+
+  @param writer a pointer to an instance of the checkpoint_writer_t data structure
+  @return 0 if every checkpoint was written
+  @return -1 if a checkpoint could not be written
+*/
+int checkpoint_writer_destroy(checkpoint_writer_t *writer) {
+  join(writer);
+  free(writer->file_name);
+  free(writer->temp_name);
+  return atomic_load(&writer->failed) ? -1 : 0;
+}
+
+
+/**
+  Opens a checkpoint and reads its checkpoint_header_t.
+
+  @param file set to the checkpoint file, positioned after the header
+  @param file_name the name of the checkpoint file
+  @return 0 on success
+  @return -1 if the file cannot be opened
+  @return -2 if the file is not a checkpoint
+*/
+int checkpoint_open(FILE **file, const char *file_name) {
+  checkpoint_header_t header;
+
+  *file = fopen(file_name, "rb");
+  if (*file == NULL) {
+    return -1;
+  }
+  if (CHECKPOINT_LOAD(*file, header) != 1 || memcmp(header.magic, CHECKPOINT_MAGIC, 4) != 0) {
+    fclose(*file);
+    *file = NULL;
+    return -2;
+  }
+
+  return 0;
+}
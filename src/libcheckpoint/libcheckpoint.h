@@ -0,0 +1,118 @@
+/** @file libcheckpoint.h
+ */
+
+#ifndef LIBCHECKPOINT_H_
+#define LIBCHECKPOINT_H_
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+  First bytes of a checkpoint. See checkpoint_header_t.
+*/
+#define CHECKPOINT_MAGIC "CKP1"
+
+/**
+ * \def CHECKPOINT_SAVE
+ * \brief Writes one value to a checkpoint, in the byte order of the machine
+ */
+#define CHECKPOINT_SAVE(file, value) fwrite(&(value), sizeof(value), 1, (file))
+
+/**
+ * \def CHECKPOINT_SAVE_ARRAY
+ * \brief Writes count values of an array to a checkpoint
+ */
+#define CHECKPOINT_SAVE_ARRAY(file, array, count) fwrite((array), sizeof(*(array)), (count), (file))
+
+/**
+ * \def CHECKPOINT_LOAD
+ * \brief Reads one value written by CHECKPOINT_SAVE; evaluates to 1 if it was read
+ */
+#define CHECKPOINT_LOAD(file, value) fread(&(value), sizeof(value), 1, (file))
+
+/**
+ * \def CHECKPOINT_LOAD_ARRAY
+ * \brief Reads count values written by CHECKPOINT_SAVE_ARRAY; evaluates to the number read
+ */
+#define CHECKPOINT_LOAD_ARRAY(file, array, count) fread((array), sizeof(*(array)), (count), (file))
+
+/** @struct checkpoint_header_t
+ *  @brief Header of a checkpoint
+ *
+ *  A checkpoint is this header followed by the state of the simulator, each
+ *  library writing its own part, all in the byte order of the machine that
+ *  wrote it.
+ *
+ *  @var checkpoint_header_t::magic
+ *  Member 'magic' contains the four characters of CHECKPOINT_MAGIC.
+ *  @var checkpoint_header_t::reserved
+ *  Member 'reserved' is written as 0.
+ *  @var checkpoint_header_t::sequence
+ *  Member 'sequence' contains the number of checkpoints written before this one by the same writer.
+ */
+typedef struct checkpoint_header_t {
+  char magic[4];
+  uint32_t reserved;
+  uint64_t sequence;
+} checkpoint_header_t;
+
+/** @struct checkpoint_writer_t
+ *  @brief Writes checkpoints to one file from a background thread
+ *  @var checkpoint_writer_t::file_name
+ *  Member 'file_name' contains the name of the checkpoint file.
+ *  @var checkpoint_writer_t::temp_name
+ *  Member 'temp_name' contains the name a checkpoint is written to before it replaces the checkpoint file.
+ *  @var checkpoint_writer_t::interval
+ *  Member 'interval' contains the least number of seconds between two checkpoints.
+ *  @var checkpoint_writer_t::next
+ *  Member 'next' contains the time, in seconds of CLOCK_MONOTONIC, the next checkpoint is due.
+ *  @var checkpoint_writer_t::sequence
+ *  Member 'sequence' contains the number of checkpoints begun so far.
+ *  @var checkpoint_writer_t::stream
+ *  Member 'stream' contains the in-memory stream of the checkpoint being saved, or NULL.
+ *  @var checkpoint_writer_t::buffer
+ *  Member 'buffer' contains the bytes of checkpoint_writer_t::stream.
+ *  @var checkpoint_writer_t::size
+ *  Member 'size' contains the number of bytes in checkpoint_writer_t::buffer.
+ *  @var checkpoint_writer_t::thread
+ *  Member 'thread' contains the thread writing the last checkpoint.
+ *  @var checkpoint_writer_t::writing
+ *  Member 'writing' is non-zero from the start of checkpoint_writer_t::thread until it is joined.
+ *  @var checkpoint_writer_t::done
+ *  Member 'done' is set by checkpoint_writer_t::thread once it has written its checkpoint.
+ *  @var checkpoint_writer_t::failed
+ *  Member 'failed' is set by checkpoint_writer_t::thread if a checkpoint could not be written.
+ */
+typedef struct checkpoint_writer_t {
+  char *file_name;
+  char *temp_name;
+  double interval;
+  double next;
+  uint64_t sequence;
+  FILE *stream;
+  char *buffer;
+  size_t size;
+  pthread_t thread;
+  int writing;
+  atomic_int done;
+  atomic_int failed;
+} checkpoint_writer_t;
+
+void checkpoint_writer_init(checkpoint_writer_t *writer, const char *file_name, double interval);
+FILE *checkpoint_begin(checkpoint_writer_t *writer);
+void checkpoint_commit(checkpoint_writer_t *writer);
+int checkpoint_writer_destroy(checkpoint_writer_t *writer);
+
+int checkpoint_open(FILE **file, const char *file_name);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* LIBCHECKPOINT_H_ */
@@ -0,0 +1,240 @@
+/** @file libdiagram.c
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "libdiagram.h"
+
+#include "../libcheckpoint/libcheckpoint.h"
+
+
+/**
+  Initializes the diagram_t data structure with no time units on any core.
+
+  @param diagram a pointer to an instance of the diagram_t data structure
+  @param cores the number of cores
+*/
+void diagram_init(diagram_t *diagram, int cores) {
+  int i;
+
+  diagram->cores = cores;
+  diagram->segments = (diagram_segment_t **)malloc(cores * sizeof(diagram_segment_t *));
+  diagram->count = (int *)malloc(cores * sizeof(int));
+  diagram->capacity = (int *)malloc(cores * sizeof(int));
+
+  for (i = 0; i < cores; i++) {
+    diagram->capacity[i] = 16;
+    diagram->count[i] = 0;
+    diagram->segments[i] = (diagram_segment_t *)malloc(diagram->capacity[i] * sizeof(diagram_segment_t));
+  }
+}
+
+
+/**
+  Records that a core spent the next length time units on a job.
+
+  The time units are merged into the core's last segment if it is for the
+  same job, so memory grows with the number of context switches only.
+
+  @param diagram a pointer to an instance of the diagram_t data structure
+  @param core_id the core
+  @param job_id the job the core ran, or -1 if it was idle
+  @param length the number of time units
+*/
+void diagram_append(diagram_t *diagram, int core_id, int job_id, int length) {
+  int count = diagram->count[core_id];
+  diagram_segment_t *segments = diagram->segments[core_id];
+
+  if (length <= 0) {
+    return;
+  }
+
+  if (count > 0 && segments[count - 1].job_id == job_id) {
+    segments[count - 1].length += length;
+    return;
+  }
+
+  if (count == diagram->capacity[core_id]) {
+    diagram->capacity[core_id] *= 2;
+    segments = (diagram_segment_t *)realloc(segments, diagram->capacity[core_id] * sizeof(diagram_segment_t));
+    diagram->segments[core_id] = segments;
+  }
+
+  segments[count].job_id = job_id;
+  segments[count].start = (count > 0) ? segments[count - 1].start + segments[count - 1].length : 0;
+  segments[count].length = length;
+  diagram->count[core_id] = count + 1;
+}
+
+
+/**
+  Writes the symbol a job is drawn with: 0-9, then a-z, then A-Z, then the
+  job_id in parentheses (cut to 9 characters). An idle core is drawn as '-'.
+
+  @param job_id the job, or -1 for an idle core
+  @param symbol buffer of at least 16 characters to write the symbol to
+  @return the length of the symbol
+*/
+int diagram_symbol(int job_id, char *symbol) {
+  if (job_id == -1)
+    return sprintf(symbol, "-");
+  else if (job_id < 10)
+    return sprintf(symbol, "%d", job_id);
+  else if (job_id < 10 + 26)
+    return sprintf(symbol, "%c", job_id - 10 + 'a');
+  else if (job_id < 10 + 26 + 26)
+    return sprintf(symbol, "%c", job_id - 10 - 26 + 'A');
+  else {
+    int length = sprintf(symbol, "(%d)", job_id);
+    if (length > 9) {
+      symbol[9] = '\0';
+      length = 9;
+    }
+    return length;
+  }
+}
+
+
+/**
+  Prints one core's row of the diagram in full, one symbol per time unit.
+
+  @param diagram a pointer to an instance of the diagram_t data structure
+  @param core_id the core to print
+  @param file the stream to print to
+*/
+void diagram_print_core(diagram_t *diagram, int core_id, FILE *file) {
+  char symbol[16];
+  char run[1024];
+  int i, j;
+
+  for (i = 0; i < diagram->count[core_id]; i++) {
+    diagram_segment_t *segment = &diagram->segments[core_id][i];
+    int length = diagram_symbol(segment->job_id, symbol);
+
+    // Write the run a buffer full of repeated symbols at a time
+    int per_buffer = (int)sizeof(run) / length;
+    int filled = (segment->length < per_buffer) ? segment->length : per_buffer;
+    for (j = 0; j < filled; j++)
+      memcpy(run + j * length, symbol, length);
+
+    for (j = segment->length; j > 0; j -= filled)
+      fwrite(run, length, (j < filled) ? j : filled, file);
+  }
+}
+
+
+/**
+  Prints the diagram with one "symbol:length" entry per segment.
+
+  @param diagram a pointer to an instance of the diagram_t data structure
+  @param file the stream to print to
+*/
+void diagram_print_compressed(diagram_t *diagram, FILE *file) {
+  char symbol[16];
+  int i, j;
+
+  for (i = 0; i < diagram->cores; i++) {
+    fprintf(file, "  Core %2d:", i);
+    for (j = 0; j < diagram->count[i]; j++) {
+      diagram_symbol(diagram->segments[i][j].job_id, symbol);
+      fprintf(file, " %s:%d", symbol, diagram->segments[i][j].length);
+    }
+    fprintf(file, "\n");
+  }
+}
+
+
+/**
+  Writes every segment of the diagram as CSV, with a "core,job_id,start,length"
+  header line and the segments of each core in time order. Idle segments have
+  a job_id of -1.
+
+  @param diagram a pointer to an instance of the diagram_t data structure
+  @param file the stream to write to
+  @return 0 on success, -1 if writing failed
+*/
+int diagram_export(diagram_t *diagram, FILE *file) {
+  int i, j;
+
+  fprintf(file, "core,job_id,start,length\n");
+  for (i = 0; i < diagram->cores; i++) {
+    for (j = 0; j < diagram->count[i]; j++) {
+      diagram_segment_t *segment = &diagram->segments[i][j];
+      fprintf(file, "%d,%d,%d,%d\n", i, segment->job_id, segment->start, segment->length);
+    }
+  }
+
+  return ferror(file) ? -1 : 0;
+}
+
+
+/**
+  Writes the diagram to a checkpoint.
+
+  @param diagram a pointer to an instance of the diagram_t data structure
+  @param file the checkpoint
+*/
+void diagram_save(diagram_t *diagram, FILE *file) {
+  int i;
+
+  CHECKPOINT_SAVE(file, diagram->cores);
+  for (i = 0; i < diagram->cores; i++) {
+    CHECKPOINT_SAVE(file, diagram->count[i]);
+    CHECKPOINT_SAVE_ARRAY(file, diagram->segments[i], diagram->count[i]);
+  }
+}
+
+
+/**
+  Initializes a diagram with the segments written by diagram_save(). The
+  diagram is initialized even if the checkpoint is malformed, and has to be
+  freed with diagram_destroy() either way.
+
+  @param diagram a pointer to an instance of the diagram_t data structure
+  @param file the checkpoint
+  @return 0 on success, -1 if the checkpoint is truncated or malformed
+*/
+int diagram_load(diagram_t *diagram, FILE *file) {
+  int i, cores = 0;
+
+  if (CHECKPOINT_LOAD(file, cores) != 1 || cores < 0)
+    cores = 0;
+  diagram_init(diagram, cores);
+  if (cores == 0)
+    return -1;
+
+  for (i = 0; i < cores; i++) {
+    int count;
+    if (CHECKPOINT_LOAD(file, count) != 1 || count < 0)
+      return -1;
+
+    if (count > diagram->capacity[i]) {
+      diagram->capacity[i] = count;
+      diagram->segments[i] = (diagram_segment_t *)realloc(diagram->segments[i], count * sizeof(diagram_segment_t));
+    }
+    if (CHECKPOINT_LOAD_ARRAY(file, diagram->segments[i], count) != (size_t)count)
+      return -1;
+    diagram->count[i] = count;
+  }
+
+  return 0;
+}
+
+
+/**
+  Frees all the memory associated with the diagram.
+
+  @param diagram a pointer to an instance of the diagram_t data structure
+*/
+void diagram_destroy(diagram_t *diagram) {
+  int i;
+
+  for (i = 0; i < diagram->cores; i++) {
+    free(diagram->segments[i]);
+  }
+  free(diagram->segments);
+  free(diagram->count);
+  free(diagram->capacity);
+}
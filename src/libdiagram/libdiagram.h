@@ -0,0 +1,60 @@
+/** @file libdiagram.h
+ */
+
+#ifndef LIBDIAGRAM_H_
+#define LIBDIAGRAM_H_
+
+#include <stdio.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** @struct diagram_segment_t
+ *  @brief A run of consecutive time units a core spent on one job
+ *  @var diagram_segment_t::job_id
+ *  Member 'job_id' contains the job the core ran, or -1 if the core was idle.
+ *  @var diagram_segment_t::start
+ *  Member 'start' contains the first time unit of the run.
+ *  @var diagram_segment_t::length
+ *  Member 'length' contains the number of time units in the run.
+ */
+typedef struct diagram_segment_t {
+  int job_id;
+  int start;
+  int length;
+} diagram_segment_t;
+
+/** @struct diagram_t
+ *  @brief Run-length encoded timing diagram of every core
+ *  @var diagram_t::cores
+ *  Member 'cores' contains the number of cores.
+ *  @var diagram_t::segments
+ *  Member 'segments' contains an array of segments per core, in time order.
+ *  @var diagram_t::count
+ *  Member 'count' contains the number of segments of each core.
+ *  @var diagram_t::capacity
+ *  Member 'capacity' contains the number of segments each core's array can hold.
+ */
+typedef struct diagram_t {
+  int cores;
+  diagram_segment_t **segments;
+  int *count;
+  int *capacity;
+} diagram_t;
+
+void diagram_init(diagram_t *diagram, int cores);
+void diagram_append(diagram_t *diagram, int core_id, int job_id, int length);
+int diagram_symbol(int job_id, char *symbol);
+void diagram_print_core(diagram_t *diagram, int core_id, FILE *file);
+void diagram_print_compressed(diagram_t *diagram, FILE *file);
+int diagram_export(diagram_t *diagram, FILE *file);
+void diagram_save(diagram_t *diagram, FILE *file);
+int diagram_load(diagram_t *diagram, FILE *file);
+void diagram_destroy(diagram_t *diagram);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* LIBDIAGRAM_H_ */
@@ -0,0 +1,267 @@
+/** @file libeventlog.c
+ */
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "libeventlog.h"
+
+/**
+ * \def RING_SIZE
+ * \brief Number of events in the ring buffer of an eventlog_t
+ */
+#define RING_SIZE (EVENTLOG_CHUNKS * EVENTLOG_CHUNK)
+
+
+/**
+  Writes events to the file of a Chrome trace event log. A job is drawn as a
+  slice on the row of its core from the time it is dispatched to the time it
+  is preempted, expires or finishes, and an arrival as an instant.
+
+  @param log a pointer to an instance of the eventlog_t data structure
+  @param events the events
+  @param count the number of events
+  @param first non-zero if the first event is the first of the log
+  @return 0 on success, -1 if writing failed
+*/
+static int write_chrome(eventlog_t *log, const eventlog_event_t *events, uint64_t count, int first) {
+  const char *ends[] = {"arrive", "dispatch", "preempt", "expire", "finish"};
+
+  for (uint64_t i = 0; i < count; ++i) {
+    const eventlog_event_t *event = &events[i];
+    const char *separator = (first && i == 0) ? "" : ",\n";
+
+    if (event->type == EVENTLOG_ARRIVE) {
+      fprintf(log->file,
+              "%s{\"name\":\"arrive\",\"cat\":\"job\",\"ph\":\"i\",\"s\":\"t\",\"ts\":%d,\"pid\":0,\"tid\":%d,\"args\":{\"job\":%d}}",
+              separator,
+              event->time,
+              event->core_id,
+              event->job_id);
+    }
+    else if (event->type == EVENTLOG_DISPATCH) {
+      fprintf(log->file,
+              "%s{\"name\":\"job %d\",\"cat\":\"job\",\"ph\":\"B\",\"ts\":%d,\"pid\":0,\"tid\":%d,\"args\":{\"job\":%d}}",
+              separator,
+              event->job_id,
+              event->time,
+              event->core_id,
+              event->job_id);
+    }
+    else {
+      fprintf(log->file,
+              "%s{\"name\":\"job %d\",\"cat\":\"job\",\"ph\":\"E\",\"ts\":%d,\"pid\":0,\"tid\":%d,\"args\":{\"end\":\"%s\"}}",
+              separator,
+              event->job_id,
+              event->time,
+              event->core_id,
+              ends[event->type]);
+    }
+  }
+
+  return ferror(log->file) ? -1 : 0;
+}
+
+
+/**
+  Writes the events from index from to index to of a log to its file.
+
+  @param log a pointer to an instance of the eventlog_t data structure
+  @param from the number of the first event
+  @param to the number one past the last event
+  @return 0 on success, -1 if writing failed
+*/
+static int write_events(eventlog_t *log, uint64_t from, uint64_t to) {
+  while (from < to) {
+    // Stop at the end of the ring, the rest is at its start
+    uint64_t start = from % RING_SIZE;
+    uint64_t count = (to - from < RING_SIZE - start) ? to - from : RING_SIZE - start;
+
+    if (log->format == EVENTLOG_CHROME) {
+      if (write_chrome(log, &log->ring[start], count, from == 0) != 0) {
+        return -1;
+      }
+    }
+    else if (fwrite(&log->ring[start], sizeof(eventlog_event_t), count, log->file) != count) {
+      return -1;
+    }
+    from += count;
+  }
+
+  return 0;
+}
+
+
+/**
+  Body of the writer thread: writes the events as they are published, until
+  the log is closed and every event is written.
+
+  @param arg the eventlog_t
+  @return NULL
+*/
+static void *drain(void *arg) {
+  eventlog_t *log = (eventlog_t *)arg;
+
+  pthread_mutex_lock(&log->lock);
+  for (;;) {
+    while (log->written == log->published && !log->closed) {
+      pthread_cond_wait(&log->ready, &log->lock);
+    }
+    if (log->written == log->published) {
+      break;
+    }
+
+    uint64_t from = log->written, to = log->published;
+    pthread_mutex_unlock(&log->lock);
+    int failed = write_events(log, from, to);
+    pthread_mutex_lock(&log->lock);
+
+    log->written = to;
+    log->failed |= (failed != 0);
+    pthread_cond_signal(&log->space);
+  }
+  pthread_mutex_unlock(&log->lock);
+
+  return NULL;
+}
+
+
+/**
+  Writes the header of a binary event log.
+
+  @param file the file
+  @param count the number of events
+  @return 0 on success, -1 if writing failed
+*/
+static int write_header(FILE *file, uint64_t count) {
+  eventlog_header_t header;
+  memcpy(header.magic, EVENTLOG_MAGIC, 4);
+  header.reserved = 0;
+  header.count = count;
+  return (fwrite(&header, sizeof(header), 1, file) == 1) ? 0 : -1;
+}
+
+
+/**
+  Creates an event log and starts its writer thread.
+
+  @param log a pointer to an instance of the eventlog_t data structure
+  @param file_name the name of the file to write
+  @param format the format of the file
+  @return 0 on success
+  @return -1 if the file cannot be written or the writer thread cannot be started
+*/
+int eventlog_open(eventlog_t *log, const char *file_name, eventlog_format_t format) {
+  log->file = fopen(file_name, "wb");
+  if (log->file == NULL) {
+    return -1;
+  }
+
+  // The count of a binary log is filled in by eventlog_close()
+  int failed = (format == EVENTLOG_CHROME) ? (fputs("{\"traceEvents\":[\n", log->file) == EOF)
+                                           : (write_header(log->file, 0) != 0);
+  if (failed) {
+    fclose(log->file);
+    return -1;
+  }
+
+  log->format = format;
+  log->ring = (eventlog_event_t *)malloc(RING_SIZE * sizeof(eventlog_event_t));
+  if (log->ring == NULL) {
+    fclose(log->file);
+    return -1;
+  }
+  log->recorded = 0;
+  log->published = 0;
+  log->written = 0;
+  log->closed = 0;
+  log->failed = 0;
+  pthread_mutex_init(&log->lock, NULL);
+  pthread_cond_init(&log->ready, NULL);
+  pthread_cond_init(&log->space, NULL);
+  if (pthread_create(&log->thread, NULL, drain, log) != 0) {
+    pthread_cond_destroy(&log->space);
+    pthread_cond_destroy(&log->ready);
+    pthread_mutex_destroy(&log->lock);
+    free(log->ring);
+    fclose(log->file);
+    return -1;
+  }
+  return 0;
+}
+
+
+/**
+  Hands the events recorded so far to the writer thread, then waits until the
+  ring has room for another chunk.
+
+  @param log a pointer to an instance of the eventlog_t data structure
+*/
+static void publish(eventlog_t *log) {
+  pthread_mutex_lock(&log->lock);
+  log->published = log->recorded;
+  pthread_cond_signal(&log->ready);
+  while (log->recorded + EVENTLOG_CHUNK - log->written > RING_SIZE) {
+    pthread_cond_wait(&log->space, &log->lock);
+  }
+  pthread_mutex_unlock(&log->lock);
+}
+
+
+/**
+  Records an event. Only the thread that opened the log may record events.
+
+  @param log a pointer to an instance of the eventlog_t data structure
+  @param type the kind of event
+  @param time the time of the event
+  @param core_id the core of the event, or -1 for an arrival
+  @param job_id the job of the event
+*/
+void eventlog_record(eventlog_t *log, eventlog_type_t type, int time, int core_id, int job_id) {
+  eventlog_event_t *event = &log->ring[log->recorded % RING_SIZE];
+  event->time = time;
+  event->core_id = core_id;
+  event->job_id = job_id;
+  event->type = type;
+
+  if (++log->recorded % EVENTLOG_CHUNK == 0) {
+    publish(log);
+  }
+}
+
+
+/**
+  Writes the events not written yet, waits for the writer thread and closes
+  the file. Frees all the memory associated with the eventlog_t data
+  structure.
+
+  @param log a pointer to an instance of the eventlog_t data structure
+  @return 0 on success
+  @return -1 if writing failed
+*/
+int eventlog_close(eventlog_t *log) {
+  pthread_mutex_lock(&log->lock);
+  log->published = log->recorded;
+  log->closed = 1;
+  pthread_cond_signal(&log->ready);
+  pthread_mutex_unlock(&log->lock);
+  pthread_join(log->thread, NULL);
+
+  int failed = log->failed;
+  if (log->format == EVENTLOG_CHROME) {
+    failed |= (fputs("\n]}\n", log->file) == EOF);
+  }
+  else {
+    failed |= (fseek(log->file, 0, SEEK_SET) != 0 || write_header(log->file, log->written) != 0);
+  }
+  failed |= (fclose(log->file) != 0);
+
+  pthread_mutex_destroy(&log->lock);
+  pthread_cond_destroy(&log->ready);
+  pthread_cond_destroy(&log->space);
+  free(log->ring);
+  return failed ? -1 : 0;
+}
@@ -0,0 +1,141 @@
+/** @file libeventlog.h
+ */
+
+#ifndef LIBEVENTLOG_H_
+#define LIBEVENTLOG_H_
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+  First bytes of a binary event log. See eventlog_header_t.
+*/
+#define EVENTLOG_MAGIC "EVT1"
+
+/**
+ * \def EVENTLOG_CHUNK
+ * \brief Number of events the recording thread hands to the writer thread at once
+ */
+#define EVENTLOG_CHUNK 4096
+
+/**
+ * \def EVENTLOG_CHUNKS
+ * \brief Number of chunks in the ring buffer of an eventlog_t
+ */
+#define EVENTLOG_CHUNKS 16
+
+/**
+  Kinds of scheduling events
+*/
+typedef enum {
+  EVENTLOG_ARRIVE = 0,
+  EVENTLOG_DISPATCH,
+  EVENTLOG_PREEMPT,
+  EVENTLOG_EXPIRE,
+  EVENTLOG_FINISH
+} eventlog_type_t;
+
+/**
+  Formats of an event log
+*/
+typedef enum { EVENTLOG_BINARY = 0, EVENTLOG_CHROME } eventlog_format_t;
+
+/** @struct eventlog_event_t
+ *  @brief One scheduling event, as it is stored in a binary event log
+ *  @var eventlog_event_t::time
+ *  Member 'time' contains the time of the event.
+ *  @var eventlog_event_t::core_id
+ *  Member 'core_id' contains the core of the event, or -1 for an arrival.
+ *  @var eventlog_event_t::job_id
+ *  Member 'job_id' contains the job of the event.
+ *  @var eventlog_event_t::type
+ *  Member 'type' contains the eventlog_type_t of the event.
+ */
+typedef struct eventlog_event_t {
+  int32_t time;
+  int32_t core_id;
+  int32_t job_id;
+  int32_t type;
+} eventlog_event_t;
+
+/** @struct eventlog_header_t
+ *  @brief Header of a binary event log
+ *
+ *  A binary event log is this header followed by eventlog_header_t::count
+ *  eventlog_event_t records in the order they happened, all in the byte
+ *  order of the machine that wrote it.
+ *
+ *  @var eventlog_header_t::magic
+ *  Member 'magic' contains the four characters of EVENTLOG_MAGIC.
+ *  @var eventlog_header_t::reserved
+ *  Member 'reserved' is written as 0.
+ *  @var eventlog_header_t::count
+ *  Member 'count' contains the number of events in the log.
+ */
+typedef struct eventlog_header_t {
+  char magic[4];
+  uint32_t reserved;
+  uint64_t count;
+} eventlog_header_t;
+
+/** @struct eventlog_t
+ *  @brief Event log written to a file by a background thread
+ *
+ *  Events are recorded into a ring buffer of EVENTLOG_CHUNKS chunks. The
+ *  recording thread only takes the lock once per EVENTLOG_CHUNK events, to
+ *  hand a full chunk to the writer thread, and only waits if the writer has
+ *  fallen a whole ring behind.
+ *  @var eventlog_t::file
+ *  Member 'file' contains the file being written.
+ *  @var eventlog_t::format
+ *  Member 'format' contains the format of the log.
+ *  @var eventlog_t::ring
+ *  Member 'ring' contains the EVENTLOG_CHUNKS * EVENTLOG_CHUNK events of the ring buffer.
+ *  @var eventlog_t::recorded
+ *  Member 'recorded' contains the number of events recorded so far (recording thread only).
+ *  @var eventlog_t::published
+ *  Member 'published' contains the number of events handed to the writer thread.
+ *  @var eventlog_t::written
+ *  Member 'written' contains the number of events the writer thread has written.
+ *  @var eventlog_t::closed
+ *  Member 'closed' is non-zero once no more events will be published.
+ *  @var eventlog_t::failed
+ *  Member 'failed' is non-zero if writing failed.
+ *  @var eventlog_t::lock
+ *  Member 'lock' protects eventlog_t::published, eventlog_t::written, eventlog_t::closed and eventlog_t::failed.
+ *  @var eventlog_t::ready
+ *  Member 'ready' is signaled when events are published or the log is closed.
+ *  @var eventlog_t::space
+ *  Member 'space' is signaled when the writer thread has written events.
+ *  @var eventlog_t::thread
+ *  Member 'thread' contains the writer thread.
+ */
+typedef struct eventlog_t {
+  FILE *file;
+  eventlog_format_t format;
+  eventlog_event_t *ring;
+  uint64_t recorded;
+  uint64_t published;
+  uint64_t written;
+  int closed;
+  int failed;
+  pthread_mutex_t lock;
+  pthread_cond_t ready;
+  pthread_cond_t space;
+  pthread_t thread;
+} eventlog_t;
+
+int eventlog_open(eventlog_t *log, const char *file_name, eventlog_format_t format);
+void eventlog_record(eventlog_t *log, eventlog_type_t type, int time, int core_id, int job_id);
+int eventlog_close(eventlog_t *log);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* LIBEVENTLOG_H_ */
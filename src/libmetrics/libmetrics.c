@@ -0,0 +1,475 @@
+/** @file libmetrics.c
+ */
+
+#include <assert.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "libmetrics.h"
+
+#include "../libcheckpoint/libcheckpoint.h"
+
+
+/**
+  Initializes the histogram_t data structure with no values.
+
+  @param histogram a pointer to an instance of the histogram_t data structure
+*/
+void histogram_init(histogram_t *histogram) {
+  memset(histogram->counts, 0, sizeof(histogram->counts));
+  histogram->count = 0;
+  histogram->sum = 0;
+  histogram->min = INT64_MAX;
+  histogram->max = -1;
+}
+
+
+/**
+  Returns the bucket a value is counted in.
+
+  @param value a non-negative value
+  @return the index of the bucket
+*/
+static int bucket_of(int64_t value) {
+  if (value < HISTOGRAM_LINEAR_BUCKETS) {
+    return (int)value;
+  }
+
+  // Keep the 7 most significant bits: the top one picks the power of two, the other 6 the bucket within it
+  int shift = 63 - __builtin_clzll((uint64_t)value) - 6;
+  return HISTOGRAM_LINEAR_BUCKETS + (shift - 1) * (HISTOGRAM_LINEAR_BUCKETS / 2) +
+         (int)((value >> shift) - HISTOGRAM_LINEAR_BUCKETS / 2);
+}
+
+
+/**
+  Returns the largest value counted in a bucket.
+
+  @param bucket the index of the bucket
+  @return the largest value of the bucket
+*/
+static int64_t bucket_max(int bucket) {
+  if (bucket < HISTOGRAM_LINEAR_BUCKETS) {
+    return bucket;
+  }
+
+  int shift = (bucket - HISTOGRAM_LINEAR_BUCKETS) / (HISTOGRAM_LINEAR_BUCKETS / 2) + 1;
+  int64_t top = (bucket - HISTOGRAM_LINEAR_BUCKETS) % (HISTOGRAM_LINEAR_BUCKETS / 2) + HISTOGRAM_LINEAR_BUCKETS / 2;
+  return ((top + 1) << shift) - 1;
+}
+
+
+/**
+  Adds a value to a histogram. A negative value is counted as 0.
+
+  @param histogram a pointer to an instance of the histogram_t data structure
+  @param value the value
+*/
+void histogram_record(histogram_t *histogram, int64_t value) {
+  if (value < 0) {
+    value = 0;
+  }
+
+  histogram->counts[bucket_of(value)]++;
+  histogram->count++;
+  histogram->sum += value;
+  if (value < histogram->min) {
+    histogram->min = value;
+  }
+  if (value > histogram->max) {
+    histogram->max = value;
+  }
+}
+
+
+/**
+  Adds every value of another histogram to a histogram.
+
+  @param histogram a pointer to an instance of the histogram_t data structure
+  @param other the histogram to add
+*/
+void histogram_merge(histogram_t *histogram, const histogram_t *other) {
+  for (int i = 0; i < HISTOGRAM_BUCKETS; ++i) {
+    histogram->counts[i] += other->counts[i];
+  }
+  histogram->count += other->count;
+  histogram->sum += other->sum;
+  if (other->min < histogram->min) {
+    histogram->min = other->min;
+  }
+  if (other->max > histogram->max) {
+    histogram->max = other->max;
+  }
+}
+
+
+/**
+  Returns a percentile of the values of a histogram: the smallest value that
+  at least percentile percent of the values are less than or equal to, to
+  within the precision of its bucket.
+
+  @param histogram a pointer to an instance of the histogram_t data structure
+  @param percentile the percentile, between 0 and 100
+  @return the value at the percentile
+  @return 0 if the histogram is empty
+*/
+int64_t histogram_percentile(const histogram_t *histogram, double percentile) {
+  if (histogram->count == 0) {
+    return 0;
+  }
+
+  // Rank of the value at the percentile, rounded up and between 1 and count
+  double exact = percentile / 100.0 * histogram->count;
+  uint64_t rank = (uint64_t)exact;
+  if ((double)rank < exact) {
+    ++rank;
+  }
+  if (rank < 1) {
+    rank = 1;
+  }
+  if (rank > histogram->count) {
+    rank = histogram->count;
+  }
+
+  uint64_t seen = 0;
+  for (int i = 0; i < HISTOGRAM_BUCKETS; ++i) {
+    seen += histogram->counts[i];
+    if (seen >= rank) {
+      int64_t value = bucket_max(i);
+      return (value > histogram->max) ? histogram->max : (value < histogram->min) ? histogram->min : value;
+    }
+  }
+
+  return histogram->max;
+}
+
+
+/**
+  Returns the mean of the values of a histogram.
+
+  @param histogram a pointer to an instance of the histogram_t data structure
+  @return the mean of the values
+  @return 0 if the histogram is empty
+*/
+double histogram_mean(const histogram_t *histogram) {
+  return (histogram->count == 0) ? 0.0 : (double)histogram->sum / (double)histogram->count;
+}
+
+
+/**
+  Initializes the metrics_t data structure with no jobs.
+
+  @param metrics a pointer to an instance of the metrics_t data structure
+  @param cores the number of cores
+*/
+void metrics_init(metrics_t *metrics, int cores) {
+  histogram_init(&metrics->waiting);
+  histogram_init(&metrics->response);
+  histogram_init(&metrics->turnaround);
+  metrics->window = 1;
+  memset(metrics->windows, 0, sizeof(metrics->windows));
+  metrics->window_count = 0;
+  metrics->cores = cores;
+  metrics->core_busy = (int64_t *)calloc(cores, sizeof(int64_t));
+  metrics->first_arrival = INT64_MAX;
+  metrics->last_finish = -1;
+}
+
+
+/**
+  Doubles the length of the throughput windows of a metrics_t, adding up the
+  jobs of every pair of windows.
+
+  @param metrics a pointer to an instance of the metrics_t data structure
+*/
+static void metrics_widen_windows(metrics_t *metrics) {
+  for (int i = 0; i < METRICS_MAX_WINDOWS / 2; ++i) {
+    metrics->windows[i] = metrics->windows[2 * i] + metrics->windows[2 * i + 1];
+  }
+  memset(&metrics->windows[METRICS_MAX_WINDOWS / 2], 0, METRICS_MAX_WINDOWS / 2 * sizeof(uint64_t));
+  metrics->window *= 2;
+  metrics->window_count = (metrics->window_count + 1) / 2;
+}
+
+
+/**
+  Records the arrival of a job.
+
+  @param metrics a pointer to an instance of the metrics_t data structure
+  @param time the arrival time of the job
+*/
+void metrics_job_arrived(metrics_t *metrics, int64_t time) {
+  if (time < metrics->first_arrival) {
+    metrics->first_arrival = time;
+  }
+}
+
+
+/**
+  Records a finished job.
+
+  The jobs finished per window are kept in METRICS_MAX_WINDOWS windows at
+  most: when a job finishes past the last one, the windows are doubled in
+  length until it fits, so memory stays bounded however long the trace is.
+
+  @param metrics a pointer to an instance of the metrics_t data structure
+  @param arrival_time the arrival time of the job
+  @param running_time the total running time of the job
+  @param start_time the time the job first ran
+  @param time the time the job finished
+*/
+void metrics_job_finished(metrics_t *metrics, int64_t arrival_time, int64_t running_time, int64_t start_time, int64_t time) {
+  histogram_record(&metrics->waiting, time - arrival_time - running_time);
+  histogram_record(&metrics->response, start_time - arrival_time);
+  histogram_record(&metrics->turnaround, time - arrival_time);
+
+  while (time / metrics->window >= METRICS_MAX_WINDOWS) {
+    metrics_widen_windows(metrics);
+  }
+  int window = (int)(time / metrics->window);
+  metrics->windows[window]++;
+  if (window >= metrics->window_count) {
+    metrics->window_count = window + 1;
+  }
+
+  if (time > metrics->last_finish) {
+    metrics->last_finish = time;
+  }
+}
+
+
+/**
+  Records that a core ran a job for some time units.
+
+  @param metrics a pointer to an instance of the metrics_t data structure
+  @param core_id the core
+  @param length the number of time units
+*/
+void metrics_core_ran(metrics_t *metrics, int core_id, int64_t length) {
+  assert(core_id >= 0 && core_id < metrics->cores);
+  metrics->core_busy[core_id] += length;
+}
+
+
+/**
+  Adds the jobs and core time of another metrics_t to a metrics_t, as if both
+  had been collected by one. This is meant for the parts of one workload
+  simulated separately (Eg: by different threads); the busy time of core i is
+  added to core i.
+
+  @param metrics a pointer to an instance of the metrics_t data structure
+  @param other the metrics to add
+*/
+void metrics_merge(metrics_t *metrics, const metrics_t *other) {
+  histogram_merge(&metrics->waiting, &other->waiting);
+  histogram_merge(&metrics->response, &other->response);
+  histogram_merge(&metrics->turnaround, &other->turnaround);
+
+  // Windows are powers of two long, so the shorter ones fold exactly into the longer ones
+  while (metrics->window < other->window) {
+    metrics_widen_windows(metrics);
+  }
+  for (int i = 0; i < other->window_count; ++i) {
+    int window = (int)(i * other->window / metrics->window);
+    metrics->windows[window] += other->windows[i];
+    if (window >= metrics->window_count) {
+      metrics->window_count = window + 1;
+    }
+  }
+
+  if (other->cores > metrics->cores) {
+    metrics->core_busy = (int64_t *)realloc(metrics->core_busy, other->cores * sizeof(int64_t));
+    memset(&metrics->core_busy[metrics->cores], 0, (other->cores - metrics->cores) * sizeof(int64_t));
+    metrics->cores = other->cores;
+  }
+  for (int i = 0; i < other->cores; ++i) {
+    metrics->core_busy[i] += other->core_busy[i];
+  }
+
+  if (other->first_arrival < metrics->first_arrival) {
+    metrics->first_arrival = other->first_arrival;
+  }
+  if (other->last_finish > metrics->last_finish) {
+    metrics->last_finish = other->last_finish;
+  }
+}
+
+
+/**
+  Returns the fraction of the time from the first arrival to the last finish
+  that a core spent running jobs.
+
+  @param metrics a pointer to an instance of the metrics_t data structure
+  @param core_id the core
+  @return the utilization of the core, between 0 and 1
+*/
+double metrics_utilization(const metrics_t *metrics, int core_id) {
+  int64_t span = metrics->last_finish - metrics->first_arrival;
+  return (span <= 0) ? 0.0 : (double)metrics->core_busy[core_id] / (double)span;
+}
+
+
+/**
+  Prints the percentiles of the waiting, response and turnaround times, the
+  throughput and the utilization of every core.
+
+  @param metrics a pointer to an instance of the metrics_t data structure
+  @param file the file to print to
+*/
+void metrics_print(const metrics_t *metrics, FILE *file) {
+  const char *names[] = {"Waiting", "Response", "Turnaround"};
+  const histogram_t *histograms[] = {&metrics->waiting, &metrics->response, &metrics->turnaround};
+
+  for (int i = 0; i < 3; ++i) {
+    fprintf(file,
+            "%s Time: p50 %lld, p95 %lld, p99 %lld, max %lld\n",
+            names[i],
+            (long long)histogram_percentile(histograms[i], 50),
+            (long long)histogram_percentile(histograms[i], 95),
+            (long long)histogram_percentile(histograms[i], 99),
+            (long long)histograms[i]->max);
+  }
+
+  // Only the windows from the first arrival on count towards the throughput
+  if (metrics->window_count > 0) {
+    int first = (int)(metrics->first_arrival / metrics->window);
+    uint64_t low = UINT64_MAX, high = 0;
+    for (int i = first; i < metrics->window_count; ++i) {
+      low = (metrics->windows[i] < low) ? metrics->windows[i] : low;
+      high = (metrics->windows[i] > high) ? metrics->windows[i] : high;
+    }
+    fprintf(file,
+            "Throughput: %.2f jobs per %lld time units (min %llu, max %llu)\n",
+            (double)metrics->waiting.count / (metrics->window_count - first),
+            (long long)metrics->window,
+            (unsigned long long)low,
+            (unsigned long long)high);
+  }
+
+  for (int i = 0; i < metrics->cores; ++i) {
+    fprintf(file, "Core %2d Utilization: %.2f%%\n", i, 100.0 * metrics_utilization(metrics, i));
+  }
+}
+
+
+/**
+  Writes a histogram to a checkpoint, only the buckets that count a value.
+
+  @param histogram a pointer to an instance of the histogram_t data structure
+  @param file the checkpoint
+*/
+static void histogram_save(const histogram_t *histogram, FILE *file) {
+  int used = 0;
+  for (int i = 0; i < HISTOGRAM_BUCKETS; ++i) {
+    used += (histogram->counts[i] != 0);
+  }
+
+  CHECKPOINT_SAVE(file, histogram->count);
+  CHECKPOINT_SAVE(file, histogram->sum);
+  CHECKPOINT_SAVE(file, histogram->min);
+  CHECKPOINT_SAVE(file, histogram->max);
+  CHECKPOINT_SAVE(file, used);
+  for (int i = 0; i < HISTOGRAM_BUCKETS; ++i) {
+    if (histogram->counts[i] != 0) {
+      CHECKPOINT_SAVE(file, i);
+      CHECKPOINT_SAVE(file, histogram->counts[i]);
+    }
+  }
+}
+
+
+/**
+  Reads a histogram written by histogram_save().
+
+  @param histogram a pointer to an instance of the histogram_t data structure
+  @param file the checkpoint
+  @return 0 on success
+  @return -1 if the checkpoint is truncated or malformed
+*/
+static int histogram_load(histogram_t *histogram, FILE *file) {
+  int used = 0;
+
+  histogram_init(histogram);
+  if (CHECKPOINT_LOAD(file, histogram->count) != 1 || CHECKPOINT_LOAD(file, histogram->sum) != 1 ||
+      CHECKPOINT_LOAD(file, histogram->min) != 1 || CHECKPOINT_LOAD(file, histogram->max) != 1 ||
+      CHECKPOINT_LOAD(file, used) != 1 || used < 0 || used > HISTOGRAM_BUCKETS) {
+    return -1;
+  }
+  for (int i = 0; i < used; ++i) {
+    int bucket;
+    if (CHECKPOINT_LOAD(file, bucket) != 1 || bucket < 0 || bucket >= HISTOGRAM_BUCKETS ||
+        CHECKPOINT_LOAD(file, histogram->counts[bucket]) != 1) {
+      return -1;
+    }
+  }
+  return 0;
+}
+
+
+/**
+  Writes a metrics_t to a checkpoint. The histograms only take the space of
+  the buckets that count a value, and the throughput windows of the windows up
+  to the last one a job finished in.
+
+  @param metrics a pointer to an instance of the metrics_t data structure
+  @param file the checkpoint
+*/
+void metrics_save(const metrics_t *metrics, FILE *file) {
+  histogram_save(&metrics->waiting, file);
+  histogram_save(&metrics->response, file);
+  histogram_save(&metrics->turnaround, file);
+  CHECKPOINT_SAVE(file, metrics->window);
+  CHECKPOINT_SAVE(file, metrics->window_count);
+  CHECKPOINT_SAVE_ARRAY(file, metrics->windows, metrics->window_count);
+  CHECKPOINT_SAVE(file, metrics->cores);
+  CHECKPOINT_SAVE_ARRAY(file, metrics->core_busy, metrics->cores);
+  CHECKPOINT_SAVE(file, metrics->first_arrival);
+  CHECKPOINT_SAVE(file, metrics->last_finish);
+}
+
+
+/**
+  Initializes a metrics_t with the metrics written by metrics_save(). The
+  metrics are initialized even if the checkpoint is malformed, and have to be
+  freed with metrics_destroy() either way.
+
+  @param metrics a pointer to an instance of the metrics_t data structure
+  @param file the checkpoint
+  @return 0 on success
+  @return -1 if the checkpoint is truncated or malformed
+*/
+int metrics_load(metrics_t *metrics, FILE *file) {
+  int cores = 0;
+
+  metrics_init(metrics, 0);
+  if (histogram_load(&metrics->waiting, file) != 0 || histogram_load(&metrics->response, file) != 0 ||
+      histogram_load(&metrics->turnaround, file) != 0 || CHECKPOINT_LOAD(file, metrics->window) != 1 ||
+      metrics->window <= 0 || CHECKPOINT_LOAD(file, metrics->window_count) != 1 || metrics->window_count < 0 ||
+      metrics->window_count > METRICS_MAX_WINDOWS ||
+      CHECKPOINT_LOAD_ARRAY(file, metrics->windows, metrics->window_count) != (size_t)metrics->window_count ||
+      CHECKPOINT_LOAD(file, cores) != 1 || cores < 0) {
+    return -1;
+  }
+
+  metrics->core_busy = (int64_t *)realloc(metrics->core_busy, cores * sizeof(int64_t) + 1);
+  metrics->cores = cores;
+  if (CHECKPOINT_LOAD_ARRAY(file, metrics->core_busy, cores) != (size_t)cores ||
+      CHECKPOINT_LOAD(file, metrics->first_arrival) != 1 || CHECKPOINT_LOAD(file, metrics->last_finish) != 1) {
+    return -1;
+  }
+  return 0;
+}
+
+
+/**
+  Frees all the memory associated with the metrics_t data structure.
+
+  @param metrics a pointer to an instance of the metrics_t data structure
+*/
+void metrics_destroy(metrics_t *metrics) {
+  free(metrics->core_busy);
+  metrics->core_busy = NULL;
+  metrics->cores = 0;
+}
@@ -0,0 +1,114 @@
+/** @file libmetrics.h
+ */
+
+#ifndef LIBMETRICS_H_
+#define LIBMETRICS_H_
+
+#include <stdint.h>
+#include <stdio.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * \def HISTOGRAM_LINEAR_BUCKETS
+ * \brief Number of values below which a histogram_t is exact; every power of two above it is split into half as many buckets
+ */
+#define HISTOGRAM_LINEAR_BUCKETS 128
+
+/**
+ * \def HISTOGRAM_BUCKETS
+ * \brief Number of buckets of a histogram_t, enough for any non-negative int64_t
+ */
+#define HISTOGRAM_BUCKETS (HISTOGRAM_LINEAR_BUCKETS + 56 * (HISTOGRAM_LINEAR_BUCKETS / 2))
+
+/**
+ * \def METRICS_MAX_WINDOWS
+ * \brief Number of throughput windows after which a metrics_t doubles the length of its windows
+ */
+#define METRICS_MAX_WINDOWS 4096
+
+/** @struct histogram_t
+ *  @brief Log-linear histogram of non-negative values
+ *
+ *  Values below HISTOGRAM_LINEAR_BUCKETS are counted exactly. Above that,
+ *  each power of two is split into HISTOGRAM_LINEAR_BUCKETS / 2 buckets, so a
+ *  percentile is within 1/64 of the real value whatever the number of values.
+ *  @var histogram_t::counts
+ *  Member 'counts' contains the number of values in each bucket.
+ *  @var histogram_t::count
+ *  Member 'count' contains the number of values.
+ *  @var histogram_t::sum
+ *  Member 'sum' contains the sum of the values.
+ *  @var histogram_t::min
+ *  Member 'min' contains the smallest value, or INT64_MAX if there is none.
+ *  @var histogram_t::max
+ *  Member 'max' contains the largest value, or -1 if there is none.
+ */
+typedef struct histogram_t {
+  uint64_t counts[HISTOGRAM_BUCKETS];
+  uint64_t count;
+  int64_t sum;
+  int64_t min;
+  int64_t max;
+} histogram_t;
+
+/** @struct metrics_t
+ *  @brief Per-job and per-core metrics of a simulation, collected in one pass
+ *  @var metrics_t::waiting
+ *  Member 'waiting' contains the histogram of the waiting time of the finished jobs.
+ *  @var metrics_t::response
+ *  Member 'response' contains the histogram of the response time of the finished jobs.
+ *  @var metrics_t::turnaround
+ *  Member 'turnaround' contains the histogram of the turnaround time of the finished jobs.
+ *  @var metrics_t::window
+ *  Member 'window' contains the length of a throughput window, a power of two.
+ *  @var metrics_t::windows
+ *  Member 'windows' contains the number of jobs that finished in each window; window i starts at time i * window.
+ *  @var metrics_t::window_count
+ *  Member 'window_count' contains the number of windows up to the last one a job finished in.
+ *  @var metrics_t::cores
+ *  Member 'cores' contains the number of cores.
+ *  @var metrics_t::core_busy
+ *  Member 'core_busy' contains the number of time units each core ran a job.
+ *  @var metrics_t::first_arrival
+ *  Member 'first_arrival' contains the arrival time of the first job, or INT64_MAX if there is none.
+ *  @var metrics_t::last_finish
+ *  Member 'last_finish' contains the time the last job finished, or -1 if there is none.
+ */
+typedef struct metrics_t {
+  histogram_t waiting;
+  histogram_t response;
+  histogram_t turnaround;
+  int64_t window;
+  uint64_t windows[METRICS_MAX_WINDOWS];
+  int window_count;
+  int cores;
+  int64_t *core_busy;
+  int64_t first_arrival;
+  int64_t last_finish;
+} metrics_t;
+
+void histogram_init(histogram_t *histogram);
+void histogram_record(histogram_t *histogram, int64_t value);
+void histogram_merge(histogram_t *histogram, const histogram_t *other);
+int64_t histogram_percentile(const histogram_t *histogram, double percentile);
+double histogram_mean(const histogram_t *histogram);
+
+void metrics_init(metrics_t *metrics, int cores);
+void metrics_job_arrived(metrics_t *metrics, int64_t time);
+void metrics_job_finished(metrics_t *metrics, int64_t arrival_time, int64_t running_time, int64_t start_time, int64_t time);
+void metrics_core_ran(metrics_t *metrics, int core_id, int64_t length);
+void metrics_merge(metrics_t *metrics, const metrics_t *other);
+double metrics_utilization(const metrics_t *metrics, int core_id);
+void metrics_print(const metrics_t *metrics, FILE *file);
+void metrics_save(const metrics_t *metrics, FILE *file);
+int metrics_load(metrics_t *metrics, FILE *file);
+void metrics_destroy(metrics_t *metrics);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* LIBMETRICS_H_ */
@@ -3,13 +3,49 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "libpriqueue.h"
 
+/**
+ * \var static const unsigned int MIN_SLAB_NODES;
+ * \brief Number of nodes in the first slab of a queue without a capacity hint
+ */
+static const unsigned int MIN_SLAB_NODES = 16;
+
+/**
+ * \def STAT_ADD
+ * \brief Adds n to one of the priqueue_stats_t counters of q, or does nothing unless STATS is defined
+ */
+#ifdef STATS
+#define STAT_ADD(q, counter, n) ((q)->stats.counter += (n))
+#else
+#define STAT_ADD(q, counter, n) ((void)0)
+#endif
+
+/** @struct node_slab_t
+ *  @brief Block of nodes allocated at once for a priqueue_t
+ *  @var node_slab_t::next
+ *  Member 'next' contains a pointer to the next slab owned by the same queue.
+ *  @var node_slab_t::nodes
+ *  Member 'nodes' contains the nodes of this slab.
+ */
+typedef struct node_slab_t {
+  struct node_slab_t *next;
+  node_t nodes[];
+} node_slab_t;
+
 void priqueue_print(priqueue_t *q, char *str) {
   if (str != NULL) {
     printf("Printing priqueue: %s\n", str);
   }
+  if (q->backend == PRIQUEUE_HEAP) {
+    for (unsigned int i = 0; i < q->size; ++i) {
+      printf("q[%d] = %d, (at = %p, seq = %lu)\n", i, (*(int *)q->heap[i]->data), q->heap[i], q->heap[i]->seq);
+    }
+    return;
+  }
+
   node_t *root = q->root;
   unsigned int i = 0;
   while (root != NULL) {
@@ -20,6 +56,295 @@ void priqueue_print(priqueue_t *q, char *str) {
 }
 
 
+/**
+  Allocates a slab of nodes and adds them to the pool of free nodes.
+
+  @param q a pointer to an instance of the priqueue_t data structure
+  @param count the number of nodes in the slab
+  @return 0 on success, -1 if memory could not be allocated
+*/
+static int pool_grow(priqueue_t *q, unsigned int count) {
+  node_slab_t *slab = (node_slab_t *)malloc(sizeof(node_slab_t) + count * sizeof(node_t));
+  if (slab == NULL) {
+    return -1;
+  }
+  STAT_ADD(q, allocations, 1);
+  slab->next = q->slabs;
+  q->slabs = slab;
+
+  // Thread the new nodes onto the free list, keeping them in address order
+  for (unsigned int i = count; i > 0; --i) {
+    slab->nodes[i - 1].next = q->free_nodes;
+    q->free_nodes = &slab->nodes[i - 1];
+  }
+
+  q->pool_size += count;
+  return 0;
+}
+
+
+/**
+  Takes a node from the pool, growing the pool if it is empty.
+
+  @param q a pointer to an instance of the priqueue_t data structure
+  @return an unused node
+  @return NULL if the pool is empty and memory could not be allocated
+*/
+static node_t *pool_take(priqueue_t *q) {
+  if (q->free_nodes == NULL) {
+    // Double the pool each time it runs out
+    if (pool_grow(q, (q->pool_size < MIN_SLAB_NODES) ? MIN_SLAB_NODES : q->pool_size) != 0) {
+      return NULL;
+    }
+  }
+
+  node_t *node = q->free_nodes;
+  q->free_nodes = node->next;
+  return node;
+}
+
+
+/**
+  Returns a node to the pool.
+
+  @param q a pointer to an instance of the priqueue_t data structure
+  @param node the node to return
+*/
+static void pool_give(priqueue_t *q, node_t *node) {
+  node->data = NULL;
+  node->next = q->free_nodes;
+  q->free_nodes = node;
+}
+
+
+/**
+  Calls the comparer of the queue.
+
+  @param q a pointer to an instance of the priqueue_t data structure
+  @param a the lhs element
+  @param b the rhs element
+  @return the result of the comparer
+*/
+static inline int compare(priqueue_t *q, const void *a, const void *b) {
+  STAT_ADD(q, comparisons, 1);
+  return q->comparer(a, b);
+}
+
+
+/**
+  Determines if node a should be served before node b.
+
+  Ties are broken the same way the PRIQUEUE_LIST backend places nodes: an
+  older node stays ahead of a newer node only if the comparer reports it as
+  strictly less than the newer node.
+
+  @param q a pointer to an instance of the priqueue_t data structure
+  @param a a pointer to the lhs node
+  @param b a pointer to the rhs node
+  @return non-zero if a should be served before b
+*/
+static int heap_before(priqueue_t *q, node_t *a, node_t *b) {
+  if (a->seq < b->seq) {
+    return compare(q, a->data, b->data) < 0;
+  }
+  else {
+    return !(compare(q, b->data, a->data) < 0);
+  }
+}
+
+
+/**
+  Moves the node at index towards the root until the heap property holds.
+
+  @param q a pointer to an instance of the priqueue_t data structure
+  @param index position of the node to move
+  @return the final position of the node
+*/
+static unsigned int heap_sift_up(priqueue_t *q, unsigned int index) {
+  node_t *node = q->heap[index];
+
+  while (index > 0) {
+    unsigned int parent = (index - 1) / 2;
+    if (!heap_before(q, node, q->heap[parent])) {
+      break;
+    }
+    q->heap[index] = q->heap[parent];
+    q->heap[index]->index = index;
+    index = parent;
+    STAT_ADD(q, traversed, 1);
+  }
+
+  q->heap[index] = node;
+  node->index = index;
+  return index;
+}
+
+
+/**
+  Moves the node at index towards the leaves until the heap property holds.
+
+  @param q a pointer to an instance of the priqueue_t data structure
+  @param index position of the node to move
+  @return the final position of the node
+*/
+static unsigned int heap_sift_down(priqueue_t *q, unsigned int index) {
+  node_t *node = q->heap[index];
+
+  while (2 * index + 1 < q->size) {
+    unsigned int child = 2 * index + 1;
+    if (child + 1 < q->size && heap_before(q, q->heap[child + 1], q->heap[child])) {
+      ++child;
+    }
+    if (!heap_before(q, q->heap[child], node)) {
+      break;
+    }
+    q->heap[index] = q->heap[child];
+    q->heap[index]->index = index;
+    index = child;
+    STAT_ADD(q, traversed, 1);
+  }
+
+  q->heap[index] = node;
+  node->index = index;
+  return index;
+}
+
+
+/**
+  Restores the heap property for a node whose key may have moved either way.
+
+  @param q a pointer to an instance of the priqueue_t data structure
+  @param index position of the node to move
+  @return the final position of the node
+*/
+static unsigned int heap_fix(priqueue_t *q, unsigned int index) {
+  unsigned int moved = heap_sift_up(q, index);
+  return (moved == index) ? heap_sift_down(q, index) : moved;
+}
+
+
+/**
+  Adds a node to the heap.
+
+  @param q a pointer to an instance of the priqueue_t data structure
+  @param node the node to add
+  @return 0 on success, -1 if memory could not be allocated
+*/
+static int heap_insert(priqueue_t *q, node_t *node) {
+  // Ensure we have enough memory, keeping the old heap if it cannot grow
+  if (q->size == q->capacity) {
+    unsigned int capacity = (q->capacity == 0) ? 16 : q->capacity * 2;
+    node_t **heap = (node_t **)realloc(q->heap, capacity * sizeof(node_t *));
+    if (heap == NULL) {
+      return -1;
+    }
+    q->heap = heap;
+    q->capacity = capacity;
+    STAT_ADD(q, allocations, 1);
+  }
+
+  q->heap[q->size] = node;
+  ++q->size;
+  heap_sift_up(q, q->size - 1);
+  return 0;
+}
+
+
+/**
+  Detaches a node from the heap without freeing it.
+
+  @param q a pointer to an instance of the priqueue_t data structure
+  @param node the node to detach
+*/
+static void heap_unlink(priqueue_t *q, node_t *node) {
+  unsigned int index = node->index;
+
+  --q->size;
+  if (index != q->size) {
+    // Move the last node into the gap and restore the heap property
+    q->heap[index] = q->heap[q->size];
+    q->heap[index]->index = index;
+    heap_fix(q, index);
+  }
+}
+
+
+/**
+  Links a node into the sorted list.
+
+  @param q a pointer to an instance of the priqueue_t data structure
+  @param node the node to link
+  @return the zero-based index of the node in the list
+*/
+static unsigned int list_insert(priqueue_t *q, node_t *node) {
+  unsigned int index = 0;
+  node_t *temp = q->root;
+  node_t *parent = NULL;
+
+  if (q->backend == PRIQUEUE_FIFO) {
+    // Every element goes behind the ones already queued
+    parent = q->tail;
+    temp = NULL;
+    index = q->size;
+  }
+
+  // Determine location to insert node (ptr)
+  while (temp != NULL && compare(q, temp->data, node->data) < 0) {
+    parent = temp;
+    temp = temp->next;
+    ++index;
+    STAT_ADD(q, traversed, 1);
+  }
+
+  node->prev = parent;
+  node->next = temp;
+  if (temp != NULL) {
+    temp->prev = node;
+  }
+  else {
+    q->tail = node;
+  }
+
+  if (index == 0) {
+    // Insert at front of priqueue
+    q->root = node;
+  }
+  else {
+    // Insert after parent
+    parent->next = node;
+  }
+
+  ++q->size;
+  return index;
+}
+
+
+/**
+  Detaches a node from the list without freeing it.
+
+  @param q a pointer to an instance of the priqueue_t data structure
+  @param node the node to detach
+*/
+static void list_unlink(priqueue_t *q, node_t *node) {
+  if (node->prev == NULL) {
+    // Looking at root node, thus set q->root to node->next
+    q->root = node->next;
+  }
+  else {
+    // Looking at node other than root. Set prev->next to node->next
+    node->prev->next = node->next;
+  }
+  if (node->next != NULL) {
+    node->next->prev = node->prev;
+  }
+  else {
+    q->tail = node->prev;
+  }
+
+  --q->size;
+}
+
+
 /**
 * Initializes the priqueue_t data structure.
 *
@@ -32,9 +357,80 @@ void priqueue_print(priqueue_t *q, char *str) {
 * See also @ref comparer-page
 */
 void priqueue_init(priqueue_t *q, int (*comparer)(const void *, const void *)) {
+  priqueue_init_capacity(q, comparer, PRIQUEUE_LIST, 0);
+}
+
+
+/**
+* Initializes the priqueue_t data structure with the given storage backend.
+*
+* PRIQUEUE_LIST keeps a sorted doubly linked list, so priqueue_at() walks the
+* queue in priority order and priqueue_offer() is O(n).
+* PRIQUEUE_HEAP keeps an array-backed binary heap, so priqueue_offer() and
+* priqueue_poll() are O(log n). Indices used by priqueue_offer(),
+* priqueue_at() and priqueue_remove_at() are heap slots; only index 0 is
+* guaranteed to be the head of the queue. priqueue_sorted() lists the queue
+* in order.
+* PRIQUEUE_FIFO keeps the list of PRIQUEUE_LIST but never calls the comparer
+* on offer: every element is appended in O(1), where PRIQUEUE_LIST would place
+* it for a comparer that always returns -1 (Eg: FCFS and RR).
+*
+* All backends serve elements in the same order for the same sequence of
+* calls (PRIQUEUE_FIFO only for a comparer that always returns -1).
+*
+* @param q a pointer to an instance of the priqueue_t data structure
+* @param comparer a function pointer that compares two elements.
+* See also @ref comparer-page
+* @param backend the storage backend to use
+*/
+void priqueue_init_backend(priqueue_t *q, int (*comparer)(const void *, const void *), priqueue_backend_t backend) {
+  priqueue_init_capacity(q, comparer, backend, 0);
+}
+
+
+/**
+* Initializes the priqueue_t data structure with the given storage backend
+* and a capacity hint.
+*
+* Nodes are taken from a pool owned by the queue and are returned to it when
+* elements leave the queue, so a queue that stays within its capacity never
+* calls malloc() or free() after initialization. The pool grows by doubling
+* when the hint is exceeded.
+*
+* @param q a pointer to an instance of the priqueue_t data structure
+* @param comparer a function pointer that compares two elements.
+* See also @ref comparer-page
+* @param backend the storage backend to use
+* @param capacity the number of elements to preallocate room for, or 0 for no hint
+*/
+void priqueue_init_capacity(priqueue_t *q,
+                            int (*comparer)(const void *, const void *),
+                            priqueue_backend_t backend,
+                            unsigned int capacity) {
   q->root = NULL;
+  q->tail = NULL;
   q->size = 0;
   q->comparer = comparer;
+  q->backend = backend;
+  q->heap = NULL;
+  q->capacity = 0;
+  q->seq = 0;
+  q->free_nodes = NULL;
+  q->slabs = NULL;
+  q->pool_size = 0;
+  memset(&q->stats, 0, sizeof(q->stats));
+
+  // The capacity is only a hint, so if it cannot be allocated the queue grows on demand
+  if (capacity > 0) {
+    pool_grow(q, capacity);
+    if (backend == PRIQUEUE_HEAP) {
+      q->heap = (node_t **)malloc(capacity * sizeof(node_t *));
+      if (q->heap != NULL) {
+        q->capacity = capacity;
+        STAT_ADD(q, allocations, 1);
+      }
+    }
+  }
 }
 
 
@@ -44,48 +440,64 @@ void priqueue_init(priqueue_t *q, int (*comparer)(const void *, const void *)) {
   @param q a pointer to an instance of the priqueue_t data structure
   @param ptr a pointer to the data to be inserted into the priority queue
   @return The zero-based index where ptr is stored in the priority queue, where 0 indicates that ptr was stored at the front of the priority queue.
+  @return PRIQUEUE_OFFER_FAILED if memory could not be allocated
 */
 unsigned int priqueue_offer(priqueue_t *q, void *ptr) {
-  unsigned int index = 0;
+  priqueue_handle_t handle = priqueue_offer_handle(q, ptr);
+  return (handle != NULL) ? handle->index : PRIQUEUE_OFFER_FAILED;
+}
+
+
+/**
+  Insert the specified element into this priority queue and return a handle
+  to it.
+
+  The handle stays valid until the element leaves the queue (through
+  priqueue_poll(), priqueue_remove(), priqueue_remove_at(),
+  priqueue_remove_handle() or priqueue_destroy()).
 
+  @param q a pointer to an instance of the priqueue_t data structure
+  @param ptr a pointer to the data to be inserted into the priority queue
+  @return a handle that can be passed to priqueue_remove_handle() and priqueue_update_handle()
+  @return NULL if memory could not be allocated
+*/
+priqueue_handle_t priqueue_offer_handle(priqueue_t *q, void *ptr) {
 #ifdef DEBUG
   priqueue_print(q, "priqueue_offer, beg");
 #endif
 
   // Create new node and assign data
-  node_t *node = (node_t *)malloc(sizeof(node_t));
+  node_t *node = pool_take(q);
+  if (node == NULL) {
+    return NULL;
+  }
   node->data = ptr;
   node->next = NULL;
+  node->prev = NULL;
+  node->seq = q->seq++;
 
-  node_t *temp = q->root;
-  node_t *parent = NULL;
-
-  // Determine location to insert node (ptr)
-  while (temp != NULL && q->comparer(temp->data, node->data) < 0) {
-    parent = temp;
-    temp = temp->next;
-    ++index;
-  }
-
-  if (index == 0) {
-    // Insert at front of priqueue
-    node->next = q->root;
-    q->root = node;
+  if (q->backend == PRIQUEUE_HEAP) {
+    if (heap_insert(q, node) != 0) {
+      pool_give(q, node);
+      return NULL;
+    }
   }
   else {
-    // Insert after parent
-    parent->next = node;
-    node->next = temp;
+    node->index = list_insert(q, node);
   }
 
-  // Increment size and return index of new node
-  ++q->size;
+  STAT_ADD(q, operations, 1);
+#ifdef STATS
+  if (q->size > q->stats.high_water) {
+    q->stats.high_water = q->size;
+  }
+#endif
 
 #ifdef DEBUG
   priqueue_print(q, "priqueue_offer, end");
 #endif
 
-  return index;
+  return node;
 }
 
 
@@ -98,7 +510,10 @@ unsigned int priqueue_offer(priqueue_t *q, void *ptr) {
   @return NULL if the queue is empty
 */
 void *priqueue_peek(priqueue_t *q) {
-  return (q->size == 0) ? NULL : q->root->data;
+  if (q->size == 0) {
+    return NULL;
+  }
+  return (q->backend == PRIQUEUE_HEAP) ? q->heap[0]->data : q->root->data;
 }
 
 
@@ -120,26 +535,12 @@ void *priqueue_poll(priqueue_t *q) {
   priqueue_print(q, "priqueue_poll, beg");
 #endif
 
-  // Set temp to root of priqueue
-  node_t *temp = q->root;
-
-  // Set root of queue to next node (temp cannot be NULL, as size != 0)
-  q->root = temp->next;
-
-  // store data
-  void *data = temp->data;
-
-  // Delete temp (old root of queue)
-  free(temp);
-  temp = NULL;
+  void *data = priqueue_remove_handle(q, (q->backend == PRIQUEUE_HEAP) ? q->heap[0] : q->root);
 
 #ifdef DEBUG
   priqueue_print(q, "priqueue_poll, end");
 #endif
 
-  // Decrease size
-  --q->size;
-
   // Return data
   return data;
 }
@@ -160,6 +561,11 @@ void *priqueue_at(priqueue_t *q, unsigned int index) {
     return NULL;
   }
 
+  STAT_ADD(q, operations, 1);
+  if (q->backend == PRIQUEUE_HEAP) {
+    return q->heap[index]->data;
+  }
+
   node_t *temp = q->root;
   unsigned int current_position = 0;
 
@@ -167,11 +573,116 @@ void *priqueue_at(priqueue_t *q, unsigned int index) {
     temp = temp->next;
     ++current_position;
   }
+  STAT_ADD(q, traversed, index);
 
   return temp->data;
 }
 
 
+/**
+  Copies the elements of this queue into an array in the order they will be
+  polled, without changing the queue.
+
+  @param q a pointer to an instance of the priqueue_t data structure
+  @param elements an array of at least priqueue_size(q) pointers to fill in
+  @return the number of elements copied
+  @return -1 if memory could not be allocated
+*/
+int priqueue_sorted(priqueue_t *q, void **elements) {
+  if (q->backend == PRIQUEUE_HEAP && q->size > 0) {
+    // Poll a copy of the heap array, so the nodes themselves are not moved
+    node_t **heap = (node_t **)malloc(q->size * sizeof(node_t *));
+    if (heap == NULL) {
+      return -1;
+    }
+    memcpy(heap, q->heap, q->size * sizeof(node_t *));
+
+    for (unsigned int size = q->size; size > 0; --size) {
+      elements[q->size - size] = heap[0]->data;
+
+      // Sift the last node down from the root
+      node_t *node = heap[size - 1];
+      unsigned int index = 0;
+      while (2 * index + 1 < size - 1) {
+        unsigned int child = 2 * index + 1;
+        if (child + 1 < size - 1 && heap_before(q, heap[child + 1], heap[child])) {
+          ++child;
+        }
+        if (!heap_before(q, heap[child], node)) {
+          break;
+        }
+        heap[index] = heap[child];
+        index = child;
+      }
+      heap[index] = node;
+    }
+
+    free(heap);
+    return (int)q->size;
+  }
+
+  int count = 0;
+  for (node_t *temp = q->root; temp != NULL; temp = temp->next) {
+    elements[count++] = temp->data;
+  }
+  return count;
+}
+
+
+/**
+  Compares two heap nodes by the order they were offered in.
+
+  @param a a pointer to the lhs node_t pointer
+  @param b a pointer to the rhs node_t pointer
+  @return a negative number, zero or a positive number if lhs was offered before, with or after rhs
+*/
+static int compare_seq(const void *a, const void *b) {
+  const node_t *lhs = *(node_t *const *)a;
+  const node_t *rhs = *(node_t *const *)b;
+  return (lhs->seq > rhs->seq) - (lhs->seq < rhs->seq);
+}
+
+
+/**
+  Copies the elements of this queue into an array, in an order that rebuilds
+  the same queue when they are offered one at a time to an empty queue with
+  the same comparer and backend, so ties are broken the same way afterwards:
+  queue order for PRIQUEUE_FIFO, reverse queue order for PRIQUEUE_LIST (where
+  an element goes ahead of the older elements it ties with), and the order
+  they were offered in for PRIQUEUE_HEAP.
+
+  @param q a pointer to an instance of the priqueue_t data structure
+  @param elements an array of at least priqueue_size(q) pointers to fill in
+  @return the number of elements copied
+  @return -1 if memory could not be allocated
+*/
+int priqueue_snapshot(priqueue_t *q, void **elements) {
+  STAT_ADD(q, operations, 1);
+  STAT_ADD(q, traversed, q->size);
+
+  if (q->backend == PRIQUEUE_HEAP && q->size > 0) {
+    node_t **nodes = (node_t **)malloc(q->size * sizeof(node_t *));
+    if (nodes == NULL) {
+      return -1;
+    }
+    memcpy(nodes, q->heap, q->size * sizeof(node_t *));
+    qsort(nodes, q->size, sizeof(node_t *), compare_seq);
+    for (unsigned int i = 0; i < q->size; ++i) {
+      elements[i] = nodes[i]->data;
+    }
+    free(nodes);
+    return (int)q->size;
+  }
+
+  int count = 0;
+  for (node_t *temp = q->root; temp != NULL; temp = temp->next) {
+    elements[(q->backend == PRIQUEUE_LIST) ? (int)q->size - 1 - count : count] = temp->data;
+    ++count;
+  }
+  return count;
+}
+
+
 /**
   Removes all instances of ptr from the queue.
 
@@ -183,45 +694,53 @@ void *priqueue_at(priqueue_t *q, unsigned int index) {
 */
 unsigned int priqueue_remove(priqueue_t *q, void *ptr) {
   unsigned int removed = 0;
-  node_t *temp = q->root;
-  node_t *parent = NULL;
 
 #ifdef DEBUG
   priqueue_print(q, "priqueue_remove, beg");
 #endif
 
-  while (temp != NULL) {
-    // Check if temp->data is equal to ptr
-    if (q->comparer(temp->data, ptr) == 0) {
-      if (parent == NULL) {
-        // Looking at root node, thus set q->root to temp->next
-        q->root = temp->next;
+  // Every element is looked at
+  STAT_ADD(q, operations, 1);
+  STAT_ADD(q, traversed, q->size);
+
+  if (q->backend == PRIQUEUE_HEAP) {
+    // Compact the remaining nodes, then rebuild the heap bottom-up
+    unsigned int kept = 0;
+    for (unsigned int i = 0; i < q->size; ++i) {
+      if (compare(q, q->heap[i]->data, ptr) == 0) {
+        pool_give(q, q->heap[i]);
+        ++removed;
       }
       else {
-        // Looking at node other than root. Set parent->next to temp->next
-        parent->next = temp->next;
+        q->heap[kept++] = q->heap[i];
       }
+    }
+    q->size = kept;
+    for (unsigned int i = 0; i < q->size; ++i) {
+      q->heap[i]->index = i;
+    }
+    for (unsigned int i = q->size / 2; i > 0; --i) {
+      heap_sift_down(q, i - 1);
+    }
+    return removed;
+  }
 
+  node_t *temp = q->root;
+  while (temp != NULL) {
+    node_t *next = temp->next;
+
+    // Check if temp->data is equal to ptr
+    if (compare(q, temp->data, ptr) == 0) {
       // Remove node
-      free(temp);
-      temp = NULL;
+      list_unlink(q, temp);
+      pool_give(q, temp);
 
-      // Decrement size and increment count of removed nodes
-      --q->size;
+      // Increment count of removed nodes
       ++removed;
-
-      // Look at next node
-      if (parent == NULL) {
-        temp = q->root;
-      }
-      else {
-        temp = parent->next;
-      }
-    }
-    else {
-      parent = temp;
-      temp = temp->next;
     }
+
+    // Look at next node
+    temp = next;
   }
 
 #ifdef DEBUG
@@ -242,36 +761,78 @@ unsigned int priqueue_remove(priqueue_t *q, void *ptr) {
   @return NULL if the specified index does not exist
 */
 void *priqueue_remove_at(priqueue_t *q, unsigned int index) {
+  if (index >= q->size) {
+    return NULL;
+  }
+
+  if (q->backend == PRIQUEUE_HEAP) {
+    return priqueue_remove_handle(q, q->heap[index]);
+  }
+
   node_t *temp = q->root;
-  node_t *parent = NULL;
-  void *data = NULL;
   unsigned int current_position = 0;
 
-  while (temp != NULL) {
-    if (current_position == index) {
-      if (parent == NULL) {
-        // Looking at root node, thus set q->root to temp->next
-        q->root = temp->next;
-      }
-      else {
-        // Looking at node other than root. Set parent->next to temp->next
-        parent->next = temp->next;
-      }
-      data = temp->data;
-      free(temp);
-      temp = NULL;
-      --q->size;
-      break;
-    }
-    parent = temp;
+  while (current_position < index) {
     temp = temp->next;
     ++current_position;
   }
+  STAT_ADD(q, traversed, index);
+
+  return priqueue_remove_handle(q, temp);
+}
+
+
+/**
+  Removes the element referenced by handle from the queue.
+
+  This is O(1) for PRIQUEUE_LIST and O(log n) for PRIQUEUE_HEAP. The handle
+  is invalid once this function returns.
+
+  @param q a pointer to an instance of the priqueue_t data structure
+  @param handle a handle returned by priqueue_offer_handle() for an element still in q
+  @return the element removed from the queue
+*/
+void *priqueue_remove_handle(priqueue_t *q, priqueue_handle_t handle) {
+  void *data = handle->data;
+
+  STAT_ADD(q, operations, 1);
+  if (q->backend == PRIQUEUE_HEAP) {
+    heap_unlink(q, handle);
+  }
+  else {
+    list_unlink(q, handle);
+  }
 
+  pool_give(q, handle);
   return data;
 }
 
 
+/**
+  Repositions the element referenced by handle after its key has changed.
+
+  The element is placed as if it had been removed and offered again, but the
+  handle stays valid. This is O(log n) for PRIQUEUE_HEAP, O(n) for
+  PRIQUEUE_LIST and O(1) for PRIQUEUE_FIFO, which moves it to the back.
+
+  @param q a pointer to an instance of the priqueue_t data structure
+  @param handle a handle returned by priqueue_offer_handle() for an element still in q
+  @return The zero-based index where the element is now stored in the priority queue
+*/
+unsigned int priqueue_update_handle(priqueue_t *q, priqueue_handle_t handle) {
+  handle->seq = q->seq++;
+
+  STAT_ADD(q, operations, 1);
+  if (q->backend == PRIQUEUE_HEAP) {
+    return heap_fix(q, handle->index);
+  }
+
+  list_unlink(q, handle);
+  handle->index = list_insert(q, handle);
+  return handle->index;
+}
+
+
 /**
   Return the number of elements in the queue.
 
@@ -283,13 +844,40 @@ unsigned int priqueue_size(priqueue_t *q) {
 }
 
 
+/**
+  Returns the operation counters of the queue. They are only kept when the
+  library is built with STATS defined, and are all 0 otherwise.
+
+  @param q a pointer to an instance of the priqueue_t data structure
+  @return the counters of the queue, valid until priqueue_destroy()
+*/
+const priqueue_stats_t *priqueue_stats(priqueue_t *q) {
+  return &q->stats;
+}
+
+
 /**
   Destroys and frees all the memory associated with q.
 
+  The queue's node slabs are released in bulk; elements still in the queue
+  are not freed.
+
   @param q a pointer to an instance of the priqueue_t data structure
 */
 void priqueue_destroy(priqueue_t *q) {
-  while (q->size > 0) {
-    priqueue_remove_at(q, 0);
+  // Every node belongs to a slab, so releasing the slabs releases them all
+  while (q->slabs != NULL) {
+    node_slab_t *slab = q->slabs;
+    q->slabs = slab->next;
+    free(slab);
   }
+  q->root = NULL;
+  q->tail = NULL;
+  q->size = 0;
+  q->free_nodes = NULL;
+  q->pool_size = 0;
+
+  free(q->heap);
+  q->heap = NULL;
+  q->capacity = 0;
 }
@@ -9,46 +9,133 @@ extern "C" {
 #endif
 
 struct node_t;
+struct node_slab_t;
 struct priqueue_t;
 
+/**
+  Constants which represent the different priqueue_t storage backends
+*/
+typedef enum { PRIQUEUE_LIST = 0, PRIQUEUE_HEAP, PRIQUEUE_FIFO } priqueue_backend_t;
+
+/**
+  Returned by priqueue_offer() when memory for the element could not be allocated
+*/
+#define PRIQUEUE_OFFER_FAILED ((unsigned int)-1)
+
 /** @struct node_t
  *  @brief priqueue_t node structure
  *  @var node_t::data
  *  Member 'data' contains a pointer to data contained within this node.
  *  @var node_t::next
- *  Member 'next' contains a pointer to the next node.
+ *  Member 'next' contains a pointer to the next node (PRIQUEUE_LIST and PRIQUEUE_FIFO only).
+ *  @var node_t::prev
+ *  Member 'prev' contains a pointer to the previous node (PRIQUEUE_LIST and PRIQUEUE_FIFO only).
+ *  @var node_t::seq
+ *  Member 'seq' contains the insertion sequence number of this node (PRIQUEUE_HEAP only). It is used to break ties the same way PRIQUEUE_LIST does.
+ *  @var node_t::index
+ *  Member 'index' contains the current heap slot of this node (PRIQUEUE_HEAP), or the position it was linked at (PRIQUEUE_LIST and PRIQUEUE_FIFO).
  */
 typedef struct node_t {
   void *data;
   struct node_t *next;
+  struct node_t *prev;
+  unsigned long seq;
+  unsigned int index;
 } node_t;
 
+/**
+  Opaque reference to an element stored in a priqueue_t. See priqueue_offer_handle()
+*/
+typedef struct node_t *priqueue_handle_t;
+
+/** @struct priqueue_stats_t
+ *  @brief Operation counters of a priqueue_t
+ *
+ *  The counters are only kept when the library is built with STATS defined
+ *  (make STATS=1); otherwise they stay 0 and cost nothing.
+ *  @var priqueue_stats_t::operations
+ *  Member 'operations' contains the number of offers, removals, updates and priqueue_at() calls.
+ *  @var priqueue_stats_t::comparisons
+ *  Member 'comparisons' contains the number of calls to the comparer.
+ *  @var priqueue_stats_t::traversed
+ *  Member 'traversed' contains the number of nodes stepped over by list walks and heap sifts.
+ *  @var priqueue_stats_t::allocations
+ *  Member 'allocations' contains the number of calls to malloc() and realloc().
+ *  @var priqueue_stats_t::high_water
+ *  Member 'high_water' contains the largest number of elements the queue has held.
+ */
+typedef struct priqueue_stats_t {
+  unsigned long operations;
+  unsigned long comparisons;
+  unsigned long traversed;
+  unsigned long allocations;
+  unsigned int high_water;
+} priqueue_stats_t;
+
 
 /** @struct priqueue_t
  *  @brief Priority Queue Structure
  *  @var priqueue_t::root
  *  Member 'root' contains a pointer to the root node of the priority queue.
+ *  @var priqueue_t::tail
+ *  Member 'tail' contains a pointer to the last node of the list (PRIQUEUE_LIST and PRIQUEUE_FIFO only).
  *  @var priqueue_t::size
  *  Member 'size' contains the size of the priority queue.
  *  @var priqueue_t::comparer
  *  Member 'comparer' contains a function to compare two node_t::data values. See @ref comparer-page
+ *  @var priqueue_t::backend
+ *  Member 'backend' contains the storage backend selected when the queue was created.
+ *  @var priqueue_t::heap
+ *  Member 'heap' contains the array-backed binary heap of nodes (PRIQUEUE_HEAP only).
+ *  @var priqueue_t::capacity
+ *  Member 'capacity' contains the number of slots allocated for priqueue_t::heap.
+ *  @var priqueue_t::seq
+ *  Member 'seq' contains the sequence number given to the next offered node.
+ *  @var priqueue_t::free_nodes
+ *  Member 'free_nodes' contains a list (linked through node_t::next) of pooled nodes ready for reuse.
+ *  @var priqueue_t::slabs
+ *  Member 'slabs' contains the list of node slabs owned by this queue.
+ *  @var priqueue_t::pool_size
+ *  Member 'pool_size' contains the total number of nodes allocated across all slabs.
+ *  @var priqueue_t::stats
+ *  Member 'stats' contains the operation counters of this queue. See priqueue_stats()
  */
 typedef struct priqueue_t {
   node_t *root;
+  node_t *tail;
   unsigned int size;
   int (*comparer)(const void *, const void *);
+  priqueue_backend_t backend;
+  node_t **heap;
+  unsigned int capacity;
+  unsigned long seq;
+  node_t *free_nodes;
+  struct node_slab_t *slabs;
+  unsigned int pool_size;
+  priqueue_stats_t stats;
 } priqueue_t;
 
 
 void priqueue_init(priqueue_t *q, int (*comparer)(const void *, const void *));
+void priqueue_init_backend(priqueue_t *q, int (*comparer)(const void *, const void *), priqueue_backend_t backend);
+void priqueue_init_capacity(priqueue_t *q,
+                            int (*comparer)(const void *, const void *),
+                            priqueue_backend_t backend,
+                            unsigned int capacity);
 
 unsigned int priqueue_offer(priqueue_t *q, void *ptr);
+priqueue_handle_t priqueue_offer_handle(priqueue_t *q, void *ptr);
 void *priqueue_peek(priqueue_t *q);
 void *priqueue_poll(priqueue_t *q);
 void *priqueue_at(priqueue_t *q, unsigned int index);
+int priqueue_sorted(priqueue_t *q, void **elements);
+int priqueue_snapshot(priqueue_t *q, void **elements);
 unsigned int priqueue_remove(priqueue_t *q, void *ptr);
 void *priqueue_remove_at(priqueue_t *q, unsigned int index);
+void *priqueue_remove_handle(priqueue_t *q, priqueue_handle_t handle);
+unsigned int priqueue_update_handle(priqueue_t *q, priqueue_handle_t handle);
 unsigned int priqueue_size(priqueue_t *q);
+const priqueue_stats_t *priqueue_stats(priqueue_t *q);
 
 void priqueue_destroy(priqueue_t *q);
 
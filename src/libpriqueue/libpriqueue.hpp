@@ -0,0 +1,251 @@
+/** @file libpriqueue.hpp
+ */
+
+#ifndef LIBPRIQUEUE_HPP_
+#define LIBPRIQUEUE_HPP_
+
+#include <cstddef>
+#include <deque>
+#include <vector>
+
+#include "libpriqueue.h"
+
+namespace priqueue {
+
+/**
+  Comparison policy of a queue that serves elements in arrival order (Eg: FCFS
+  and RR). queue<T, fifo> appends in O(1) and never compares elements.
+*/
+struct fifo {};
+
+/**
+  Comparison policy that calls one of the C comparers of libpriqueue.h (Eg:
+  the scheme comparers of libscheduler.c). The comparer receives pointers to
+  the two elements, and since it is a template argument the compiler can
+  inline it into the queue.
+*/
+template <int (*Comparer)(const void *, const void *)>
+struct function_comparer {
+  /**
+    Compares two elements.
+
+    @param a the first element
+    @param b the second element
+    @return same as the C comparer: negative if a goes first, positive if b goes first
+  */
+  template <typename T>
+  int operator()(const T &a, const T &b) const {
+    return Comparer(&a, &b);
+  }
+};
+
+
+/**
+  Header-only priority queue, parameterized on its comparison policy.
+
+  Compare is a copyable function object with the same convention as the C
+  comparers (negative if the first argument goes first). Elements are stored in
+  an array-backed binary heap, and ties are broken the same way PRIQUEUE_LIST
+  and PRIQUEUE_HEAP do: an element never goes ahead of an older one unless the
+  comparer says so, and never behind a newer one if the comparer says it goes
+  first. So queue<T, Compare> serves elements in the same order as priqueue_t
+  with the same comparer.
+*/
+template <typename T, typename Compare>
+class queue {
+ public:
+  /**
+    Constructs an empty queue.
+
+    @param compare the comparison policy
+  */
+  explicit queue(const Compare &compare = Compare()) : compare_(compare), seq_(0) {}
+
+  /**
+    Inserts the specified element into this queue. This is O(log n).
+
+    @param value the element to insert
+  */
+  void offer(const T &value) {
+    entry_t entry = {value, seq_++};
+    heap_.push_back(entry);
+    sift_up(heap_.size() - 1);
+  }
+
+  /**
+    Retrieves, but does not remove, the head of this queue. The queue must not
+    be empty.
+
+    @return the head of this queue
+  */
+  const T &peek() const {
+    return heap_.front().value;
+  }
+
+  /**
+    Retrieves and removes the head of this queue. The queue must not be empty.
+    This is O(log n).
+
+    @return the head of this queue
+  */
+  T poll() {
+    T value = heap_.front().value;
+    heap_.front() = heap_.back();
+    heap_.pop_back();
+    if (!heap_.empty()) {
+      sift_down(0);
+    }
+    return value;
+  }
+
+  /**
+    Returns the number of elements in the queue.
+
+    @return the number of elements in the queue
+  */
+  std::size_t size() const {
+    return heap_.size();
+  }
+
+  /**
+    Returns true if the queue contains no elements.
+
+    @return true if the queue is empty
+  */
+  bool empty() const {
+    return heap_.empty();
+  }
+
+  /**
+    Removes every element of the queue.
+  */
+  void clear() {
+    heap_.clear();
+  }
+
+ private:
+  struct entry_t {
+    T value;
+    unsigned long seq;
+  };
+
+  // Same tie rule as heap_before() in libpriqueue.c
+  bool before(const entry_t &a, const entry_t &b) const {
+    if (a.seq < b.seq) {
+      return compare_(a.value, b.value) < 0;
+    }
+    return !(compare_(b.value, a.value) < 0);
+  }
+
+  void sift_up(std::size_t i) {
+    entry_t entry = heap_[i];
+    while (i > 0) {
+      std::size_t parent = (i - 1) / 2;
+      if (!before(entry, heap_[parent])) {
+        break;
+      }
+      heap_[i] = heap_[parent];
+      i = parent;
+    }
+    heap_[i] = entry;
+  }
+
+  void sift_down(std::size_t i) {
+    entry_t entry = heap_[i];
+    std::size_t size = heap_.size();
+    while (2 * i + 1 < size) {
+      std::size_t child = 2 * i + 1;
+      if (child + 1 < size && before(heap_[child + 1], heap_[child])) {
+        ++child;
+      }
+      if (!before(heap_[child], entry)) {
+        break;
+      }
+      heap_[i] = heap_[child];
+      i = child;
+    }
+    heap_[i] = entry;
+  }
+
+  Compare compare_;
+  std::vector<entry_t> heap_;
+  unsigned long seq_;
+};
+
+
+/**
+  FIFO specialization of queue (Eg: FCFS and RR). Elements are appended in
+  O(1) and served in the order they were offered, the same order priqueue_t
+  gives for a comparer that always returns -1.
+*/
+template <typename T>
+class queue<T, fifo> {
+ public:
+  /**
+    Constructs an empty queue.
+  */
+  explicit queue(const fifo & = fifo()) {}
+
+  /**
+    Appends the specified element to this queue. This is O(1).
+
+    @param value the element to append
+  */
+  void offer(const T &value) {
+    items_.push_back(value);
+  }
+
+  /**
+    Retrieves, but does not remove, the head of this queue. The queue must not
+    be empty.
+
+    @return the head of this queue
+  */
+  const T &peek() const {
+    return items_.front();
+  }
+
+  /**
+    Retrieves and removes the head of this queue. The queue must not be empty.
+    This is O(1).
+
+    @return the head of this queue
+  */
+  T poll() {
+    T value = items_.front();
+    items_.pop_front();
+    return value;
+  }
+
+  /**
+    Returns the number of elements in the queue.
+
+    @return the number of elements in the queue
+  */
+  std::size_t size() const {
+    return items_.size();
+  }
+
+  /**
+    Returns true if the queue contains no elements.
+
+    @return true if the queue is empty
+  */
+  bool empty() const {
+    return items_.empty();
+  }
+
+  /**
+    Removes every element of the queue.
+  */
+  void clear() {
+    items_.clear();
+  }
+
+ private:
+  std::deque<T> items_;
+};
+
+}  // namespace priqueue
+
+#endif  // LIBPRIQUEUE_HPP_
@@ -4,12 +4,15 @@
 #include <assert.h>
 #include <limits.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
 #include "libscheduler.h"
 
+#include "../libcheckpoint/libcheckpoint.h"
+#include "../libmetrics/libmetrics.h"
 #include "../libpriqueue/libpriqueue.h"
 
 
@@ -22,74 +25,183 @@
  *  @var job_t::running_time
  *  Member 'running_time' contains the total running time of this job (constant).
  *  @var job_t::remaining_time
- *  Member 'remaining_time' contains the current remaining time of this job.
+ *  Member 'remaining_time' contains the remaining time of this job as of last_updated_time. While the job runs, it is only brought up to date when the job is compared against an arriving job or preempted.
  *  @var job_t::priority
  *  Member 'priority' contains the priority of this job (constant).
+ *  @var job_t::level
+ *  Member 'level' contains the MLFQ level of this job, from 0 (the top level). It is always 0 under the other schemes.
+ *  @var job_t::aging_key
+ *  Member 'aging_key' contains, when PRI or PPRI jobs age, priority * aging_interval + arrival_time + the time this job has run while it waits, which orders the waiting jobs by aged priority whatever the time; or its aged priority times aging_interval while it runs, which does not change until it waits again. See scheduler_set_aging_r()
  *  @var job_t::core_number
  *  Member 'core_number' contains the current core running this job.
  *  @var job_t::start_time
  *  Member 'start_time' contains the first start time of this job. This is used to calculate the response time.
  *  @var job_t::last_updated_time
  *  Member 'last_updated_time' contains the last time this job's remaining time was updated.
+ *  @var job_t::handle
+ *  Member 'handle' contains the handle of this job in the queue while it is waiting, or NULL while it is running.
+ *  @var job_t::running_handle
+ *  Member 'running_handle' contains the handle of this job in the running set while it is running under a preemptive scheme, or NULL otherwise.
+ *  @var job_t::next_free
+ *  Member 'next_free' contains the next job of the pool of unused jobs while this job is in the pool.
  */
 typedef struct job_t {
   int id;
-  float arrival_time;
-  float running_time;
-  float remaining_time;
+  int64_t arrival_time;
+  int64_t running_time;
+  int64_t remaining_time;
   int priority;
+  int level;
+  int64_t aging_key;
   int core_number;
-  int start_time;
-  int last_updated_time;
+  int64_t start_time;
+  int64_t last_updated_time;
+  priqueue_handle_t handle;
+  priqueue_handle_t running_handle;
+  struct job_t *next_free;
 } job_t;
 
-/**
- * \var static float total_waiting_time;
- * \brief Total waiting time
+/** @struct job_slab_t
+ *  @brief Block of jobs allocated at once for a scheduler_t
+ *  @var job_slab_t::next
+ *  Member 'next' contains a pointer to the next slab owned by the same scheduler.
+ *  @var job_slab_t::jobs
+ *  Member 'jobs' contains the jobs of this slab.
  */
-static float total_waiting_time;
-
-/**
- * \var static float total_response_time;
- * \brief Total response time
+typedef struct job_slab_t {
+  struct job_slab_t *next;
+  job_t jobs[];
+} job_slab_t;
+
+/** @struct scheduler_t
+ *  @brief State of one scheduler. Independent schedulers share nothing.
+ *
+ *  Times are accumulated as 64-bit integers, so the totals stay exact however
+ *  long the trace is; they are only converted to floating point by
+ *  scheduler_average_waiting_time_r() and friends.
+ *  @var scheduler_t::total_waiting_time
+ *  Member 'total_waiting_time' contains the total waiting time of the finished jobs.
+ *  @var scheduler_t::total_response_time
+ *  Member 'total_response_time' contains the total response time of the finished jobs.
+ *  @var scheduler_t::total_turnaround_time
+ *  Member 'total_turnaround_time' contains the total turnaround time of the finished jobs.
+ *  @var scheduler_t::total_finished_jobs
+ *  Member 'total_finished_jobs' contains the number of finished jobs.
+ *  @var scheduler_t::cores
+ *  Member 'cores' contains the number of cores this scheduler will use.
+ *  @var scheduler_t::core_arr
+ *  Member 'core_arr' contains an array of job_t pointers representing a processor with n cores.
+ *  @var scheduler_t::scheme
+ *  Member 'scheme' contains the scheme to use.
+ *  @var scheduler_t::mode
+ *  Member 'mode' contains whether the cores share one queue or each have their own.
+ *  @var scheduler_t::queues
+ *  Member 'queues' contains the jobs waiting for a core: one queue shared by every core, or one queue per core, for each level. The queue of core q at level l is queues[l * queue_count + q]. Running jobs are only held in scheduler_t::core_arr.
+ *  @var scheduler_t::queue_count
+ *  Member 'queue_count' contains the number of queues of each level in scheduler_t::queues.
+ *  @var scheduler_t::levels
+ *  Member 'levels' contains the number of levels of MLFQ, or 1 under the other schemes.
+ *  @var scheduler_t::level_waiting
+ *  Member 'level_waiting' contains the number of jobs waiting at each level.
+ *  @var scheduler_t::waiting_levels
+ *  Member 'waiting_levels' contains a bitmap of the levels that have jobs waiting.
+ *  @var scheduler_t::mlfq_quantum
+ *  Member 'mlfq_quantum' contains the quantum of the top level of MLFQ.
+ *  @var scheduler_t::boost_period
+ *  Member 'boost_period' contains the time between two priority boosts of MLFQ, or 0 if jobs are never boosted.
+ *  @var scheduler_t::next_boost
+ *  Member 'next_boost' contains the time of the next priority boost, or INT64_MAX.
+ *  @var scheduler_t::aging_interval
+ *  Member 'aging_interval' contains the time units of waiting that raise the priority of a PRI or PPRI job by one, or 0 if jobs do not age.
+ *  @var scheduler_t::next_queue
+ *  Member 'next_queue' contains the per-core queue the next arriving job that has to wait is added to.
+ *  @var scheduler_t::waiting
+ *  Member 'waiting' contains the number of jobs waiting in all of scheduler_t::queues.
+ *  @var scheduler_t::running
+ *  Member 'running' contains the running jobs of a preemptive scheme, with the job an arriving job would preempt at the head.
+ *  @var scheduler_t::idle_cores
+ *  Member 'idle_cores' contains a bitmap of the cores that are not running a job.
+ *  @var scheduler_t::free_jobs
+ *  Member 'free_jobs' contains a list (linked through job_t::next_free) of pooled jobs ready for reuse.
+ *  @var scheduler_t::job_slabs
+ *  Member 'job_slabs' contains the list of job slabs owned by this scheduler.
+ *  @var scheduler_t::job_pool_size
+ *  Member 'job_pool_size' contains the total number of jobs allocated across all slabs.
+ *  @var scheduler_t::busy_since
+ *  Member 'busy_since' contains the time each busy core was given its job.
+ *  @var scheduler_t::metrics
+ *  Member 'metrics' contains the percentiles, throughput and core utilization collected so far. See scheduler_metrics_r()
+ *  @var scheduler_t::stats
+ *  Member 'stats' contains the scheduler's own operation counters. See scheduler_stats_r()
+ *  @var scheduler_t::last_job
+ *  Member 'last_job' contains the id of the last job each core ran, or -1 (only with STATS defined).
  */
-static float total_response_time;
+struct scheduler_t {
+  int64_t total_waiting_time;
+  int64_t total_response_time;
+  int64_t total_turnaround_time;
+  uint64_t total_finished_jobs;
+  unsigned int cores;
+  job_t **core_arr;
+  scheme_t scheme;
+  scheduler_queue_mode_t mode;
+  priqueue_t *queues;
+  unsigned int queue_count;
+  unsigned int levels;
+  unsigned int *level_waiting;
+  uint64_t waiting_levels;
+  int mlfq_quantum;
+  int64_t boost_period;
+  int64_t next_boost;
+  int64_t aging_interval;
+  unsigned int next_queue;
+  unsigned int waiting;
+  priqueue_t running;
+  uint64_t *idle_cores;
+  job_t *free_jobs;
+  job_slab_t *job_slabs;
+  unsigned int job_pool_size;
+  int64_t *busy_since;
+  metrics_t metrics;
+  scheduler_stats_t stats;
+#ifdef STATS
+  int *last_job;
+#endif
+};
 
 /**
- * \var static float total_turnaround_time;
- * \brief Total turnaround time
+ * \var static const unsigned int MIN_SLAB_JOBS;
+ * \brief Number of jobs in the first slab of a scheduler
  */
-static float total_turnaround_time;
+static const unsigned int MIN_SLAB_JOBS = 64;
 
 /**
- * \var static unsigned int total_finished_jobs;
- * \brief Total finished jobs
+ * \def STAT_ADD
+ * \brief Adds n to one of the scheduler_stats_t counters of scheduler, or does nothing unless STATS is defined
  */
-static unsigned int total_finished_jobs;
+#ifdef STATS
+#define STAT_ADD(scheduler, counter, n) ((scheduler)->stats.counter += (n))
+#else
+#define STAT_ADD(scheduler, counter, n) ((void)0)
+#endif
 
 /**
- * \var static unsigned int cores;
- * \brief Number of cores this scheduler will use
+ * \var static scheduler_t *default_scheduler;
+ * \brief Scheduler used by the functions that do not take a scheduler_t
  */
-static unsigned int cores;
+static scheduler_t *default_scheduler;
 
 /**
- * \var static job_t **core_arr;
- * \brief Array of job_t pointers representing a processor with n cores
- */
-static job_t **core_arr;
+  Compares two times.
 
-/**
- * \var static scheme_t scheme;
- * \brief What scheme to use
- */
-static scheme_t scheme;
+  @param lhs the lhs time
+  @param rhs the rhs time
+  @return a negative number, zero or a positive number if lhs is before, the same as or after rhs
+*/
+static inline int compare_time(int64_t lhs, int64_t rhs) {
+  return (lhs > rhs) - (lhs < rhs);
+}
 
-/**
- * \var static priqueue_t queue;
- * \brief Priority queue to hold jobs
- */
-static priqueue_t queue;
 
 /**
 * Compare function for First Come First Serve (FCFS)
@@ -120,10 +232,10 @@ int sjf(const void *a, const void *b) {
   job_t const *rhs = (job_t *)b;
 
   if (lhs->running_time != rhs->running_time) {
-    return lhs->running_time - rhs->running_time;
+    return compare_time(lhs->running_time, rhs->running_time);
   }
   else {
-    return lhs->arrival_time - rhs->arrival_time;
+    return compare_time(lhs->arrival_time, rhs->arrival_time);
   }
 }
 
@@ -141,10 +253,10 @@ int psjf(const void *a, const void *b) {
   job_t const *rhs = (job_t *)b;
 
   if (lhs->remaining_time != rhs->remaining_time) {
-    return lhs->remaining_time - rhs->remaining_time;
+    return compare_time(lhs->remaining_time, rhs->remaining_time);
   }
   else {
-    return lhs->arrival_time - rhs->arrival_time;
+    return compare_time(lhs->arrival_time, rhs->arrival_time);
   }
 }
 
@@ -165,7 +277,7 @@ int pri(const void *a, const void *b) {
     return lhs->priority - rhs->priority;
   }
   else {
-    return lhs->arrival_time - rhs->arrival_time;
+    return compare_time(lhs->arrival_time, rhs->arrival_time);
   }
 }
 
@@ -182,6 +294,34 @@ int ppri(const void *a, const void *b) {
   return pri(a, b);
 }
 
+/**
+* Compare function for Priority (PRI) and Preemptive Priority (PPRI) when jobs
+* age.
+*
+* A waiting job gains one priority level for every aging_interval time units
+* it has waited, so at time t its aged priority, times aging_interval, is
+* aging_key - t. Every waiting job is aged by the same amount as time passes,
+* so comparing aging_key gives the order at any time and the keys never need
+* to be updated while the jobs wait.
+*
+* @param a a pointer to the lhs job_t
+* @param b a pointer to the rhs job_t
+* @return lhs->aging_key - rhs->aging_key, unless they are the same, then lhs->arrival_time - rhs->arrival_time.
+*
+* See also @ref comparer-page
+*/
+int pri_aging(const void *a, const void *b) {
+  job_t const *lhs = (job_t *)a;
+  job_t const *rhs = (job_t *)b;
+
+  if (lhs->aging_key != rhs->aging_key) {
+    return compare_time(lhs->aging_key, rhs->aging_key);
+  }
+  else {
+    return compare_time(lhs->arrival_time, rhs->arrival_time);
+  }
+}
+
 /**
 * Compare function for First Come First Serve (FCFS)
 *
@@ -197,28 +337,460 @@ int rr(const void *a, const void *b) {
   return -1;
 }
 
+/**
+* Compare function for Multi-level Feedback Queue (MLFQ). Each level is
+* served first come first served.
+*
+* @param a a pointer to the lhs job_t
+* @param b a pointer to the rhs job_t
+* @return -1
+*
+* See also @ref comparer-page
+*/
+int mlfq(const void *a, const void *b) {
+  (void)a;
+  (void)b;
+  return -1;
+}
+
+/**
+* Compare function for the running set of Preemptive Shortest Job First (PSJF)
+*
+* Running jobs all count down at the same rate, so the time a job would finish
+* (last_updated_time + remaining_time) keeps their order between updates.
+*
+* @param a a pointer to the lhs job_t
+* @param b a pointer to the rhs job_t
+* @return a negative number if lhs has more time remaining than rhs, or the same time remaining and a lower core_number.
+*
+* See also @ref comparer-page
+*/
+int psjf_victim(const void *a, const void *b) {
+  job_t const *lhs = (job_t *)a;
+  job_t const *rhs = (job_t *)b;
+  int64_t lhs_finish = lhs->last_updated_time + lhs->remaining_time;
+  int64_t rhs_finish = rhs->last_updated_time + rhs->remaining_time;
+
+  if (lhs_finish != rhs_finish) {
+    return compare_time(rhs_finish, lhs_finish);
+  }
+  else {
+    return lhs->core_number - rhs->core_number;
+  }
+}
+
+/**
+* Compare function for the running set of Preemptive Priority (PPRI)
+*
+* @param a a pointer to the lhs job_t
+* @param b a pointer to the rhs job_t
+* @return a negative number if lhs has a lower priority than rhs, or the same priority and a later start_time, or the same start_time and a lower core_number.
+*
+* See also @ref comparer-page
+*/
+int ppri_victim(const void *a, const void *b) {
+  job_t const *lhs = (job_t *)a;
+  job_t const *rhs = (job_t *)b;
+
+  if (lhs->priority != rhs->priority) {
+    return rhs->priority - lhs->priority;
+  }
+  else if (lhs->start_time != rhs->start_time) {
+    return compare_time(rhs->start_time, lhs->start_time);
+  }
+  else {
+    return lhs->core_number - rhs->core_number;
+  }
+}
+
+/**
+* Compare function for the running set of Preemptive Priority (PPRI) when jobs
+* age. A running job does not age, so its aged priority stays the one it had
+* when it was dispatched.
+*
+* @param a a pointer to the lhs job_t
+* @param b a pointer to the rhs job_t
+* @return a negative number if lhs has a lower aged priority than rhs, or the same aged priority and a later start_time, or the same start_time and a lower core_number.
+*
+* See also @ref comparer-page
+*/
+int ppri_aging_victim(const void *a, const void *b) {
+  job_t const *lhs = (job_t *)a;
+  job_t const *rhs = (job_t *)b;
+
+  if (lhs->aging_key != rhs->aging_key) {
+    return compare_time(rhs->aging_key, lhs->aging_key);
+  }
+  else if (lhs->start_time != rhs->start_time) {
+    return compare_time(rhs->start_time, lhs->start_time);
+  }
+  else {
+    return lhs->core_number - rhs->core_number;
+  }
+}
+
+/**
+* Compare function for the running set of Multi-level Feedback Queue (MLFQ)
+*
+* @param a a pointer to the lhs job_t
+* @param b a pointer to the rhs job_t
+* @return a negative number if lhs is at a lower level than rhs, or the same level and a later start_time, or the same start_time and a lower core_number.
+*
+* See also @ref comparer-page
+*/
+int mlfq_victim(const void *a, const void *b) {
+  job_t const *lhs = (job_t *)a;
+  job_t const *rhs = (job_t *)b;
+
+  if (lhs->level != rhs->level) {
+    return rhs->level - lhs->level;
+  }
+  else if (lhs->start_time != rhs->start_time) {
+    return compare_time(rhs->start_time, lhs->start_time);
+  }
+  else {
+    return lhs->core_number - rhs->core_number;
+  }
+}
+
+
+/**
+  Takes an unused job from the pool of a scheduler.
+
+  Jobs are allocated in slabs that double in size each time the pool runs out,
+  and a finished job goes back to the pool, so the jobs of a scheduler stay in
+  a few contiguous blocks and are reused while they are still in the cache.
+
+  @param scheduler the scheduler
+  @return an unused job
+*/
+static job_t *job_take(scheduler_t *scheduler) {
+  if (scheduler->free_jobs == NULL) {
+    unsigned int count = (scheduler->job_pool_size < MIN_SLAB_JOBS) ? MIN_SLAB_JOBS : scheduler->job_pool_size;
+    job_slab_t *slab = (job_slab_t *)malloc(sizeof(job_slab_t) + count * sizeof(job_t));
+    STAT_ADD(scheduler, allocations, 1);
+    slab->next = scheduler->job_slabs;
+    scheduler->job_slabs = slab;
+
+    // Thread the new jobs onto the free list, keeping them in address order
+    for (unsigned int i = count; i > 0; --i) {
+      slab->jobs[i - 1].next_free = scheduler->free_jobs;
+      scheduler->free_jobs = &slab->jobs[i - 1];
+    }
+    scheduler->job_pool_size += count;
+  }
+
+  job_t *job = scheduler->free_jobs;
+  scheduler->free_jobs = job->next_free;
+  return job;
+}
+
+
+/**
+  Returns a job to the pool of a scheduler.
+
+  @param scheduler the scheduler
+  @param job the job to return
+*/
+static void job_give(scheduler_t *scheduler, job_t *job) {
+  job->next_free = scheduler->free_jobs;
+  scheduler->free_jobs = job;
+}
+
+
+/**
+  Adds a waiting job to the queue of its level and records its handle.
+
+  @param scheduler the scheduler
+  @param job the job to add
+  @param core_id the core whose queue the job is added to (ignored if the cores share one queue)
+*/
+static void enqueue(scheduler_t *scheduler, job_t *job, unsigned int core_id) {
+  unsigned int queue_id = (scheduler->queue_count == 1) ? 0 : core_id;
+  if (scheduler->aging_interval > 0) {
+    job->aging_key = job->priority * scheduler->aging_interval + job->arrival_time + job->running_time - job->remaining_time;
+  }
+  job->handle = priqueue_offer_handle(&scheduler->queues[job->level * scheduler->queue_count + queue_id], job);
+  scheduler->waiting++;
+  if (scheduler->level_waiting[job->level]++ == 0) {
+    scheduler->waiting_levels |= (uint64_t)1 << job->level;
+  }
+#ifdef STATS
+  if (scheduler->waiting > scheduler->stats.waiting_high_water) {
+    scheduler->stats.waiting_high_water = scheduler->waiting;
+  }
+#endif
+}
+
+
+/**
+  Adds a job that has to wait when it arrives. With per-core queues, arriving
+  jobs are spread over the cores' queues in turn.
+
+  @param scheduler the scheduler
+  @param job the job to add
+*/
+static void enqueue_arrival(scheduler_t *scheduler, job_t *job) {
+  unsigned int core_id = scheduler->next_queue;
+  scheduler->next_queue = (scheduler->next_queue + 1) % scheduler->queue_count;
+  enqueue(scheduler, job, core_id);
+}
+
+
+/**
+  Removes the next job to run on a core from the queue of the top level that
+  has jobs waiting.
+
+  With per-core queues, a core whose own queue is empty steals the head of the
+  next non-empty queue of that level after its own.
+
+  @param scheduler the scheduler
+  @param core_id the core that will run the job
+  @return the job at the head of the queue
+  @return NULL if every queue is empty
+*/
+static job_t *dequeue(scheduler_t *scheduler, unsigned int core_id) {
+  unsigned int queue_id = (scheduler->queue_count == 1) ? 0 : core_id;
+  job_t *job = NULL;
+
+  if (scheduler->waiting == 0) {
+    return NULL;
+  }
+
+  unsigned int level = __builtin_ctzll(scheduler->waiting_levels);
+  priqueue_t *queues = &scheduler->queues[level * scheduler->queue_count];
+  for (unsigned int i = 0; job == NULL && i < scheduler->queue_count; ++i) {
+    job = priqueue_poll(&queues[(queue_id + i) % scheduler->queue_count]);
+  }
+
+  assert(job != NULL);
+  job->handle = NULL;
+  scheduler->waiting--;
+  if (--scheduler->level_waiting[level] == 0) {
+    scheduler->waiting_levels &= ~((uint64_t)1 << level);
+  }
+  return job;
+}
+
+
+/**
+  Places a job on a core.
+
+  @param scheduler the scheduler
+  @param job the job to run
+  @param core_id the zero-based index of the core the job will run on
+  @param time the current time of the simulator
+*/
+static void dispatch(scheduler_t *scheduler, job_t *job, int core_id, int time) {
+  assert(job->handle == NULL);
+  job->core_number = core_id;
+  if (job->start_time == -1) {
+    job->start_time = time;
+  }
+  job->last_updated_time = time;
+  scheduler->core_arr[core_id] = job;
+  scheduler->busy_since[core_id] = time;
+  scheduler->idle_cores[core_id / 64] &= ~((uint64_t)1 << (core_id % 64));
+  if (scheduler->aging_interval > 0) {
+    job->aging_key -= time;
+  }
+  if (scheduler->scheme == PSJF || scheduler->scheme == PPRI || scheduler->scheme == MLFQ) {
+    job->running_handle = priqueue_offer_handle(&scheduler->running, job);
+  }
+
+  STAT_ADD(scheduler, dispatches, 1);
+#ifdef STATS
+  if (scheduler->last_job[core_id] != -1 && scheduler->last_job[core_id] != job->id) {
+    scheduler->stats.context_switches++;
+  }
+  scheduler->last_job[core_id] = job->id;
+#endif
+}
+
+
+/**
+  Takes the job off a core, leaving the core idle.
+
+  @param scheduler the scheduler
+  @param core_id the zero-based index of the core
+  @param time the current time of the simulator
+  @return the job that was running on the core
+*/
+static job_t *release(scheduler_t *scheduler, int core_id, int time) {
+  job_t *job = scheduler->core_arr[core_id];
+  metrics_core_ran(&scheduler->metrics, core_id, time - scheduler->busy_since[core_id]);
+  if (job->running_handle != NULL) {
+    priqueue_remove_handle(&scheduler->running, job->running_handle);
+    job->running_handle = NULL;
+  }
+  scheduler->core_arr[core_id] = NULL;
+  scheduler->idle_cores[core_id / 64] |= (uint64_t)1 << (core_id % 64);
+  return job;
+}
+
+
+/**
+  Finds the idle core with the lowest id.
+
+  @param scheduler the scheduler
+  @return the zero-based index of the core
+  @return -1 if every core is running a job
+*/
+static int lowest_idle_core(scheduler_t *scheduler) {
+  for (unsigned int i = 0; i < (scheduler->cores + 63) / 64; ++i) {
+    if (scheduler->idle_cores[i] != 0) {
+      return i * 64 + __builtin_ctzll(scheduler->idle_cores[i]);
+    }
+  }
+  return -1;
+}
+
+
+/**
+  Brings the remaining time of a running job up to date.
+
+  Running jobs are not touched as time passes; their remaining time is worked
+  out from when it was last updated only when it is needed.
+
+  @param job the running job
+  @param time the current time of the simulator
+*/
+static void update_remaining_time(job_t *job, int time) {
+  job->remaining_time -= time - job->last_updated_time;
+  job->last_updated_time = time;
+}
+
+
+/**
+  Removes the job running on a core and returns it to the queue.
+
+  @param scheduler the scheduler
+  @param core_id the zero-based index of the core to preempt
+  @param time the current time of the simulator
+*/
+static void preempt(scheduler_t *scheduler, int core_id, int time) {
+  job_t *job = release(scheduler, core_id, time);
+  STAT_ADD(scheduler, preemptions, 1);
+  update_remaining_time(job, time);
+  job->core_number = -1;
+  if (job->start_time == time) {
+    job->start_time = -1;
+  }
+  enqueue(scheduler, job, core_id);
+}
+
+
+/**
+  Applies the priority boost of MLFQ if one is due: every job, waiting or
+  running, goes back to the top level. The waiting jobs of each level are
+  moved, in order, behind those of the levels above, each with an O(1) poll
+  from its level's queue and an O(1) append to the top level's queue.
+
+  Boosts happen every scheduler_t::boost_period time units. A boost is only
+  applied at the next call to the scheduler, but as nothing is decided in
+  between, the result is the same as boosting on time.
+
+  @param scheduler the scheduler
+  @param time the current time of the simulator
+*/
+static void boost(scheduler_t *scheduler, int time) {
+  if (time < scheduler->next_boost) {
+    return;
+  }
+  scheduler->next_boost = time - time % scheduler->boost_period + scheduler->boost_period;
+
+  for (unsigned int level = 1; level < scheduler->levels; ++level) {
+    for (unsigned int i = 0; i < scheduler->queue_count; ++i) {
+      priqueue_t *queue = &scheduler->queues[level * scheduler->queue_count + i];
+      job_t *job;
+      while ((job = priqueue_poll(queue)) != NULL) {
+        job->level = 0;
+        job->handle = priqueue_offer_handle(&scheduler->queues[i], job);
+      }
+    }
+    scheduler->level_waiting[0] += scheduler->level_waiting[level];
+    scheduler->level_waiting[level] = 0;
+  }
+  scheduler->waiting_levels = (scheduler->waiting > 0) ? 1 : 0;
+
+  for (unsigned int i = 0; i < scheduler->cores; ++i) {
+    job_t *job = scheduler->core_arr[i];
+    if (job != NULL && job->level != 0) {
+      job->level = 0;
+      priqueue_update_handle(&scheduler->running, job->running_handle);
+    }
+  }
+}
+
+
+/**
+  Sets up the queues of a scheduler: levels times scheduler_t::queue_count
+  empty queues.
+
+  @param scheduler the scheduler
+  @param levels the number of levels
+  @param comparer the compare function of the queues
+  @param backend the backend of the queues
+*/
+static void init_queues(scheduler_t *scheduler, unsigned int levels, int (*comparer)(const void *, const void *), priqueue_backend_t backend) {
+  scheduler->levels = levels;
+  scheduler->queues = (priqueue_t *)malloc(levels * scheduler->queue_count * sizeof(priqueue_t));
+  for (unsigned int i = 0; i < levels * scheduler->queue_count; ++i) {
+    priqueue_init_backend(&scheduler->queues[i], comparer, backend);
+  }
+  scheduler->level_waiting = (unsigned int *)calloc(levels, sizeof(unsigned int));
+  scheduler->waiting_levels = 0;
+}
+
+
+/**
+  Frees the queues of a scheduler.
+
+  @param scheduler the scheduler
+*/
+static void destroy_queues(scheduler_t *scheduler) {
+  for (unsigned int i = 0; i < scheduler->levels * scheduler->queue_count; ++i) {
+    priqueue_destroy(&scheduler->queues[i]);
+  }
+  free(scheduler->queues);
+  free(scheduler->level_waiting);
+}
+
 
 /**
-  Initalizes the scheduler.
+  Creates a scheduler whose cores either share one queue or each have their
+  own queue.
+
+  With SCHEDULER_PER_CORE_QUEUES, a preempted job or a job whose quantum
+  expired goes back to its core's queue, and an arriving job that has to wait
+  goes to the cores' queues in turn. A core that runs out of work takes the
+  head of its own queue, or steals the head of another core's queue if its own
+  is empty. Dispatching then only looks at one queue, whatever the number of
+  cores, at the cost of jobs only being in order within each queue.
 
   Assumptions:
-    - You may assume this will be the first scheduler function called.
-    - You may assume this function will be called once once.
     - You may assume that cores is a positive, non-zero number.
     - You may assume that scheme is a valid scheduling scheme.
 
-  @param _cores the number of cores that is available by the scheduler.
+  @param cores the number of cores that is available by the scheduler.
    These cores will be known as core(id=0), core(id=1), ..., core(id=cores-1).
-  @param _scheme  the scheduling scheme that should be used. This value will be one of the six enum values of scheme_t
+  @param scheme  the scheduling scheme that should be used. This value will be one of the seven enum values of scheme_t
+  @param mode whether the cores share one queue or each have their own
+  @return the new scheduler, to be freed with scheduler_destroy()
 */
-void scheduler_start_up(int _cores, scheme_t _scheme) {
-  assert(_cores > 0);
-  total_waiting_time = 0.0;
-  total_response_time = 0.0;
-  total_turnaround_time = 0.0;
-  total_finished_jobs = 0;
-  cores = (unsigned int)_cores;
-  scheme = _scheme;
+scheduler_t *scheduler_create_mode(int cores, scheme_t scheme, scheduler_queue_mode_t mode) {
+  assert(cores > 0);
+  scheduler_t *scheduler = (scheduler_t *)malloc(sizeof(scheduler_t));
+  scheduler->total_waiting_time = 0;
+  scheduler->total_response_time = 0;
+  scheduler->total_turnaround_time = 0;
+  scheduler->total_finished_jobs = 0;
+  scheduler->cores = (unsigned int)cores;
+  scheduler->scheme = scheme;
+  scheduler->mode = mode;
+  scheduler->queue_count = (mode == SCHEDULER_PER_CORE_QUEUES) ? scheduler->cores : 1;
+  scheduler->next_queue = 0;
+  scheduler->waiting = 0;
 
   int (*comparer)(const void *, const void *) = NULL;
 
@@ -241,16 +813,165 @@ void scheduler_start_up(int _cores, scheme_t _scheme) {
     case RR:
       comparer = rr;
       break;
+    case MLFQ:
+      comparer = mlfq;
+      break;
     default:
       assert(false);
       break;
   }
 
-  priqueue_init(&queue, comparer);
-  core_arr = (job_t **)malloc(cores * sizeof(job_t *));
-  for (unsigned int i = 0; i < cores; ++i) {
-    core_arr[i] = NULL;
+  // FCFS, RR and the levels of MLFQ always append, so they use the list with an O(1) tail append
+  init_queues(scheduler, (scheme == MLFQ) ? SCHEDULER_MLFQ_LEVELS : 1, comparer,
+              (scheme == FCFS || scheme == RR || scheme == MLFQ) ? PRIQUEUE_FIFO : PRIQUEUE_HEAP);
+  scheduler->mlfq_quantum = SCHEDULER_MLFQ_QUANTUM;
+  scheduler->boost_period = (scheme == MLFQ) ? SCHEDULER_MLFQ_BOOST_QUANTA * SCHEDULER_MLFQ_QUANTUM : 0;
+  scheduler->next_boost = (scheme == MLFQ) ? scheduler->boost_period : INT64_MAX;
+  scheduler->aging_interval = 0;
+  priqueue_init_backend(&scheduler->running, (scheme == PSJF) ? psjf_victim : (scheme == MLFQ) ? mlfq_victim : ppri_victim, PRIQUEUE_HEAP);
+  scheduler->core_arr = (job_t **)malloc(scheduler->cores * sizeof(job_t *));
+  scheduler->idle_cores = (uint64_t *)calloc((scheduler->cores + 63) / 64, sizeof(uint64_t));
+  for (unsigned int i = 0; i < scheduler->cores; ++i) {
+    scheduler->core_arr[i] = NULL;
+    scheduler->idle_cores[i / 64] |= (uint64_t)1 << (i % 64);
+  }
+  scheduler->free_jobs = NULL;
+  scheduler->job_slabs = NULL;
+  scheduler->job_pool_size = 0;
+  scheduler->busy_since = (int64_t *)malloc(scheduler->cores * sizeof(int64_t));
+  metrics_init(&scheduler->metrics, cores);
+  memset(&scheduler->stats, 0, sizeof(scheduler->stats));
+#ifdef STATS
+  scheduler->last_job = (int *)malloc(scheduler->cores * sizeof(int));
+  for (unsigned int i = 0; i < scheduler->cores; ++i) {
+    scheduler->last_job[i] = -1;
   }
+#endif
+
+  return scheduler;
+}
+
+
+/**
+  Creates a scheduler whose cores share one queue.
+
+  Assumptions:
+    - You may assume that cores is a positive, non-zero number.
+    - You may assume that scheme is a valid scheduling scheme.
+
+  @param cores the number of cores that is available by the scheduler.
+   These cores will be known as core(id=0), core(id=1), ..., core(id=cores-1).
+  @param scheme  the scheduling scheme that should be used. This value will be one of the seven enum values of scheme_t
+  @return the new scheduler, to be freed with scheduler_destroy()
+*/
+scheduler_t *scheduler_create(int cores, scheme_t scheme) {
+  return scheduler_create_mode(cores, scheme, SCHEDULER_GLOBAL_QUEUE);
+}
+
+
+/**
+  Initalizes the scheduler used by the functions that do not take a
+  scheduler_t.
+
+  Assumptions:
+    - You may assume this will be the first scheduler function called.
+    - You may assume this function will be called once once.
+    - You may assume that cores is a positive, non-zero number.
+    - You may assume that scheme is a valid scheduling scheme.
+
+  @param _cores the number of cores that is available by the scheduler.
+   These cores will be known as core(id=0), core(id=1), ..., core(id=cores-1).
+  @param _scheme  the scheduling scheme that should be used. This value will be one of the seven enum values of scheme_t
+*/
+void scheduler_start_up(int _cores, scheme_t _scheme) {
+  default_scheduler = scheduler_create(_cores, _scheme);
+}
+
+
+/**
+  Creates the job_t of an arriving job.
+
+  @param scheduler the scheduler
+  @param job_number a globally unique identification number of the job arriving.
+  @param time the current time of the simulator.
+  @param running_time the total number of time units this job will run before it will be finished.
+  @param priority the priority of the job. (The lower the value, the higher the priority.)
+  @return the new job, not yet on a core or in a queue
+*/
+static job_t *new_job(scheduler_t *scheduler, int job_number, int time, int running_time, int priority) {
+  job_t *job = job_take(scheduler);
+
+  job->id = job_number;
+  job->arrival_time = time;
+  job->running_time = running_time;
+  job->remaining_time = running_time;
+  job->priority = priority;
+  job->level = 0;
+  job->aging_key = priority * scheduler->aging_interval + time;
+  job->core_number = -1;
+  job->start_time = -1;
+  job->last_updated_time = -1;
+  job->handle = NULL;
+  job->running_handle = NULL;
+  metrics_job_arrived(&scheduler->metrics, time);
+  return job;
+}
+
+
+/**
+  Schedules an arriving job when every core is busy: it preempts the head of
+  the running set if the scheme is preemptive and the job goes first,
+  otherwise it waits.
+
+  @param scheduler the scheduler
+  @param job the arriving job
+  @param time the current time of the simulator
+  @return index of core that the job is scheduled on
+  @return -1 if the job waits
+*/
+static int arrive_on_busy_cores(scheduler_t *scheduler, job_t *job, int time) {
+  int core_to_run_on = -1;
+
+  // If preemptive try to preempt the head of the running set
+  if (scheduler->scheme == PSJF) {
+    // Preemptive Shortest Job First
+    job_t *victim = priqueue_peek(&scheduler->running);
+    update_remaining_time(victim, time);
+    if (victim->remaining_time > job->remaining_time) {
+      core_to_run_on = victim->core_number;
+    }
+  }
+  else if (scheduler->scheme == PPRI && scheduler->aging_interval > 0) {
+    // Preemptive Priority with aging: the arriving job has not waited, so its key is its aged priority
+    job_t *victim = priqueue_peek(&scheduler->running);
+    if (victim->aging_key > job->aging_key - time) {
+      core_to_run_on = victim->core_number;
+    }
+  }
+  else if (scheduler->scheme == PPRI) {
+    // preemptive Priority
+    job_t *victim = priqueue_peek(&scheduler->running);
+    if (victim->priority > job->priority) {
+      core_to_run_on = victim->core_number;
+    }
+  }
+  else if (scheduler->scheme == MLFQ) {
+    // Multi-level Feedback Queue: an arriving job preempts a job at a lower level
+    job_t *victim = priqueue_peek(&scheduler->running);
+    if (victim->level > job->level) {
+      core_to_run_on = victim->core_number;
+    }
+  }
+
+  if (core_to_run_on == -1) {
+    enqueue_arrival(scheduler, job);
+  }
+  else {
+    preempt(scheduler, core_to_run_on, time);
+    dispatch(scheduler, job, core_to_run_on, time);
+  }
+
+  return core_to_run_on;
 }
 
 
@@ -266,6 +987,7 @@ void scheduler_start_up(int _cores, scheme_t _scheme) {
   Assumption:
     - You may assume that every job wil have a unique arrival time.
 
+  @param scheduler the scheduler
   @param job_number a globally unique identification number of the job arriving.
   @param time the current time of the simulator.
   @param running_time the total number of time units this job will run before it will be finished.
@@ -274,103 +996,84 @@ void scheduler_start_up(int _cores, scheme_t _scheme) {
   @return -1 if no scheduling changes should be made.
 
  */
+int scheduler_new_job_r(scheduler_t *scheduler, int job_number, int time, int running_time, int priority) {
+  boost(scheduler, time);
+  job_t *job = new_job(scheduler, job_number, time, running_time, priority);
+
+  // Attempt to add to core_arr, if available spot
+  int core_to_run_on = lowest_idle_core(scheduler);
+  if (core_to_run_on != -1) {
+    dispatch(scheduler, job, core_to_run_on, time);
+    return core_to_run_on;
+  }
+
+  return arrive_on_busy_cores(scheduler, job, time);
+}
+
+
+/**
+  Same as scheduler_new_job_r(), on the scheduler set up by scheduler_start_up().
+ */
 int scheduler_new_job(int job_number, int time, int running_time, int priority) {
-  job_t *toAdd = (job_t *)malloc(sizeof(job_t));
-
-  toAdd->id = job_number;
-  toAdd->arrival_time = time;
-  toAdd->running_time = running_time;
-  toAdd->remaining_time = running_time;
-  toAdd->priority = priority;
-  toAdd->core_number = -1;
-  toAdd->start_time = -1;
-  toAdd->last_updated_time = -1;
-
-  if (scheme == PSJF) {
-    // Preemptive Shortest Job First
-    for (unsigned int i = 0; i < cores; ++i) {
-      if (core_arr[i] != NULL) {
-        core_arr[i]->remaining_time -= time - core_arr[i]->last_updated_time;
-        core_arr[i]->last_updated_time = time;
-      }
+  return scheduler_new_job_r(default_scheduler, job_number, time, running_time, priority);
+}
+
+
+/**
+  Called when several jobs arrive in the same time unit.
+
+  The result is the same as calling scheduler_new_job_r() for each job in
+  batch order, but the decisions are made in one pass: the leading jobs fill
+  the idle cores in order of core id, one walk of the idle core bitmap, and
+  only the jobs left once every core is busy are compared with the head of the
+  running set, each one either preempting it or being added to the queues.
+  A burst of n jobs costs O(n log n + cores).
+
+  A job that a later job of the same batch preempts is reported as waiting.
+
+  @param scheduler the scheduler
+  @param batch the arriving jobs, in the order they arrive
+  @param count the number of jobs in batch
+  @param time the current time of the simulator.
+  @param cores filled with, for each job of batch, the index of the core it is scheduled on once the whole batch has arrived, or -1 if it waits
+  @return the number of jobs of batch that are scheduled on a core
+ */
+int scheduler_new_jobs_r(scheduler_t *scheduler, const scheduler_arrival_t *batch, int count, int time, int *cores) {
+  int i = 0, placed = 0;
+
+  boost(scheduler, time);
+
+  // Hand the idle cores out to the leading jobs, lowest core id first
+  for (unsigned int word = 0; i < count && word < (scheduler->cores + 63) / 64; ++word) {
+    while (i < count && scheduler->idle_cores[word] != 0) {
+      int core_id = word * 64 + __builtin_ctzll(scheduler->idle_cores[word]);
+      dispatch(scheduler, new_job(scheduler, batch[i].job_number, time, batch[i].running_time, batch[i].priority), core_id, time);
+      cores[i++] = core_id;
     }
   }
 
-  unsigned int index = priqueue_offer(&queue, toAdd);
+  for (; i < count; ++i) {
+    job_t *job = new_job(scheduler, batch[i].job_number, time, batch[i].running_time, batch[i].priority);
+    cores[i] = arrive_on_busy_cores(scheduler, job, time);
+  }
 
-  if (index < cores) {
-    // Attempt to add to core_arr, if available spot
-    for (unsigned int i = 0; i < cores; ++i) {
-      if (core_arr[i] == NULL) {
-        toAdd->core_number = i;
-        toAdd->start_time = time;
-        toAdd->last_updated_time = time;
-        core_arr[i] = toAdd;
-        return i;
-      }
+  // A job placed on a core may have been preempted by a later job of the batch
+  for (i = 0; i < count; ++i) {
+    if (cores[i] != -1 && scheduler->core_arr[cores[i]]->id != batch[i].job_number) {
+      cores[i] = -1;
     }
+    placed += (cores[i] != -1);
+  }
 
-    // no cores are available, if preemptive try to add
-    int core_to_run_on = -1;
-    if (scheme == PSJF || scheme == PPRI) {
-      if (scheme == PSJF) {
-        // Preemptive Shortest Job First
-        float longestTimeRemaining = core_arr[0]->remaining_time;
-        core_to_run_on = 0;
-        for (unsigned int i = 0; i < cores; ++i) {
-          if (core_arr[i]->remaining_time > longestTimeRemaining) {
-            longestTimeRemaining = core_arr[i]->remaining_time;
-            core_to_run_on = i;
-          }
-        }
-        if (longestTimeRemaining > toAdd->remaining_time) {
-          core_arr[core_to_run_on]->core_number = -1;
-          if (core_arr[core_to_run_on]->start_time == time) {
-            core_arr[core_to_run_on]->start_time = -1;
-          }
-          toAdd->core_number = core_to_run_on;
-          toAdd->start_time = time;
-          toAdd->last_updated_time = time;
-          core_arr[core_to_run_on] = toAdd;
-        }
-        else {
-          core_to_run_on = -1;
-        }
-      }
-      else if (scheme == PPRI) {
-        // preemptive Priority
-        int maxPriority = core_arr[0]->priority;
-        core_to_run_on = 0;
-        for (unsigned int i = 0; i < cores; ++i) {
-          if (core_arr[i]->priority == maxPriority && core_arr[i]->start_time > core_arr[core_to_run_on]->start_time) {
-            maxPriority = core_arr[i]->priority;
-            core_to_run_on = i;
-          }
-          else if (core_arr[i]->priority > maxPriority) {
-            maxPriority = core_arr[i]->priority;
-            core_to_run_on = i;
-          }
-        }
-        if (maxPriority > toAdd->priority) {
-          core_arr[core_to_run_on]->core_number = -1;
-          if (core_arr[core_to_run_on]->start_time == time) {
-            core_arr[core_to_run_on]->start_time = -1;
-          }
-          toAdd->core_number = core_to_run_on;
-          toAdd->start_time = time;
-          toAdd->last_updated_time = time;
-          core_arr[core_to_run_on] = toAdd;
-        }
-        else {
-          core_to_run_on = -1;
-        }
-      }
-    }
+  return placed;
+}
 
-    return core_to_run_on;
-  }
 
-  return -1;
+/**
+  Same as scheduler_new_jobs_r(), on the scheduler set up by scheduler_start_up().
+ */
+int scheduler_new_jobs(const scheduler_arrival_t *batch, int count, int time, int *cores) {
+  return scheduler_new_jobs_r(default_scheduler, batch, count, time, cores);
 }
 
 
@@ -383,92 +1086,203 @@ int scheduler_new_job(int job_number, int time, int running_time, int priority)
   finished job, return the job_number of the job that should be scheduled to
   run on core core_id.
 
+  @param scheduler the scheduler
   @param core_id the zero-based index of the core where the job was located.
   @param job_number a globally unique identification number of the job.
   @param time the current time of the simulator.
   @return job_number of the job that should be scheduled to run on core core_id
   @return -1 if core should remain idle.
  */
-int scheduler_job_finished(int core_id, int job_number, int time) {
-  int id = -1;
-  core_arr[core_id] = NULL;
-
-  for (unsigned int i = 0; i < priqueue_size(&queue); ++i) {
-    if (((job_t *)priqueue_at(&queue, i))->id == job_number) {
-      job_t *job = priqueue_remove_at(&queue, i);
-      assert(job->arrival_time != -1);
-      assert(job->running_time != -1);
-      assert(job->start_time != -1);
-      assert(job->last_updated_time != -1);
-      total_waiting_time += time - job->arrival_time - job->running_time;
-      total_response_time += job->start_time - job->arrival_time;
-      total_turnaround_time += time - job->arrival_time;
-      total_finished_jobs++;
-      free(job);
-    }
+int scheduler_job_finished_r(scheduler_t *scheduler, int core_id, int job_number, int time) {
+  boost(scheduler, time);
+  job_t *job = scheduler->core_arr[core_id];
+  assert(job != NULL && job->id == job_number);
+  assert(job->start_time != -1);
+  assert(job->last_updated_time != -1);
+  scheduler->total_waiting_time += time - job->arrival_time - job->running_time;
+  scheduler->total_response_time += job->start_time - job->arrival_time;
+  scheduler->total_turnaround_time += time - job->arrival_time;
+  scheduler->total_finished_jobs++;
+  metrics_job_finished(&scheduler->metrics, job->arrival_time, job->running_time, job->start_time, time);
+  job_give(scheduler, release(scheduler, core_id, time));
+
+  job = dequeue(scheduler, core_id);
+  if (job == NULL) {
+    return -1;
   }
 
-  if (priqueue_size(&queue) != 0) {
-    for (unsigned int i = 0; i < priqueue_size(&queue); ++i) {
-      job_t *job = priqueue_at(&queue, i);
-      if (job->core_number == -1) {
-        job->core_number = core_id;
-        if (job->start_time == -1) {
-          job->start_time = time;
-        }
-        job->last_updated_time = time;
-        id = job->id;
-        core_arr[core_id] = job;
-        break;
-      }
-    }
-  }
+  dispatch(scheduler, job, core_id, time);
+  return job->id;
+}
 
-  return id;
+
+/**
+  Same as scheduler_job_finished_r(), on the scheduler set up by scheduler_start_up().
+ */
+int scheduler_job_finished(int core_id, int job_number, int time) {
+  return scheduler_job_finished_r(default_scheduler, core_id, job_number, time);
 }
 
 
 /**
-  When the scheme is set to RR, called when the quantum timer has expired
-  on a core.
+  When the scheme is set to RR or MLFQ, called when the quantum timer has
+  expired on a core. Under MLFQ, the job that used up its quantum moves down
+  one level, unless it is at the bottom level.
 
   If any job should be scheduled to run on the core free'd up by
   the quantum expiration, return the job_number of the job that should be
   scheduled to run on core core_id.
 
+  @param scheduler the scheduler
   @param core_id the zero-based index of the core where the quantum has expired.
   @param time the current time of the simulator.
   @return job_number of the job that should be scheduled on core cord_id
   @return -1 if core should remain idle
  */
-int scheduler_quantum_expired(int core_id, int time) {
-  int id = -1;
-
-  for (unsigned int i = 0; i < priqueue_size(&queue); ++i) {
-    if (((job_t *)priqueue_at(&queue, i))->id == core_arr[core_id]->id) {
-      job_t *job = priqueue_remove_at(&queue, i);
-      job->core_number = -1;
-      core_arr[core_id] = NULL;
-      priqueue_offer(&queue, job);
-      break;
+int scheduler_quantum_expired_r(scheduler_t *scheduler, int core_id, int time) {
+  boost(scheduler, time);
+  job_t *job = scheduler->core_arr[core_id];
+  if (job != NULL) {
+    release(scheduler, core_id, time);
+    STAT_ADD(scheduler, quantum_expirations, 1);
+    job->core_number = -1;
+    if (job->level + 1 < (int)scheduler->levels) {
+      job->level++;
     }
+    enqueue(scheduler, job, core_id);
   }
 
-  for (unsigned int i = 0; i < priqueue_size(&queue); ++i) {
-    if (((job_t *)priqueue_at(&queue, i))->core_number == -1) {
-      job_t *job = priqueue_at(&queue, i);
-      job->core_number = core_id;
-      core_arr[core_id] = job;
-      if (job->start_time == -1) {
-        job->start_time = time;
-      }
-      job->last_updated_time = time;
-      id = job->id;
-      break;
-    }
+  job = dequeue(scheduler, core_id);
+  if (job == NULL) {
+    return -1;
+  }
+
+  dispatch(scheduler, job, core_id, time);
+  return job->id;
+}
+
+
+/**
+  Same as scheduler_quantum_expired_r(), on the scheduler set up by scheduler_start_up().
+ */
+int scheduler_quantum_expired(int core_id, int time) {
+  return scheduler_quantum_expired_r(default_scheduler, core_id, time);
+}
+
+
+/**
+  Sets the levels, quanta and priority boosts of a scheduler created with
+  MLFQ. Level 0 is the top level and has a quantum of quantum; each level
+  below doubles the quantum of the one above. An arriving job starts at the
+  top level and preempts a job running at a lower level, a job whose quantum
+  expires moves down one level, and every boost_period time units every job
+  goes back to the top level.
+
+  Without a call to this function, an MLFQ scheduler has
+  SCHEDULER_MLFQ_LEVELS levels, a quantum of SCHEDULER_MLFQ_QUANTUM and a
+  boost every SCHEDULER_MLFQ_BOOST_QUANTA quanta of the top level.
+
+  Assumptions:
+    - This function is called before the first job arrives.
+
+  @param scheduler the scheduler
+  @param levels the number of levels, from 1 to SCHEDULER_MLFQ_MAX_LEVELS
+  @param quantum the quantum of the top level
+  @param boost_period the time between two priority boosts, or 0 to never boost
+  @return 0 on success
+  @return -1 if the scheme is not MLFQ, or a parameter is out of range
+ */
+int scheduler_set_mlfq_r(scheduler_t *scheduler, int levels, int quantum, int boost_period) {
+  if (scheduler->scheme != MLFQ || levels < 1 || levels > SCHEDULER_MLFQ_MAX_LEVELS || quantum <= 0 ||
+      quantum > (INT_MAX >> (levels - 1)) || boost_period < 0) {
+    return -1;
+  }
+
+  assert(scheduler->waiting == 0 && priqueue_size(&scheduler->running) == 0);
+  destroy_queues(scheduler);
+  init_queues(scheduler, (unsigned int)levels, mlfq, PRIQUEUE_FIFO);
+  scheduler->mlfq_quantum = quantum;
+  scheduler->boost_period = boost_period;
+  scheduler->next_boost = (boost_period == 0) ? INT64_MAX : boost_period;
+  return 0;
+}
+
+
+/**
+  Same as scheduler_set_mlfq_r(), on the scheduler set up by scheduler_start_up().
+ */
+int scheduler_set_mlfq(int levels, int quantum, int boost_period) {
+  return scheduler_set_mlfq_r(default_scheduler, levels, quantum, boost_period);
+}
+
+
+/**
+  Makes the jobs of a scheduler created with PRI or PPRI age: a job's priority
+  goes up (its value down) by one for every interval time units it waits, so
+  a low priority job cannot starve behind a stream of higher priority ones.
+  Jobs of the same aged priority still go in order of arrival_time.
+
+  The aged priorities are never updated as time passes. Every waiting job
+  ages at the same rate, so the queues are kept in order of a key that does
+  not change while the jobs wait (see pri_aging()), and aging costs nothing
+  more than the O(log n) offers and polls of the heap. A running job does not
+  age.
+
+  Assumptions:
+    - This function is called before the first job arrives.
+
+  @param scheduler the scheduler
+  @param interval the time units of waiting that raise a priority by one, or 0 for no aging
+  @return 0 on success
+  @return -1 if the scheme is not PRI or PPRI, or interval is negative
+ */
+int scheduler_set_aging_r(scheduler_t *scheduler, int interval) {
+  if ((scheduler->scheme != PRI && scheduler->scheme != PPRI) || interval < 0) {
+    return -1;
+  }
+
+  assert(scheduler->waiting == 0 && priqueue_size(&scheduler->running) == 0);
+  destroy_queues(scheduler);
+  init_queues(scheduler, 1, (interval > 0) ? pri_aging : pri, PRIQUEUE_HEAP);
+  priqueue_destroy(&scheduler->running);
+  priqueue_init_backend(&scheduler->running, (interval > 0) ? ppri_aging_victim : ppri_victim, PRIQUEUE_HEAP);
+  scheduler->aging_interval = interval;
+  return 0;
+}
+
+
+/**
+  Same as scheduler_set_aging_r(), on the scheduler set up by scheduler_start_up().
+ */
+int scheduler_set_aging(int interval) {
+  return scheduler_set_aging_r(default_scheduler, interval);
+}
+
+
+/**
+  Returns the quantum of the job running on a core under MLFQ: the quantum of
+  its level. The simulator starts the quantum timer of a core with it each
+  time the core is given a job.
+
+  @param scheduler the scheduler
+  @param core_id the zero-based index of the core
+  @return the quantum of the job running on core core_id
+  @return -1 if the core is idle or the scheme is not MLFQ
+ */
+int scheduler_quantum_r(scheduler_t *scheduler, int core_id) {
+  job_t *job = scheduler->core_arr[core_id];
+  if (scheduler->scheme != MLFQ || job == NULL) {
+    return -1;
   }
+  return scheduler->mlfq_quantum << job->level;
+}
 
-  return id;
+
+/**
+  Same as scheduler_quantum_r(), on the scheduler set up by scheduler_start_up().
+ */
+int scheduler_quantum(int core_id) {
+  return scheduler_quantum_r(default_scheduler, core_id);
 }
 
 
@@ -478,10 +1292,19 @@ int scheduler_quantum_expired(int core_id, int time) {
   Assumptions:
     - This function will only be called after all scheduling is complete
       (all jobs that have arrived will have finished and no new jobs will arrive).
+  @param scheduler the scheduler
   @return the average waiting time of all jobs scheduled.
  */
+float scheduler_average_waiting_time_r(scheduler_t *scheduler) {
+  return (scheduler->total_finished_jobs == 0 ? 0.0 : (double)scheduler->total_waiting_time / (double)scheduler->total_finished_jobs);
+}
+
+
+/**
+  Same as scheduler_average_waiting_time_r(), on the scheduler set up by scheduler_start_up().
+ */
 float scheduler_average_waiting_time() {
-  return (total_finished_jobs == 0 ? 0.0 : total_waiting_time / (float)total_finished_jobs);
+  return scheduler_average_waiting_time_r(default_scheduler);
 }
 
 
@@ -491,10 +1314,19 @@ float scheduler_average_waiting_time() {
   Assumptions:
     - This function will only be called after all scheduling is complete
       (all jobs that have arrived will have finished and no new jobs will arrive).
+  @param scheduler the scheduler
   @return the average turnaround time of all jobs scheduled.
  */
+float scheduler_average_turnaround_time_r(scheduler_t *scheduler) {
+  return (scheduler->total_finished_jobs == 0 ? 0.0 : (double)scheduler->total_turnaround_time / (double)scheduler->total_finished_jobs);
+}
+
+
+/**
+  Same as scheduler_average_turnaround_time_r(), on the scheduler set up by scheduler_start_up().
+ */
 float scheduler_average_turnaround_time() {
-  return (total_finished_jobs == 0 ? 0.0 : total_turnaround_time / (float)total_finished_jobs);
+  return scheduler_average_turnaround_time_r(default_scheduler);
 }
 
 
@@ -504,30 +1336,350 @@ float scheduler_average_turnaround_time() {
   Assumptions:
     - This function will only be called after all scheduling is complete
       (all jobs that have arrived will have finished and no new jobs will arrive).
+  @param scheduler the scheduler
   @return the average response time of all jobs scheduled.
  */
+float scheduler_average_response_time_r(scheduler_t *scheduler) {
+  return (scheduler->total_finished_jobs == 0 ? 0.0 : (double)scheduler->total_response_time / (double)scheduler->total_finished_jobs);
+}
+
+
+/**
+  Same as scheduler_average_response_time_r(), on the scheduler set up by scheduler_start_up().
+ */
 float scheduler_average_response_time() {
-  return (total_finished_jobs == 0 ? 0.0 : total_response_time / (float)total_finished_jobs);
+  return scheduler_average_response_time_r(default_scheduler);
 }
 
 
 /**
-  Free any memory associated with your scheduler.
+  Returns the metrics collected by a scheduler: the percentiles of the
+  waiting, response and turnaround times of the finished jobs, the throughput
+  and the time each core spent running jobs. They are collected as jobs
+  arrive and finish, in memory that does not grow with the number of jobs,
+  and can be added to other metrics with metrics_merge().
+
+  @param scheduler the scheduler
+  @return the metrics of the scheduler, valid until scheduler_destroy()
+ */
+const metrics_t *scheduler_metrics_r(scheduler_t *scheduler) {
+  return &scheduler->metrics;
+}
 
-  Assumption:
-    - This function will be the last function called in your library.
+
+/**
+  Same as scheduler_metrics_r(), on the scheduler set up by scheduler_start_up().
+ */
+const metrics_t *scheduler_metrics() {
+  return scheduler_metrics_r(default_scheduler);
+}
+
+
+/**
+  Fills in the operation counters of a scheduler and of its queues. They are
+  only kept when the library is built with STATS defined, and are all 0
+  otherwise.
+
+  @param scheduler the scheduler
+  @param stats the counters to fill in
+ */
+void scheduler_stats_r(scheduler_t *scheduler, scheduler_stats_t *stats) {
+  *stats = scheduler->stats;
+  for (unsigned int i = 0; i < scheduler->levels * scheduler->queue_count; ++i) {
+    const priqueue_stats_t *queue = priqueue_stats(&scheduler->queues[i]);
+    stats->queues.operations += queue->operations;
+    stats->queues.comparisons += queue->comparisons;
+    stats->queues.traversed += queue->traversed;
+    stats->queues.allocations += queue->allocations;
+    if (queue->high_water > stats->queues.high_water) {
+      stats->queues.high_water = queue->high_water;
+    }
+  }
+  stats->running = *priqueue_stats(&scheduler->running);
+}
+
+
+/**
+  Same as scheduler_stats_r(), on the scheduler set up by scheduler_start_up().
+ */
+void scheduler_stats(scheduler_stats_t *stats) {
+  scheduler_stats_r(default_scheduler, stats);
+}
+
+
+/**
+  Writes a job to a checkpoint.
+
+  @param job the job
+  @param file the checkpoint
 */
-void scheduler_clean_up() {
-  priqueue_destroy(&queue);
+static void job_save(const job_t *job, FILE *file) {
+  CHECKPOINT_SAVE(file, job->id);
+  CHECKPOINT_SAVE(file, job->arrival_time);
+  CHECKPOINT_SAVE(file, job->running_time);
+  CHECKPOINT_SAVE(file, job->remaining_time);
+  CHECKPOINT_SAVE(file, job->priority);
+  CHECKPOINT_SAVE(file, job->level);
+  CHECKPOINT_SAVE(file, job->aging_key);
+  CHECKPOINT_SAVE(file, job->core_number);
+  CHECKPOINT_SAVE(file, job->start_time);
+  CHECKPOINT_SAVE(file, job->last_updated_time);
+}
+
+
+/**
+  Reads a job written by job_save() into a job of the pool of a scheduler.
+
+  @param scheduler the scheduler
+  @param file the checkpoint
+  @return the job, not yet on a core or in a queue
+  @return NULL if the checkpoint is truncated or malformed
+*/
+static job_t *job_load(scheduler_t *scheduler, FILE *file) {
+  job_t *job = job_take(scheduler);
+
+  if (CHECKPOINT_LOAD(file, job->id) != 1 || CHECKPOINT_LOAD(file, job->arrival_time) != 1 ||
+      CHECKPOINT_LOAD(file, job->running_time) != 1 || CHECKPOINT_LOAD(file, job->remaining_time) != 1 ||
+      CHECKPOINT_LOAD(file, job->priority) != 1 || CHECKPOINT_LOAD(file, job->level) != 1 ||
+      CHECKPOINT_LOAD(file, job->aging_key) != 1 || CHECKPOINT_LOAD(file, job->core_number) != 1 ||
+      CHECKPOINT_LOAD(file, job->start_time) != 1 || CHECKPOINT_LOAD(file, job->last_updated_time) != 1 ||
+      job->level < 0 || job->level >= (int)scheduler->levels) {
+    job_give(scheduler, job);
+    return NULL;
+  }
+
+  job->handle = NULL;
+  job->running_handle = NULL;
+  return job;
+}
+
+
+/**
+  Writes the whole state of a scheduler to a checkpoint: its settings, its
+  totals and metrics, and every running and waiting job. The jobs of each
+  queue, and of the running set, are written in the order that rebuilds the
+  queue exactly (see priqueue_snapshot()), so a scheduler read back by
+  scheduler_load() makes the same decisions, ties included.
+
+  @param scheduler the scheduler
+  @param file the checkpoint
+  @return 0 on success
+  @return -1 if writing failed
+ */
+int scheduler_save_r(scheduler_t *scheduler, FILE *file) {
+  unsigned int capacity = scheduler->cores;
+  for (unsigned int q = 0; q < scheduler->levels * scheduler->queue_count; ++q) {
+    if (priqueue_size(&scheduler->queues[q]) > capacity) {
+      capacity = priqueue_size(&scheduler->queues[q]);
+    }
+  }
+  job_t **jobs = (job_t **)malloc(capacity * sizeof(job_t *));
+  if (jobs == NULL) {
+    return -1;
+  }
+
+  CHECKPOINT_SAVE(file, scheduler->cores);
+  CHECKPOINT_SAVE(file, scheduler->scheme);
+  CHECKPOINT_SAVE(file, scheduler->mode);
+  CHECKPOINT_SAVE(file, scheduler->levels);
+  CHECKPOINT_SAVE(file, scheduler->mlfq_quantum);
+  CHECKPOINT_SAVE(file, scheduler->boost_period);
+  CHECKPOINT_SAVE(file, scheduler->aging_interval);
+  CHECKPOINT_SAVE(file, scheduler->next_boost);
+  CHECKPOINT_SAVE(file, scheduler->next_queue);
+  CHECKPOINT_SAVE(file, scheduler->total_waiting_time);
+  CHECKPOINT_SAVE(file, scheduler->total_response_time);
+  CHECKPOINT_SAVE(file, scheduler->total_turnaround_time);
+  CHECKPOINT_SAVE(file, scheduler->total_finished_jobs);
+  CHECKPOINT_SAVE_ARRAY(file, scheduler->busy_since, scheduler->cores);
+  CHECKPOINT_SAVE(file, scheduler->stats);
+  metrics_save(&scheduler->metrics, file);
+
+  int count = 0;
+  if (scheduler->scheme == PSJF || scheduler->scheme == PPRI || scheduler->scheme == MLFQ) {
+    count = priqueue_snapshot(&scheduler->running, (void **)jobs);
+    if (count < 0) {
+      free(jobs);
+      return -1;
+    }
+  }
+  else {
+    for (unsigned int i = 0; i < scheduler->cores; ++i) {
+      if (scheduler->core_arr[i] != NULL) {
+        jobs[count++] = scheduler->core_arr[i];
+      }
+    }
+  }
+  CHECKPOINT_SAVE(file, count);
+  for (int i = 0; i < count; ++i) {
+    job_save(jobs[i], file);
+  }
 
-  for (unsigned int i = 0; i < cores; ++i) {
-    if (core_arr[i] != NULL) {
-      free(core_arr[i]);
-      core_arr[i] = NULL;
+  for (unsigned int q = 0; q < scheduler->levels * scheduler->queue_count; ++q) {
+    count = priqueue_snapshot(&scheduler->queues[q], (void **)jobs);
+    if (count < 0) {
+      free(jobs);
+      return -1;
+    }
+    CHECKPOINT_SAVE(file, count);
+    for (int i = 0; i < count; ++i) {
+      job_save(jobs[i], file);
     }
   }
 
-  free(core_arr);
+  free(jobs);
+  return ferror(file) ? -1 : 0;
+}
+
+
+/**
+  Same as scheduler_save_r(), on the scheduler set up by scheduler_start_up().
+ */
+int scheduler_save(FILE *file) {
+  return scheduler_save_r(default_scheduler, file);
+}
+
+
+/**
+  Reads the settings of a scheduler written by scheduler_save_r() and creates
+  a scheduler with them.
+
+  @param file the checkpoint
+  @return the new scheduler, with no jobs
+  @return NULL if the checkpoint is truncated or malformed
+*/
+static scheduler_t *scheduler_load_settings(FILE *file) {
+  unsigned int cores, levels;
+  scheme_t scheme;
+  scheduler_queue_mode_t mode;
+  int mlfq_quantum;
+  int64_t boost_period, aging_interval;
+
+  if (CHECKPOINT_LOAD(file, cores) != 1 || CHECKPOINT_LOAD(file, scheme) != 1 || CHECKPOINT_LOAD(file, mode) != 1 ||
+      CHECKPOINT_LOAD(file, levels) != 1 || CHECKPOINT_LOAD(file, mlfq_quantum) != 1 ||
+      CHECKPOINT_LOAD(file, boost_period) != 1 || CHECKPOINT_LOAD(file, aging_interval) != 1) {
+    return NULL;
+  }
+  if (cores == 0 || cores > INT_MAX || scheme < FCFS || scheme > MLFQ ||
+      (mode != SCHEDULER_GLOBAL_QUEUE && mode != SCHEDULER_PER_CORE_QUEUES) || boost_period > INT_MAX ||
+      aging_interval > INT_MAX || (scheme != MLFQ && levels != 1)) {
+    return NULL;
+  }
+
+  scheduler_t *scheduler = scheduler_create_mode((int)cores, scheme, mode);
+  if ((scheme == MLFQ && scheduler_set_mlfq_r(scheduler, (int)levels, mlfq_quantum, (int)boost_period) != 0) ||
+      ((scheme == PRI || scheme == PPRI) && scheduler_set_aging_r(scheduler, (int)aging_interval) != 0) ||
+      (scheme != PRI && scheme != PPRI && aging_interval != 0)) {
+    scheduler_destroy(scheduler);
+    return NULL;
+  }
+  return scheduler;
+}
+
+
+/**
+  Creates a scheduler from a checkpoint written by scheduler_save_r(), in the
+  state it was saved in.
+
+  @param file the checkpoint
+  @return the new scheduler, to be freed with scheduler_destroy()
+  @return NULL if the checkpoint is truncated or malformed
+ */
+scheduler_t *scheduler_load(FILE *file) {
+  scheduler_t *scheduler = scheduler_load_settings(file);
+  if (scheduler == NULL) {
+    return NULL;
+  }
+
+  unsigned int count;
+  metrics_destroy(&scheduler->metrics);
+  if (CHECKPOINT_LOAD(file, scheduler->next_boost) != 1 || CHECKPOINT_LOAD(file, scheduler->next_queue) != 1 ||
+      CHECKPOINT_LOAD(file, scheduler->total_waiting_time) != 1 ||
+      CHECKPOINT_LOAD(file, scheduler->total_response_time) != 1 ||
+      CHECKPOINT_LOAD(file, scheduler->total_turnaround_time) != 1 ||
+      CHECKPOINT_LOAD(file, scheduler->total_finished_jobs) != 1 ||
+      CHECKPOINT_LOAD_ARRAY(file, scheduler->busy_since, scheduler->cores) != scheduler->cores ||
+      CHECKPOINT_LOAD(file, scheduler->stats) != 1 || metrics_load(&scheduler->metrics, file) != 0 ||
+      scheduler->metrics.cores != (int)scheduler->cores || scheduler->next_queue >= scheduler->queue_count ||
+      CHECKPOINT_LOAD(file, count) != 1 || count > scheduler->cores) {
+    scheduler_destroy(scheduler);
+    return NULL;
+  }
+
+  // Running jobs are put back on their cores, and in the running set in the order they were saved in
+  for (unsigned int i = 0; i < count; ++i) {
+    job_t *job = job_load(scheduler, file);
+    if (job == NULL || job->core_number < 0 || job->core_number >= (int)scheduler->cores ||
+        scheduler->core_arr[job->core_number] != NULL) {
+      scheduler_destroy(scheduler);
+      return NULL;
+    }
+    scheduler->core_arr[job->core_number] = job;
+    scheduler->idle_cores[job->core_number / 64] &= ~((uint64_t)1 << (job->core_number % 64));
+    if (scheduler->scheme == PSJF || scheduler->scheme == PPRI || scheduler->scheme == MLFQ) {
+      job->running_handle = priqueue_offer_handle(&scheduler->running, job);
+    }
+  }
+
+  for (unsigned int q = 0; q < scheduler->levels * scheduler->queue_count; ++q) {
+    if (CHECKPOINT_LOAD(file, count) != 1) {
+      scheduler_destroy(scheduler);
+      return NULL;
+    }
+    for (unsigned int i = 0; i < count; ++i) {
+      job_t *job = job_load(scheduler, file);
+      if (job == NULL || job->level != (int)(q / scheduler->queue_count)) {
+        scheduler_destroy(scheduler);
+        return NULL;
+      }
+      job->handle = priqueue_offer_handle(&scheduler->queues[q], job);
+      scheduler->waiting++;
+      if (scheduler->level_waiting[job->level]++ == 0) {
+        scheduler->waiting_levels |= (uint64_t)1 << job->level;
+      }
+    }
+  }
+
+  return scheduler;
+}
+
+
+/**
+  Frees a scheduler and every job it still holds.
+
+  @param scheduler the scheduler
+*/
+void scheduler_destroy(scheduler_t *scheduler) {
+  destroy_queues(scheduler);
+  priqueue_destroy(&scheduler->running);
+
+  // Every job, waiting, running or unused, lives in one of the slabs
+  while (scheduler->job_slabs != NULL) {
+    job_slab_t *slab = scheduler->job_slabs;
+    scheduler->job_slabs = slab->next;
+    free(slab);
+  }
+
+  free(scheduler->core_arr);
+  free(scheduler->idle_cores);
+  free(scheduler->busy_since);
+  metrics_destroy(&scheduler->metrics);
+#ifdef STATS
+  free(scheduler->last_job);
+#endif
+  free(scheduler);
+}
+
+
+/**
+  Free any memory associated with your scheduler.
+
+  Assumption:
+    - This function will be the last function called in your library.
+*/
+void scheduler_clean_up() {
+  scheduler_destroy(default_scheduler);
+  default_scheduler = NULL;
 }
 
 
@@ -546,10 +1698,41 @@ void scheduler_clean_up() {
 
   This function is not required and will not be graded. You may leave it
   blank if you do not find it useful.
+
+  @param scheduler the scheduler
  */
-void scheduler_show_queue() {
-  for (unsigned int i = 0; i < priqueue_size(&queue); ++i) {
-    job_t *job = priqueue_at(&queue, i);
-    fprintf(stdout, "%u(%d) ", job->id, job->priority);
+void scheduler_show_queue_r(scheduler_t *scheduler) {
+  // RR ignores the priorities, so the sample output shows them as -1
+  for (unsigned int i = 0; i < scheduler->cores; ++i) {
+    if (scheduler->core_arr[i] != NULL) {
+      job_t *job = scheduler->core_arr[i];
+      fprintf(stdout, "%u(%d) ", job->id, (scheduler->scheme == RR) ? -1 : job->priority);
+    }
   }
+
+  // priqueue_at() walks a heap in slot order, so the waiting jobs are copied out in the order they will run
+  for (unsigned int q = 0; q < scheduler->levels * scheduler->queue_count; ++q) {
+    unsigned int size = priqueue_size(&scheduler->queues[q]);
+    if (size == 0) {
+      continue;
+    }
+    void **jobs = (void **)malloc(size * sizeof(void *));
+    if (jobs == NULL || priqueue_sorted(&scheduler->queues[q], jobs) < 0) {
+      free(jobs);
+      return;
+    }
+    for (unsigned int i = 0; i < size; ++i) {
+      job_t *job = (job_t *)jobs[i];
+      fprintf(stdout, "%u(%d) ", job->id, (scheduler->scheme == RR) ? -1 : job->priority);
+    }
+    free(jobs);
+  }
+}
+
+
+/**
+  Same as scheduler_show_queue_r(), on the scheduler set up by scheduler_start_up().
+ */
+void scheduler_show_queue() {
+  scheduler_show_queue_r(default_scheduler);
 }
@@ -4,20 +4,145 @@
 #ifndef LIBSCHEDULER_H_
 #define LIBSCHEDULER_H_
 
+#include <stdio.h>
+
+#include "../libpriqueue/libpriqueue.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct metrics_t;
+
 /**
   Constants which represent the different scheduling algorithms
 */
-typedef enum { FCFS = 0, SJF, PSJF, PRI, PPRI, RR } scheme_t;
+typedef enum { FCFS = 0, SJF, PSJF, PRI, PPRI, RR, MLFQ } scheme_t;
+
+/**
+ * \def SCHEDULER_MLFQ_LEVELS
+ * \brief Default number of levels of MLFQ. See scheduler_set_mlfq_r()
+ */
+#define SCHEDULER_MLFQ_LEVELS 3
+
+/**
+ * \def SCHEDULER_MLFQ_MAX_LEVELS
+ * \brief Largest number of levels of MLFQ
+ */
+#define SCHEDULER_MLFQ_MAX_LEVELS 16
+
+/**
+ * \def SCHEDULER_MLFQ_QUANTUM
+ * \brief Default quantum of the top level of MLFQ; each level below doubles the quantum of the one above
+ */
+#define SCHEDULER_MLFQ_QUANTUM 2
+
+/**
+ * \def SCHEDULER_MLFQ_BOOST_QUANTA
+ * \brief Default time between two priority boosts of MLFQ, in quanta of the top level
+ */
+#define SCHEDULER_MLFQ_BOOST_QUANTA 32
+
+/**
+  Whether the cores of a scheduler share one queue of waiting jobs, or each
+  core has its own queue and steals from the others when it runs out of work.
+*/
+typedef enum { SCHEDULER_GLOBAL_QUEUE = 0, SCHEDULER_PER_CORE_QUEUES } scheduler_queue_mode_t;
+
+/**
+  Opaque state of one scheduler. Any number of schedulers may be used at once,
+  as long as each one is only used by one thread at a time.
+*/
+typedef struct scheduler_t scheduler_t;
+
+/** @struct scheduler_arrival_t
+ *  @brief A job arriving in a batch. See scheduler_new_jobs_r()
+ *  @var scheduler_arrival_t::job_number
+ *  Member 'job_number' contains a globally unique identification number of the job.
+ *  @var scheduler_arrival_t::running_time
+ *  Member 'running_time' contains the total number of time units the job will run.
+ *  @var scheduler_arrival_t::priority
+ *  Member 'priority' contains the priority of the job (the lower the value, the higher the priority).
+ */
+typedef struct scheduler_arrival_t {
+  int job_number;
+  int running_time;
+  int priority;
+} scheduler_arrival_t;
+
+/** @struct scheduler_stats_t
+ *  @brief Operation counters of a scheduler_t. See scheduler_stats_r()
+ *
+ *  Like priqueue_stats_t, the counters are only kept when the library is
+ *  built with STATS defined (make STATS=1), and are all 0 otherwise.
+ *  @var scheduler_stats_t::dispatches
+ *  Member 'dispatches' contains the number of times a job was placed on a core.
+ *  @var scheduler_stats_t::context_switches
+ *  Member 'context_switches' contains the number of dispatches of a job other than the last one its core ran.
+ *  @var scheduler_stats_t::preemptions
+ *  Member 'preemptions' contains the number of running jobs preempted by an arriving job.
+ *  @var scheduler_stats_t::quantum_expirations
+ *  Member 'quantum_expirations' contains the number of running jobs sent back to the queue when their quantum expired.
+ *  @var scheduler_stats_t::allocations
+ *  Member 'allocations' contains the number of calls to malloc() for job slabs.
+ *  @var scheduler_stats_t::waiting_high_water
+ *  Member 'waiting_high_water' contains the largest number of jobs that have waited at once, over all queues.
+ *  @var scheduler_stats_t::queues
+ *  Member 'queues' contains the counters of the queues of waiting jobs, added up; its high_water is the largest of any one queue.
+ *  @var scheduler_stats_t::running
+ *  Member 'running' contains the counters of the running set of a preemptive scheme.
+ */
+typedef struct scheduler_stats_t {
+  unsigned long dispatches;
+  unsigned long context_switches;
+  unsigned long preemptions;
+  unsigned long quantum_expirations;
+  unsigned long allocations;
+  unsigned int waiting_high_water;
+  priqueue_stats_t queues;
+  priqueue_stats_t running;
+} scheduler_stats_t;
+
+scheduler_t *scheduler_create(int cores, scheme_t scheme);
+scheduler_t *scheduler_create_mode(int cores, scheme_t scheme, scheduler_queue_mode_t mode);
+int scheduler_new_job_r(scheduler_t *scheduler, int job_number, int time, int running_time, int priority);
+int scheduler_new_jobs_r(scheduler_t *scheduler, const scheduler_arrival_t *batch, int count, int time, int *cores);
+int scheduler_job_finished_r(scheduler_t *scheduler, int core_id, int job_number, int time);
+int scheduler_quantum_expired_r(scheduler_t *scheduler, int core_id, int time);
+int scheduler_set_mlfq_r(scheduler_t *scheduler, int levels, int quantum, int boost_period);
+int scheduler_quantum_r(scheduler_t *scheduler, int core_id);
+int scheduler_set_aging_r(scheduler_t *scheduler, int interval);
+float scheduler_average_turnaround_time_r(scheduler_t *scheduler);
+float scheduler_average_waiting_time_r(scheduler_t *scheduler);
+float scheduler_average_response_time_r(scheduler_t *scheduler);
+const struct metrics_t *scheduler_metrics_r(scheduler_t *scheduler);
+void scheduler_stats_r(scheduler_t *scheduler, scheduler_stats_t *stats);
+int scheduler_save_r(scheduler_t *scheduler, FILE *file);
+scheduler_t *scheduler_load(FILE *file);
+void scheduler_destroy(scheduler_t *scheduler);
+
+void scheduler_show_queue_r(scheduler_t *scheduler);
 
 void scheduler_start_up(int cores, scheme_t scheme);
 int scheduler_new_job(int job_number, int time, int running_time, int priority);
+int scheduler_new_jobs(const scheduler_arrival_t *batch, int count, int time, int *cores);
 int scheduler_job_finished(int core_id, int job_number, int time);
 int scheduler_quantum_expired(int core_id, int time);
+int scheduler_set_mlfq(int levels, int quantum, int boost_period);
+int scheduler_quantum(int core_id);
+int scheduler_set_aging(int interval);
 float scheduler_average_turnaround_time();
 float scheduler_average_waiting_time();
 float scheduler_average_response_time();
+const struct metrics_t *scheduler_metrics();
+void scheduler_stats(scheduler_stats_t *stats);
+int scheduler_save(FILE *file);
 void scheduler_clean_up();
 
 void scheduler_show_queue();
 
+#ifdef __cplusplus
+}
+#endif
+
 #endif /* LIBSCHEDULER_H_ */
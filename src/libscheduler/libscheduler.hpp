@@ -0,0 +1,479 @@
+/** @file libscheduler.hpp
+ */
+
+#ifndef LIBSCHEDULER_HPP_
+#define LIBSCHEDULER_HPP_
+
+#include <cstddef>
+#include <cstdio>
+#include <utility>
+#include <vector>
+
+#include "libscheduler.h"
+
+namespace scheduler {
+
+/**
+  Non-owning view of a contiguous array, like the std::span of C++20. It is
+  what the batch API of context takes and returns, so callers can pass C
+  arrays, std::vector or pointer and count without copying.
+*/
+template <typename T>
+class span {
+ public:
+  /**
+    Constructs an empty span.
+  */
+  span() : data_(NULL), size_(0) {}
+
+  /**
+    Constructs a span of count elements starting at data.
+
+    @param data the first element
+    @param size the number of elements
+  */
+  span(T *data, std::size_t size) : data_(data), size_(size) {}
+
+  /**
+    Constructs a span of a whole C array.
+
+    @param array the array
+  */
+  template <std::size_t N>
+  span(T (&array)[N]) : data_(array), size_(N) {}
+
+  /**
+    Constructs a span of the elements of a vector.
+
+    @param vector the vector
+  */
+  template <typename U, typename Allocator>
+  span(std::vector<U, Allocator> &vector) : data_(vector.empty() ? NULL : &vector[0]), size_(vector.size()) {}
+
+  /**
+    Constructs a span of the elements of a vector.
+
+    @param vector the vector
+  */
+  template <typename U, typename Allocator>
+  span(const std::vector<U, Allocator> &vector) : data_(vector.empty() ? NULL : &vector[0]), size_(vector.size()) {}
+
+  /**
+    Returns the element at index i, which must be less than size().
+
+    @param i the index
+    @return the element
+  */
+  T &operator[](std::size_t i) const {
+    return data_[i];
+  }
+
+  /**
+    Returns the first element.
+
+    @return a pointer to the first element
+  */
+  T *begin() const {
+    return data_;
+  }
+
+  /**
+    Returns the end of the elements.
+
+    @return a pointer one past the last element
+  */
+  T *end() const {
+    return data_ + size_;
+  }
+
+  /**
+    Returns the first element.
+
+    @return a pointer to the first element
+  */
+  T *data() const {
+    return data_;
+  }
+
+  /**
+    Returns the number of elements.
+
+    @return the number of elements
+  */
+  std::size_t size() const {
+    return size_;
+  }
+
+  /**
+    Returns true if the span has no elements.
+
+    @return true if the span is empty
+  */
+  bool empty() const {
+    return size_ == 0;
+  }
+
+ private:
+  T *data_;
+  std::size_t size_;
+};
+
+
+/** @struct completion
+ *  @brief A job that finished running on a core. See context::step()
+ *  @var completion::core_id
+ *  Member 'core_id' contains the core the job ran on.
+ *  @var completion::job_number
+ *  Member 'job_number' contains the job that finished.
+ */
+struct completion {
+  int core_id;
+  int job_number;
+};
+
+/** @struct dispatch
+ *  @brief A decision of the scheduler: which job a core runs from now on
+ *
+ *  Every finish and quantum expiry gives one dispatch for its core, with
+ *  job_number -1 if the core goes idle. An arriving job gives one if it is
+ *  scheduled on a core, with the job it preempted as previous.
+ *  @var dispatch::core_id
+ *  Member 'core_id' contains the core.
+ *  @var dispatch::job_number
+ *  Member 'job_number' contains the job the core runs now, or -1 if it is idle.
+ *  @var dispatch::previous
+ *  Member 'previous' contains the job the core ran before (the finished, expired or preempted one), or -1 if it was idle.
+ */
+struct dispatch {
+  int core_id;
+  int job_number;
+  int previous;
+};
+
+
+/**
+  Owning C++ interface to one scheduler_t, for driving the scheduler from
+  another simulator's clock.
+
+  A context is move-only: moving it hands over the scheduler, and the
+  scheduler is destroyed with the last context that owns it. The context
+  keeps the job running on each core, so every decision comes back as a
+  dispatch with the job it replaced. Calls make no heap allocations of their
+  own: the buffers of the batch API are reused from step to step, and only
+  grow when a step has more events than any step before it. (The scheduler
+  itself allocates its jobs in slabs, see scheduler_stats_t::allocations.)
+
+  Like scheduler_t, a context may only be used by one thread at a time.
+*/
+class context {
+ public:
+  /**
+    Creates a scheduler. See scheduler_create_mode().
+
+    @param cores the number of cores that is available by the scheduler
+    @param scheme the scheduling scheme that should be used
+    @param mode whether the cores share one queue or each core has its own
+  */
+  context(int cores, scheme_t scheme, scheduler_queue_mode_t mode = SCHEDULER_GLOBAL_QUEUE)
+      : scheduler_(scheduler_create_mode(cores, scheme, mode)), running_(cores, -1) {
+    dispatches_.reserve(cores);
+  }
+
+  /**
+    Takes the scheduler of other, which owns no scheduler afterwards.
+
+    @param other the context to move from
+  */
+  context(context &&other) noexcept
+      : scheduler_(other.scheduler_),
+        running_(std::move(other.running_)),
+        cores_(std::move(other.cores_)),
+        dispatches_(std::move(other.dispatches_)) {
+    other.scheduler_ = NULL;
+  }
+
+  /**
+    Destroys the scheduler of this context and takes the scheduler of other,
+    which owns no scheduler afterwards.
+
+    @param other the context to move from
+    @return this context
+  */
+  context &operator=(context &&other) noexcept {
+    if (this != &other) {
+      if (scheduler_ != NULL) {
+        scheduler_destroy(scheduler_);
+      }
+      scheduler_ = other.scheduler_;
+      running_.swap(other.running_);
+      cores_.swap(other.cores_);
+      dispatches_.swap(other.dispatches_);
+      other.scheduler_ = NULL;
+    }
+    return *this;
+  }
+
+  context(const context &) = delete;
+  context &operator=(const context &) = delete;
+
+  /**
+    Destroys the scheduler, if this context still owns it.
+  */
+  ~context() {
+    if (scheduler_ != NULL) {
+      scheduler_destroy(scheduler_);
+    }
+  }
+
+  /**
+    Returns true if this context owns a scheduler, false once it has been
+    moved from.
+
+    @return true if the context owns a scheduler
+  */
+  explicit operator bool() const {
+    return scheduler_ != NULL;
+  }
+
+  /**
+    Returns the scheduler, for the parts of libscheduler.h this class does
+    not wrap. Jobs must not be started or stopped through it, or running()
+    would no longer match the scheduler.
+
+    @return the scheduler
+  */
+  scheduler_t *get() const {
+    return scheduler_;
+  }
+
+  /**
+    Returns the number of cores.
+
+    @return the number of cores
+  */
+  int cores() const {
+    return static_cast<int>(running_.size());
+  }
+
+  /**
+    Returns the job running on a core.
+
+    @param core_id the core
+    @return the job running on core core_id, or -1 if it is idle
+  */
+  int running(int core_id) const {
+    return running_[core_id];
+  }
+
+  /**
+    Called when a new job arrives. See scheduler_new_job_r().
+
+    @param job_number globally unique identification number of the job arriving
+    @param time the current time of the simulator
+    @param running_time the total number of time units this job will run before it will be finished
+    @param priority the priority of the job (the lower the value, the higher the priority)
+    @return the dispatch of the job, with core_id -1 if it waits
+  */
+  dispatch new_job(int job_number, int time, int running_time, int priority) {
+    int core_id = scheduler_new_job_r(scheduler_, job_number, time, running_time, priority);
+    return place(core_id, job_number);
+  }
+
+  /**
+    Called when a job has completed execution. See scheduler_job_finished_r().
+
+    @param core_id the zero-based index of the core where the job was located
+    @param job_number a globally unique identification number of the job
+    @param time the current time of the simulator
+    @return the dispatch of the core
+  */
+  dispatch job_finished(int core_id, int job_number, int time) {
+    return replace(core_id, scheduler_job_finished_r(scheduler_, core_id, job_number, time));
+  }
+
+  /**
+    Called when the quantum of a job running on a core expires. See
+    scheduler_quantum_expired_r().
+
+    @param core_id the zero-based index of the core where the quantum has expired
+    @param time the current time of the simulator
+    @return the dispatch of the core
+  */
+  dispatch quantum_expired(int core_id, int time) {
+    return replace(core_id, scheduler_quantum_expired_r(scheduler_, core_id, time));
+  }
+
+  /**
+    Delivers every event of one time unit and calls on_dispatch with each
+    decision, in the order the simulator delivers them: the finished jobs,
+    then the expired quanta, then the arrivals, each in the order given.
+
+    Each expired core must still run a job. As with scheduler_new_jobs_r(),
+    the arrivals are decided in one batch, and an arriving job that a later
+    one preempts is reported as waiting.
+
+    @param time the current time of the simulator
+    @param finished the jobs that finished
+    @param expired the cores whose quantum expired
+    @param arrivals the jobs that arrive
+    @param on_dispatch called as on_dispatch(const dispatch &) for each decision
+  */
+  template <typename OnDispatch>
+  void step(int time,
+            span<const completion> finished,
+            span<const int> expired,
+            span<const scheduler_arrival_t> arrivals,
+            OnDispatch on_dispatch) {
+    for (std::size_t i = 0; i < finished.size(); ++i) {
+      on_dispatch(job_finished(finished[i].core_id, finished[i].job_number, time));
+    }
+    for (std::size_t i = 0; i < expired.size(); ++i) {
+      on_dispatch(quantum_expired(expired[i], time));
+    }
+    if (arrivals.empty()) {
+      return;
+    }
+
+    if (cores_.size() < arrivals.size()) {
+      cores_.resize(arrivals.size());
+    }
+    scheduler_new_jobs_r(scheduler_, arrivals.data(), static_cast<int>(arrivals.size()), time, &cores_[0]);
+    for (std::size_t i = 0; i < arrivals.size(); ++i) {
+      if (cores_[i] != -1) {
+        on_dispatch(place(cores_[i], arrivals[i].job_number));
+      }
+    }
+  }
+
+  /**
+    Same as the step() that takes a callback, but returns the decisions.
+
+    @param time the current time of the simulator
+    @param finished the jobs that finished
+    @param expired the cores whose quantum expired
+    @param arrivals the jobs that arrive
+    @return the decisions, valid until the next call to step()
+  */
+  span<const dispatch> step(int time,
+                            span<const completion> finished,
+                            span<const int> expired,
+                            span<const scheduler_arrival_t> arrivals) {
+    dispatches_.clear();
+    step(time, finished, expired, arrivals, [this](const dispatch &decision) { dispatches_.push_back(decision); });
+    return span<const dispatch>(dispatches_);
+  }
+
+  /**
+    Returns the quantum of the job running on a core. See scheduler_quantum_r().
+
+    @param core_id the zero-based index of the core
+    @return the quantum, or -1 if the core is idle or the scheme is not MLFQ
+  */
+  int quantum(int core_id) const {
+    return scheduler_quantum_r(scheduler_, core_id);
+  }
+
+  /**
+    Sets up the levels of MLFQ. See scheduler_set_mlfq_r().
+
+    @param levels the number of levels
+    @param quantum the quantum of the top level
+    @param boost_period the time between two priority boosts, or 0
+    @return 0 on success, -1 if the scheme is not MLFQ or a parameter is out of range
+  */
+  int set_mlfq(int levels, int quantum, int boost_period) {
+    return scheduler_set_mlfq_r(scheduler_, levels, quantum, boost_period);
+  }
+
+  /**
+    Sets up the aging of PRI and PPRI. See scheduler_set_aging_r().
+
+    @param interval the time units of waiting that raise the priority of a job by one, or 0
+    @return 0 on success, -1 if the scheme is not PRI or PPRI or interval is negative
+  */
+  int set_aging(int interval) {
+    return scheduler_set_aging_r(scheduler_, interval);
+  }
+
+  /**
+    Returns the average waiting time of all jobs scheduled so far.
+
+    @return the average waiting time
+  */
+  float average_waiting_time() const {
+    return scheduler_average_waiting_time_r(scheduler_);
+  }
+
+  /**
+    Returns the average turnaround time of all jobs scheduled so far.
+
+    @return the average turnaround time
+  */
+  float average_turnaround_time() const {
+    return scheduler_average_turnaround_time_r(scheduler_);
+  }
+
+  /**
+    Returns the average response time of all jobs scheduled so far.
+
+    @return the average response time
+  */
+  float average_response_time() const {
+    return scheduler_average_response_time_r(scheduler_);
+  }
+
+  /**
+    Returns the metrics of the finished jobs. See scheduler_metrics_r().
+
+    @return the metrics, owned by the scheduler
+  */
+  const struct metrics_t *metrics() const {
+    return scheduler_metrics_r(scheduler_);
+  }
+
+  /**
+    Returns the operation counters. See scheduler_stats_r().
+
+    @return the counters, all 0 unless built with STATS defined
+  */
+  scheduler_stats_t stats() const {
+    scheduler_stats_t stats;
+    scheduler_stats_r(scheduler_, &stats);
+    return stats;
+  }
+
+  /**
+    Saves the whole state of the scheduler. See scheduler_save_r().
+
+    @param file the file
+    @return 0 on success, -1 if writing failed
+  */
+  int save(std::FILE *file) const {
+    return scheduler_save_r(scheduler_, file);
+  }
+
+ private:
+  dispatch place(int core_id, int job_number) {
+    dispatch decision = {core_id, job_number, -1};
+    if (core_id != -1) {
+      decision.previous = running_[core_id];
+      running_[core_id] = job_number;
+    }
+    return decision;
+  }
+
+  dispatch replace(int core_id, int job_number) {
+    dispatch decision = {core_id, job_number, running_[core_id]};
+    running_[core_id] = job_number;
+    return decision;
+  }
+
+  scheduler_t *scheduler_;
+  std::vector<int> running_;
+  std::vector<int> cores_;
+  std::vector<dispatch> dispatches_;
+};
+
+}  // namespace scheduler
+
+#endif  // LIBSCHEDULER_HPP_
@@ -0,0 +1,168 @@
+/** @file libshard.c
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "libshard.h"
+
+#include "../libcheckpoint/libcheckpoint.h"
+#include "../libmetrics/libmetrics.h"
+
+
+/**
+  Parses a shard given as i/n, the shard index from 0 to n - 1 and the number
+  of shards (Eg: "3/16").
+
+  @param arg the argument
+  @param shard set to the shard index
+  @param shards set to the number of shards
+  @return 0 on success
+  @return -1 if the argument is not a shard
+*/
+int shard_parse(const char *arg, int *shard, int *shards) {
+  char *end;
+  long index = strtol(arg, &end, 10);
+  if (end == arg || *end != '/') {
+    return -1;
+  }
+
+  const char *count_arg = end + 1;
+  long count = strtol(count_arg, &end, 10);
+  if (end == count_arg || *end != '\0' || count <= 0 || count > 1000000 || index < 0 || index >= count) {
+    return -1;
+  }
+
+  *shard = (int)index;
+  *shards = (int)count;
+  return 0;
+}
+
+
+/**
+  Returns whether a task of a sweep belongs to a shard. The tasks are dealt
+  out in turn, so each shard gets an even share of every trace and of every
+  configuration.
+
+  @param task the number of the task, trace * configs + config
+  @param shard the shard index
+  @param shards the number of shards
+  @return non-zero if the shard simulates the task
+*/
+int shard_owns(int task, int shard, int shards) {
+  return task % shards == shard;
+}
+
+
+/**
+  Writes the header of a shard summary.
+
+  @param file the file
+  @param header the header; its magic is filled in
+  @return 0 on success, -1 if writing failed
+*/
+int shard_write_header(FILE *file, const shard_header_t *header) {
+  shard_header_t copy = *header;
+  memcpy(copy.magic, SHARD_MAGIC, 4);
+  return (CHECKPOINT_SAVE(file, copy) == 1) ? 0 : -1;
+}
+
+
+/**
+  Writes the result of one task to a shard summary.
+
+  @param file the file
+  @param record the result
+  @return 0 on success, -1 if writing failed
+*/
+int shard_write_record(FILE *file, const shard_record_t *record) {
+  int32_t length = (int32_t)strlen(record->trace_name);
+
+  CHECKPOINT_SAVE(file, record->task);
+  CHECKPOINT_SAVE(file, record->cores);
+  CHECKPOINT_SAVE(file, record->scheme);
+  CHECKPOINT_SAVE(file, record->quantum);
+  CHECKPOINT_SAVE(file, record->status);
+  CHECKPOINT_SAVE(file, length);
+  CHECKPOINT_SAVE_ARRAY(file, record->trace_name, length);
+  metrics_save(&record->metrics, file);
+  return ferror(file) ? -1 : 0;
+}
+
+
+/**
+  Opens a shard summary and reads its header.
+
+  @param file set to the summary file, positioned after the header
+  @param file_name the name of the summary file
+  @param header set to the header
+  @return 0 on success
+  @return -1 if the file cannot be opened
+  @return -2 if the file is not a shard summary
+*/
+int shard_open(FILE **file, const char *file_name, shard_header_t *header) {
+  *file = fopen(file_name, "rb");
+  if (*file == NULL) {
+    return -1;
+  }
+  if (CHECKPOINT_LOAD(*file, *header) != 1 || memcmp(header->magic, SHARD_MAGIC, 4) != 0 || header->shards <= 0 ||
+      header->shard < 0 || header->shard >= header->shards || header->traces < 0 || header->configs < 0) {
+    fclose(*file);
+    *file = NULL;
+    return -2;
+  }
+
+  return 0;
+}
+
+
+/**
+  Reads the next task of a shard summary. The record must be freed with
+  shard_record_destroy() once it is read.
+
+  @param file the summary file
+  @param record set to the result of the task
+  @return 1 if a record was read
+  @return 0 at the end of the file
+  @return -1 if the file is truncated or malformed
+*/
+int shard_read_record(FILE *file, shard_record_t *record) {
+  int32_t length;
+
+  record->trace_name = NULL;
+  if (CHECKPOINT_LOAD(file, record->task) != 1) {
+    return feof(file) ? 0 : -1;
+  }
+  if (CHECKPOINT_LOAD(file, record->cores) != 1 || CHECKPOINT_LOAD(file, record->scheme) != 1 ||
+      CHECKPOINT_LOAD(file, record->quantum) != 1 || CHECKPOINT_LOAD(file, record->status) != 1 ||
+      CHECKPOINT_LOAD(file, length) != 1 || length < 0 || length > 65536) {
+    return -1;
+  }
+
+  record->trace_name = (char *)malloc(length + 1);
+  record->trace_name[length] = '\0';
+  if (CHECKPOINT_LOAD_ARRAY(file, record->trace_name, length) != (size_t)length) {
+    free(record->trace_name);
+    record->trace_name = NULL;
+    return -1;
+  }
+
+  if (metrics_load(&record->metrics, file) != 0) {
+    shard_record_destroy(record);
+    return -1;
+  }
+  return 1;
+}
+
+
+/**
+  Frees all the memory associated with a record read by shard_read_record().
+
+  @param record a pointer to an instance of the shard_record_t data structure
+*/
+void shard_record_destroy(shard_record_t *record) {
+  free(record->trace_name);
+  record->trace_name = NULL;
+  metrics_destroy(&record->metrics);
+}
@@ -0,0 +1,94 @@
+/** @file libshard.h
+ */
+
+#ifndef LIBSHARD_H_
+#define LIBSHARD_H_
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include "../libmetrics/libmetrics.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+  First bytes of a shard summary. See shard_header_t.
+*/
+#define SHARD_MAGIC "SWP1"
+
+/** @struct shard_header_t
+ *  @brief Header of a shard summary
+ *
+ *  A sweep over several traces is a matrix of tasks, one for every trace and
+ *  configuration, numbered trace * configs + config. Shard i of n simulates
+ *  the tasks whose number is i modulo n, and writes a summary: this header
+ *  followed by one record per task (see shard_write_record()), all in the
+ *  byte order of the machine that wrote it.
+ *
+ *  @var shard_header_t::magic
+ *  Member 'magic' contains the four characters of SHARD_MAGIC.
+ *  @var shard_header_t::shard
+ *  Member 'shard' contains the index of the shard, from 0 to shards - 1.
+ *  @var shard_header_t::shards
+ *  Member 'shards' contains the number of shards of the sweep.
+ *  @var shard_header_t::traces
+ *  Member 'traces' contains the number of traces of the sweep.
+ *  @var shard_header_t::configs
+ *  Member 'configs' contains the number of configurations simulated on each trace.
+ *  @var shard_header_t::per_core
+ *  Member 'per_core' is non-zero if every core had its own queue.
+ *  @var shard_header_t::aging
+ *  Member 'aging' contains the aging interval of PRI and PPRI, or 0.
+ */
+typedef struct shard_header_t {
+  char magic[4];
+  int32_t shard;
+  int32_t shards;
+  int32_t traces;
+  int32_t configs;
+  int32_t per_core;
+  int32_t aging;
+} shard_header_t;
+
+/** @struct shard_record_t
+ *  @brief The result of one task of a sharded sweep
+ *  @var shard_record_t::task
+ *  Member 'task' contains the number of the task, trace * configs + config.
+ *  @var shard_record_t::cores
+ *  Member 'cores' contains the number of cores of the configuration.
+ *  @var shard_record_t::scheme
+ *  Member 'scheme' contains the scheme_t of the configuration.
+ *  @var shard_record_t::quantum
+ *  Member 'quantum' contains the quantum of the configuration.
+ *  @var shard_record_t::status
+ *  Member 'status' contains the exit status of the simulation, 0 on success.
+ *  @var shard_record_t::trace_name
+ *  Member 'trace_name' contains the file name of the trace.
+ *  @var shard_record_t::metrics
+ *  Member 'metrics' contains the metrics of the simulation, empty if it failed.
+ */
+typedef struct shard_record_t {
+  int32_t task;
+  int32_t cores;
+  int32_t scheme;
+  int32_t quantum;
+  int32_t status;
+  char *trace_name;
+  metrics_t metrics;
+} shard_record_t;
+
+int shard_parse(const char *arg, int *shard, int *shards);
+int shard_owns(int task, int shard, int shards);
+int shard_write_header(FILE *file, const shard_header_t *header);
+int shard_write_record(FILE *file, const shard_record_t *record);
+int shard_open(FILE **file, const char *file_name, shard_header_t *header);
+int shard_read_record(FILE *file, shard_record_t *record);
+void shard_record_destroy(shard_record_t *record);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* LIBSHARD_H_ */
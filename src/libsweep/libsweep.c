@@ -0,0 +1,194 @@
+/** @file libsweep.c
+ */
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "libsweep.h"
+
+
+/** @struct sweep_deque_t
+ *  @brief Tasks not started yet that belong to one worker
+ *  @var sweep_deque_t::tasks
+ *  Member 'tasks' contains the task numbers that were dealt to the worker.
+ *  @var sweep_deque_t::head
+ *  Member 'head' contains the index of the next task the worker will take itself.
+ *  @var sweep_deque_t::tail
+ *  Member 'tail' contains the index one past the task other workers will steal next.
+ *  @var sweep_deque_t::lock
+ *  Member 'lock' protects sweep_deque_t::head and sweep_deque_t::tail.
+ */
+typedef struct sweep_deque_t {
+  int *tasks;
+  int head;
+  int tail;
+  pthread_mutex_t lock;
+} sweep_deque_t;
+
+/** @struct sweep_worker_t
+ *  @brief One thread of a sweep
+ *  @var sweep_worker_t::id
+ *  Member 'id' contains the index of the worker, and of its deque.
+ *  @var sweep_worker_t::threads
+ *  Member 'threads' contains the number of workers.
+ *  @var sweep_worker_t::deques
+ *  Member 'deques' contains the deques of every worker.
+ *  @var sweep_worker_t::run
+ *  Member 'run' contains the task function.
+ *  @var sweep_worker_t::arg
+ *  Member 'arg' contains the argument of the task function.
+ */
+typedef struct sweep_worker_t {
+  int id;
+  int threads;
+  sweep_deque_t *deques;
+  sweep_task_t run;
+  void *arg;
+} sweep_worker_t;
+
+
+/**
+  Takes the next task from the front of a worker's own deque.
+
+  @param deque the deque
+  @return the task number, or -1 if the deque is empty
+*/
+static int take(sweep_deque_t *deque) {
+  int task = -1;
+
+  pthread_mutex_lock(&deque->lock);
+  if (deque->head < deque->tail) {
+    task = deque->tasks[deque->head++];
+  }
+  pthread_mutex_unlock(&deque->lock);
+
+  return task;
+}
+
+
+/**
+  Steals a task from the back of another worker's deque.
+
+  @param deque the deque
+  @return the task number, or -1 if the deque is empty
+*/
+static int steal(sweep_deque_t *deque) {
+  int task = -1;
+
+  pthread_mutex_lock(&deque->lock);
+  if (deque->head < deque->tail) {
+    task = deque->tasks[--deque->tail];
+  }
+  pthread_mutex_unlock(&deque->lock);
+
+  return task;
+}
+
+
+/**
+  Runs a worker's own tasks, then steals from the other workers until every
+  deque is empty. Used as a pthread start routine.
+
+  @param arg a pointer to a sweep_worker_t
+  @return NULL
+*/
+static void *work(void *arg) {
+  sweep_worker_t *worker = (sweep_worker_t *)arg;
+  int task, i;
+
+  for (;;) {
+    task = take(&worker->deques[worker->id]);
+
+    // No task is ever added, so once every deque is empty the sweep is done
+    for (i = 1; task == -1 && i < worker->threads; i++) {
+      task = steal(&worker->deques[(worker->id + i) % worker->threads]);
+    }
+
+    if (task == -1) {
+      return NULL;
+    }
+
+    worker->run(task, worker->arg);
+  }
+}
+
+
+/**
+  Returns the number of online CPUs, the default number of threads of a sweep.
+
+  @return the number of online CPUs, at least 1
+*/
+int sweep_threads() {
+  long online = sysconf(_SC_NPROCESSORS_ONLN);
+  return (online > 0) ? (int)online : 1;
+}
+
+
+/**
+  Runs tasks 0 to tasks - 1 across a pool of threads and waits for all of them.
+
+  The tasks are dealt round-robin to the workers, which run their own tasks in
+  order and steal from the back of the other workers' deques once they run
+  out, so uneven tasks still keep every thread busy. The calling thread is one
+  of the workers.
+
+  @param tasks the number of tasks
+  @param threads the number of threads to use
+  @param run the task function
+  @param arg the argument of the task function
+*/
+void sweep_run(int tasks, int threads, sweep_task_t run, void *arg) {
+  int i;
+
+  if (threads > tasks) {
+    threads = tasks;
+  }
+  if (threads < 1) {
+    threads = 1;
+  }
+
+  sweep_deque_t *deques = (sweep_deque_t *)malloc(threads * sizeof(sweep_deque_t));
+  sweep_worker_t *workers = (sweep_worker_t *)malloc(threads * sizeof(sweep_worker_t));
+  pthread_t *ids = (pthread_t *)malloc(threads * sizeof(pthread_t));
+  int *started = (int *)calloc(threads, sizeof(int));
+
+  for (i = 0; i < threads; i++) {
+    deques[i].tasks = (int *)malloc((tasks / threads + 1) * sizeof(int));
+    deques[i].head = 0;
+    deques[i].tail = 0;
+    pthread_mutex_init(&deques[i].lock, NULL);
+
+    workers[i].id = i;
+    workers[i].threads = threads;
+    workers[i].deques = deques;
+    workers[i].run = run;
+    workers[i].arg = arg;
+  }
+  for (i = 0; i < tasks; i++) {
+    sweep_deque_t *deque = &deques[i % threads];
+    deque->tasks[deque->tail++] = i;
+  }
+
+  for (i = 1; i < threads; i++) {
+    started[i] = (pthread_create(&ids[i], NULL, work, &workers[i]) == 0);
+  }
+
+  // Tasks of a worker that could not be started are stolen by the others
+  work(&workers[0]);
+
+  for (i = 1; i < threads; i++) {
+    if (started[i]) {
+      pthread_join(ids[i], NULL);
+    }
+  }
+
+  for (i = 0; i < threads; i++) {
+    pthread_mutex_destroy(&deques[i].lock);
+    free(deques[i].tasks);
+  }
+  free(started);
+  free(ids);
+  free(workers);
+  free(deques);
+}
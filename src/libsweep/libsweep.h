@@ -0,0 +1,26 @@
+/** @file libsweep.h
+ */
+
+#ifndef LIBSWEEP_H_
+#define LIBSWEEP_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+  A task of a sweep. Called once for every task number, from any thread.
+
+  @param task the task number, from 0 to the number of tasks - 1
+  @param arg the argument given to sweep_run()
+*/
+typedef void (*sweep_task_t)(int task, void *arg);
+
+int sweep_threads();
+void sweep_run(int tasks, int threads, sweep_task_t run, void *arg);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* LIBSWEEP_H_ */
@@ -0,0 +1,590 @@
+/** @file libtrace.c
+ */
+
+#include <fcntl.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "libtrace.h"
+
+
+/**
+  Parses an integer the same way atoi() does, without requiring the input to
+  be NUL terminated.
+
+  @param p pointer to the first character of the token
+  @param end pointer one past the last character of the token
+  @return the parsed value, or 0 if the token does not start with a number
+*/
+static int parse_int(const char *p, const char *end) {
+  int negative = 0;
+  int value = 0;
+
+  while (p < end && (*p == ' ' || *p == '\t' || *p == '\n' || *p == '\v' || *p == '\f' || *p == '\r')) {
+    ++p;
+  }
+  if (p < end && (*p == '-' || *p == '+')) {
+    negative = (*p == '-');
+    ++p;
+  }
+  while (p < end && *p >= '0' && *p <= '9') {
+    value = value * 10 + (*p - '0');
+    ++p;
+  }
+
+  return negative ? -value : value;
+}
+
+
+/**
+  Parses one line of a trace.
+
+  Fields are split on ',' with empty fields skipped, matching strtok(), and
+  each of the first three fields is converted like atoi().
+
+  @param line pointer to the first character of the line
+  @param end pointer one past the last character of the line (including its newline, if any)
+  @param job the job to fill in
+  @return 0 if the line holds a job
+  @return -1 if the line does not have three fields
+*/
+int trace_parse_line(const char *line, const char *end, trace_job_t *job) {
+  int fields[3];
+  int count = 0;
+  const char *p = line;
+
+  while (count < 3) {
+    // Skip empty fields
+    while (p < end && *p == ',') {
+      ++p;
+    }
+    if (p == end) {
+      break;
+    }
+
+    const char *field = p;
+    while (p < end && *p != ',') {
+      ++p;
+    }
+    fields[count++] = parse_int(field, p);
+  }
+
+  if (count < 3) {
+    return -1;
+  }
+
+  job->arrival_time = fields[0];
+  job->run_time = fields[1];
+  job->priority = fields[2];
+  return 0;
+}
+
+
+/** @struct trace_chunk_t
+ *  @brief A run of whole lines of a mapped trace, parsed by one thread
+ *  @var trace_chunk_t::begin
+ *  Member 'begin' points to the first character of the chunk.
+ *  @var trace_chunk_t::end
+ *  Member 'end' points one past the last character of the chunk.
+ *  @var trace_chunk_t::jobs
+ *  Member 'jobs' is NULL while the chunk's lines are being counted, and then points to where its first job is stored.
+ *  @var trace_chunk_t::count
+ *  Member 'count' contains the number of lines in the chunk.
+ *  @var trace_chunk_t::status
+ *  Member 'status' is set to -1 if a line of the chunk is not in the expected format.
+ */
+typedef struct trace_chunk_t {
+  const char *begin;
+  const char *end;
+  trace_job_t *jobs;
+  int count;
+  int status;
+} trace_chunk_t;
+
+
+/**
+  Counts the lines of a chunk if it has no jobs array yet, or parses them into
+  it otherwise. Used as a pthread start routine.
+
+  @param arg a pointer to a trace_chunk_t
+  @return NULL
+*/
+static void *parse_chunk(void *arg) {
+  trace_chunk_t *chunk = (trace_chunk_t *)arg;
+  const char *line = chunk->begin;
+  int count = 0;
+
+  while (line < chunk->end) {
+    const char *newline = memchr(line, '\n', chunk->end - line);
+    const char *end = (newline != NULL) ? newline + 1 : chunk->end;
+
+    if (chunk->jobs != NULL && trace_parse_line(line, end, &chunk->jobs[count]) != 0) {
+      chunk->status = -1;
+      return NULL;
+    }
+
+    ++count;
+    line = end;
+  }
+
+  chunk->count = count;
+  return NULL;
+}
+
+
+/**
+  Runs parse_chunk() over every chunk, one thread per chunk, with the first
+  chunk handled by the calling thread.
+
+  @param chunks the chunks to process
+  @param count the number of chunks
+*/
+static void parse_chunks(trace_chunk_t *chunks, int count) {
+  pthread_t *threads = (pthread_t *)malloc(count * sizeof(pthread_t));
+  int *started = (int *)calloc(count, sizeof(int));
+  int i;
+
+  for (i = 1; i < count; i++) {
+    started[i] = (pthread_create(&threads[i], NULL, parse_chunk, &chunks[i]) == 0);
+    if (!started[i]) {
+      parse_chunk(&chunks[i]);
+    }
+  }
+
+  parse_chunk(&chunks[0]);
+
+  for (i = 1; i < count; i++) {
+    if (started[i]) {
+      pthread_join(threads[i], NULL);
+    }
+  }
+
+  free(started);
+  free(threads);
+}
+
+
+/**
+  Points a trace at the records of a mapped binary trace, taking ownership of
+  the mapping.
+
+  @param trace a pointer to an instance of the trace_t data structure
+  @param data the mapped file
+  @param size the size of the mapped file in bytes
+  @return 0 on success
+  @return -2 if the header does not match the size of the file
+*/
+static int load_binary(trace_t *trace, const char *data, size_t size) {
+  const trace_header_t *header = (const trace_header_t *)data;
+
+  if (header->count > (uint64_t)INT_MAX || size != sizeof(trace_header_t) + header->count * sizeof(trace_job_t)) {
+    munmap((void *)data, size);
+    return -2;
+  }
+
+  trace->jobs = (trace_job_t *)(data + sizeof(trace_header_t));
+  trace->count = (int)header->count;
+  trace->map = (void *)data;
+  trace->map_size = size;
+  return 0;
+}
+
+
+/**
+  Loads a whole trace by mapping the file into memory and parsing it in place.
+
+  The body of the trace is split at line boundaries into up to threads chunks
+  of at least TRACE_MIN_CHUNK_SIZE bytes. The chunks' lines are counted, then
+  every chunk is parsed straight into its share of trace->jobs.
+
+  A binary trace (see trace_header_t) is not parsed at all: trace->jobs points
+  straight into the mapping.
+
+  @param trace a pointer to an instance of the trace_t data structure
+  @param file_name path of the trace to load
+  @param threads the most threads to parse with, or 0 to use one per online CPU
+  @return 0 on success
+  @return -1 if the file could not be opened
+  @return -2 if the trace is not in the expected format
+*/
+int trace_load(trace_t *trace, const char *file_name, int threads) {
+  struct stat info;
+  int i, result = 0;
+
+  trace->jobs = NULL;
+  trace->count = 0;
+  trace->map = NULL;
+  trace->map_size = 0;
+
+  int fd = open(file_name, O_RDONLY);
+  if (fd == -1) {
+    return -1;
+  }
+  if (fstat(fd, &info) != 0) {
+    close(fd);
+    return -1;
+  }
+  if (info.st_size == 0) {
+    close(fd);
+    return 0;
+  }
+
+  const char *data = (const char *)mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (data == MAP_FAILED) {
+    return -1;
+  }
+  madvise((void *)data, info.st_size, MADV_SEQUENTIAL);
+
+  if ((size_t)info.st_size >= sizeof(trace_header_t) && memcmp(data, TRACE_MAGIC, 4) == 0) {
+    return load_binary(trace, data, info.st_size);
+  }
+
+  // Ignore the first (header) line
+  const char *end = data + info.st_size;
+  const char *body = memchr(data, '\n', info.st_size);
+  body = (body != NULL) ? body + 1 : end;
+
+  if (threads <= 0) {
+    long online = sysconf(_SC_NPROCESSORS_ONLN);
+    threads = (online > 0) ? (int)online : 1;
+  }
+  if ((end - body) / TRACE_MIN_CHUNK_SIZE < threads) {
+    threads = (int)((end - body) / TRACE_MIN_CHUNK_SIZE);
+  }
+  if (threads < 1) {
+    threads = 1;
+  }
+
+  // Split the body into chunks that each end just after a newline
+  trace_chunk_t *chunks = (trace_chunk_t *)malloc(threads * sizeof(trace_chunk_t));
+  const char *begin = body;
+  for (i = 0; i < threads; i++) {
+    const char *split = (i == threads - 1) ? end : body + (end - body) / threads * (i + 1);
+    if (split < begin) {
+      split = begin;
+    }
+    if (split < end) {
+      const char *newline = memchr(split, '\n', end - split);
+      split = (newline != NULL) ? newline + 1 : end;
+    }
+
+    chunks[i].begin = begin;
+    chunks[i].end = split;
+    chunks[i].jobs = NULL;
+    chunks[i].count = 0;
+    chunks[i].status = 0;
+    begin = split;
+  }
+
+  parse_chunks(chunks, threads);
+
+  int count = 0;
+  for (i = 0; i < threads; i++) {
+    count += chunks[i].count;
+  }
+
+  trace->jobs = (trace_job_t *)malloc((count + 1) * sizeof(trace_job_t));
+  trace_job_t *jobs = trace->jobs;
+  for (i = 0; i < threads; i++) {
+    chunks[i].jobs = jobs;
+    jobs += chunks[i].count;
+  }
+
+  parse_chunks(chunks, threads);
+
+  for (i = 0; i < threads; i++) {
+    if (chunks[i].status != 0) {
+      result = -2;
+    }
+  }
+
+  if (result == 0) {
+    trace->count = count;
+  }
+  else {
+    trace_free(trace);
+  }
+
+  free(chunks);
+  munmap((void *)data, info.st_size);
+  return result;
+}
+
+
+/**
+  Frees the memory associated with a trace loaded by trace_load().
+
+  @param trace a pointer to a loaded trace_t
+*/
+void trace_free(trace_t *trace) {
+  if (trace->map != NULL) {
+    munmap(trace->map, trace->map_size);
+  }
+  else {
+    free(trace->jobs);
+  }
+  trace->jobs = NULL;
+  trace->count = 0;
+  trace->map = NULL;
+  trace->map_size = 0;
+}
+
+
+/**
+  Writes a trace in the binary format described by trace_header_t.
+
+  @param trace a pointer to a loaded trace_t
+  @param file_name path of the file to write
+  @return 0 on success
+  @return -1 if the file could not be written
+*/
+int trace_write_binary(const trace_t *trace, const char *file_name) {
+  int result = 0;
+
+  FILE *file = fopen(file_name, "wb");
+  if (file == NULL) {
+    return -1;
+  }
+
+  if (trace_write_header(file, (uint64_t)trace->count) != 0 ||
+      fwrite(trace->jobs, sizeof(trace_job_t), trace->count, file) != (size_t)trace->count) {
+    result = -1;
+  }
+
+  if (fclose(file) != 0) {
+    result = -1;
+  }
+
+  return result;
+}
+
+
+/**
+  Writes the header of a binary trace, for traces written a part at a time.
+  It must be followed by exactly count trace_job_t records.
+
+  @param file the file to write to, at its start
+  @param count the number of jobs that will follow
+  @return 0 on success
+  @return -1 if the header could not be written
+*/
+int trace_write_header(FILE *file, uint64_t count) {
+  trace_header_t header;
+
+  memcpy(header.magic, TRACE_MAGIC, 4);
+  header.reserved = 0;
+  header.count = count;
+
+  return (fwrite(&header, sizeof(header), 1, file) == 1) ? 0 : -1;
+}
+
+
+/**
+  Writes a positive or negative integer in decimal.
+
+  @param p where to write the digits
+  @param value the integer
+  @return one past the last digit
+*/
+static char *format_int(char *p, int value) {
+  char digits[12];
+  unsigned int magnitude = (value < 0) ? -(unsigned int)value : (unsigned int)value;
+  int count = 0;
+
+  if (value < 0) {
+    *p++ = '-';
+  }
+  do {
+    digits[count++] = '0' + magnitude % 10;
+    magnitude /= 10;
+  } while (magnitude != 0);
+  while (count > 0) {
+    *p++ = digits[--count];
+  }
+
+  return p;
+}
+
+
+/**
+  Formats jobs as the lines of a CSV trace, without the TRACE_CSV_HEADER
+  line. This is much faster than fprintf() for long traces, and since it only
+  writes to memory, the parts of a trace can be formatted in parallel.
+
+  @param jobs the jobs
+  @param count the number of jobs
+  @param buffer where to write the lines, with room for count * TRACE_MAX_LINE characters
+  @return the number of characters written (no NUL is added)
+*/
+size_t trace_format_csv(const trace_job_t *jobs, int count, char *buffer) {
+  char *p = buffer;
+
+  for (int i = 0; i < count; ++i) {
+    p = format_int(p, jobs[i].arrival_time);
+    *p++ = ',';
+    p = format_int(p, jobs[i].run_time);
+    *p++ = ',';
+    p = format_int(p, jobs[i].priority);
+    *p++ = '\n';
+  }
+
+  return p - buffer;
+}
+
+
+/**
+  Moves the unread bytes of the reader's buffer to its front and fills the rest
+  of it from the file.
+
+  @param reader a pointer to an open trace_reader_t
+*/
+static void fill(trace_reader_t *reader) {
+  memmove(reader->buffer, reader->buffer + reader->start, reader->end - reader->start);
+  reader->end -= reader->start;
+  reader->start = 0;
+  size_t bytes = fread(reader->buffer + reader->end, 1, TRACE_BUFFER_SIZE - reader->end, reader->file);
+  reader->end += bytes;
+  if (bytes == 0) {
+    reader->eof = 1;
+  }
+}
+
+
+/**
+  Finds the next line in the reader's buffer, refilling it from the file as
+  needed.
+
+  @param reader a pointer to an open trace_reader_t
+  @param line set to the first character of the line
+  @param end set to one past the last character of the line (including its newline, if any)
+  @return 1 if a line was found
+  @return 0 at the end of the file
+  @return -1 if a line does not fit in the buffer
+*/
+static int next_line(trace_reader_t *reader, const char **line, const char **end) {
+  for (;;) {
+    char *newline = memchr(reader->buffer + reader->start, '\n', reader->end - reader->start);
+    if (newline != NULL) {
+      *line = reader->buffer + reader->start;
+      *end = newline + 1;
+      reader->start = newline + 1 - reader->buffer;
+      return 1;
+    }
+
+    if (reader->eof) {
+      if (reader->start == reader->end) {
+        return 0;
+      }
+      // Last line without a trailing newline
+      *line = reader->buffer + reader->start;
+      *end = reader->buffer + reader->end;
+      reader->start = reader->end;
+      return 1;
+    }
+
+    if (reader->start == 0 && reader->end == TRACE_BUFFER_SIZE) {
+      return -1;
+    }
+
+    // Move the partial line to the front and fill the rest of the buffer
+    fill(reader);
+  }
+}
+
+
+/**
+  Opens a trace and skips its header line, or the header of a binary trace.
+
+  @param reader a pointer to an instance of the trace_reader_t data structure
+  @param file_name path of the trace to open
+  @return 0 on success
+  @return -1 if the file could not be opened
+*/
+int trace_open(trace_reader_t *reader, const char *file_name) {
+  const char *line;
+  const char *end;
+
+  reader->file = fopen(file_name, "r");
+  if (reader->file == NULL) {
+    return -1;
+  }
+
+  reader->buffer = (char *)malloc(TRACE_BUFFER_SIZE);
+  reader->start = 0;
+  reader->end = 0;
+  reader->eof = 0;
+  reader->binary = 0;
+  reader->remaining = 0;
+
+  fill(reader);
+  if (reader->end >= sizeof(trace_header_t) && memcmp(reader->buffer, TRACE_MAGIC, 4) == 0) {
+    trace_header_t header;
+    memcpy(&header, reader->buffer, sizeof(header));
+    reader->binary = 1;
+    reader->remaining = header.count;
+    reader->start = sizeof(header);
+    return 0;
+  }
+
+  // Ignore the first (header) line
+  next_line(reader, &line, &end);
+  return 0;
+}
+
+
+/**
+  Reads the next job of a trace.
+
+  @param reader a pointer to an open trace_reader_t
+  @param job the job to fill in
+  @return 1 if a job was read
+  @return 0 at the end of the trace
+  @return -1 if the trace is not in the expected format
+*/
+int trace_read(trace_reader_t *reader, trace_job_t *job) {
+  const char *line;
+  const char *end;
+
+  if (reader->binary) {
+    if (reader->remaining == 0) {
+      return 0;
+    }
+    if (reader->end - reader->start < sizeof(trace_job_t)) {
+      fill(reader);
+      if (reader->end - reader->start < sizeof(trace_job_t)) {
+        return -1;
+      }
+    }
+    memcpy(job, reader->buffer + reader->start, sizeof(trace_job_t));
+    reader->start += sizeof(trace_job_t);
+    --reader->remaining;
+    return 1;
+  }
+
+  int found = next_line(reader, &line, &end);
+  if (found <= 0) {
+    return found;
+  }
+
+  return (trace_parse_line(line, end, job) == 0) ? 1 : -1;
+}
+
+
+/**
+  Closes a trace and frees the memory associated with reader.
+
+  @param reader a pointer to an open trace_reader_t
+*/
+void trace_close(trace_reader_t *reader) {
+  fclose(reader->file);
+  free(reader->buffer);
+  reader->file = NULL;
+  reader->buffer = NULL;
+}
@@ -0,0 +1,136 @@
+/** @file libtrace.h
+ */
+
+#ifndef LIBTRACE_H_
+#define LIBTRACE_H_
+
+#include <stdint.h>
+#include <stdio.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+  Size of the read buffer used by trace_reader_t. A single line of a trace
+  may not be longer than this.
+*/
+#define TRACE_BUFFER_SIZE 65536
+
+/** @struct trace_job_t
+ *  @brief One job of a trace
+ *  @var trace_job_t::arrival_time
+ *  Member 'arrival_time' contains the time the job arrives.
+ *  @var trace_job_t::run_time
+ *  Member 'run_time' contains the number of time units the job runs for.
+ *  @var trace_job_t::priority
+ *  Member 'priority' contains the priority of the job. (The lower the value, the higher the priority.)
+ */
+typedef struct trace_job_t {
+  int arrival_time;
+  int run_time;
+  int priority;
+} trace_job_t;
+
+/**
+  First line of a CSV trace.
+*/
+#define TRACE_CSV_HEADER "\"Arrival time\",\"Run time\",\"Priority\"\n"
+
+/**
+  Longest line trace_format_csv() writes for one job.
+*/
+#define TRACE_MAX_LINE 36
+
+/**
+  First bytes of a binary trace. See trace_header_t.
+*/
+#define TRACE_MAGIC "TRC1"
+
+/** @struct trace_header_t
+ *  @brief Header of a binary trace
+ *
+ *  A binary trace is this header followed by trace_header_t::count
+ *  trace_job_t records, all in the byte order of the machine that wrote it.
+ *
+ *  @var trace_header_t::magic
+ *  Member 'magic' contains the four characters of TRACE_MAGIC.
+ *  @var trace_header_t::reserved
+ *  Member 'reserved' is written as 0.
+ *  @var trace_header_t::count
+ *  Member 'count' contains the number of jobs in the trace.
+ */
+typedef struct trace_header_t {
+  char magic[4];
+  uint32_t reserved;
+  uint64_t count;
+} trace_header_t;
+
+/**
+  Smallest share of a trace, in bytes, that trace_load() hands to a thread of
+  its own. Smaller traces are parsed on the calling thread.
+*/
+#define TRACE_MIN_CHUNK_SIZE (1 << 20)
+
+/** @struct trace_t
+ *  @brief A whole trace loaded into memory
+ *  @var trace_t::jobs
+ *  Member 'jobs' contains the jobs of the trace, in file order.
+ *  @var trace_t::count
+ *  Member 'count' contains the number of jobs in trace_t::jobs.
+ *  @var trace_t::map
+ *  Member 'map' contains the mapping trace_t::jobs points into for a binary trace, or NULL if trace_t::jobs was allocated.
+ *  @var trace_t::map_size
+ *  Member 'map_size' contains the size of trace_t::map in bytes.
+ */
+typedef struct trace_t {
+  trace_job_t *jobs;
+  int count;
+  void *map;
+  size_t map_size;
+} trace_t;
+
+/** @struct trace_reader_t
+ *  @brief Streaming reader for "Arrival time","Run time","Priority" CSV traces
+ *  @var trace_reader_t::file
+ *  Member 'file' contains the file being read.
+ *  @var trace_reader_t::buffer
+ *  Member 'buffer' contains the fixed-size read buffer.
+ *  @var trace_reader_t::start
+ *  Member 'start' contains the offset of the first unread byte in trace_reader_t::buffer.
+ *  @var trace_reader_t::end
+ *  Member 'end' contains the offset one past the last valid byte in trace_reader_t::buffer.
+ *  @var trace_reader_t::eof
+ *  Member 'eof' is non-zero once the end of trace_reader_t::file has been reached.
+ *  @var trace_reader_t::binary
+ *  Member 'binary' is non-zero if the file is a binary trace.
+ *  @var trace_reader_t::remaining
+ *  Member 'remaining' contains the number of jobs of a binary trace not read yet.
+ */
+typedef struct trace_reader_t {
+  FILE *file;
+  char *buffer;
+  size_t start;
+  size_t end;
+  int eof;
+  int binary;
+  uint64_t remaining;
+} trace_reader_t;
+
+int trace_parse_line(const char *line, const char *end, trace_job_t *job);
+
+int trace_load(trace_t *trace, const char *file_name, int threads);
+void trace_free(trace_t *trace);
+int trace_write_binary(const trace_t *trace, const char *file_name);
+int trace_write_header(FILE *file, uint64_t count);
+size_t trace_format_csv(const trace_job_t *jobs, int count, char *buffer);
+
+int trace_open(trace_reader_t *reader, const char *file_name);
+int trace_read(trace_reader_t *reader, trace_job_t *job);
+void trace_close(trace_reader_t *reader);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* LIBTRACE_H_ */
@@ -0,0 +1,164 @@
+/** @file libworkload.c
+ */
+
+#include <limits.h>
+#include <math.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "libworkload.h"
+
+
+/**
+  Returns the next number of a splitmix64 generator.
+
+  @param state the state of the generator
+  @return a uniformly distributed 64-bit number
+*/
+static inline uint64_t next_random(uint64_t *state) {
+  uint64_t z = (*state += 0x9E3779B97F4A7C15ULL);
+  z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+  z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+  return z ^ (z >> 31);
+}
+
+
+/**
+  Returns a uniformly distributed number in (0, 1], so that its logarithm is
+  always defined.
+
+  @param state the state of the generator
+  @return the number
+*/
+static inline double next_uniform(uint64_t *state) {
+  return ((next_random(state) >> 11) + 1) * (1.0 / 9007199254740992.0);
+}
+
+
+/**
+  Initializes a workload_t with Poisson arrivals of one job per time unit, run
+  times uniform from 1 to 10 and 8 equally likely priorities.
+
+  @param workload a pointer to an instance of the workload_t data structure
+*/
+void workload_init(workload_t *workload) {
+  memset(workload, 0, sizeof(workload_t));
+  workload->seed = 1;
+  workload->arrivals = WORKLOAD_POISSON;
+  workload->rate = 1.0;
+  workload->burst = 1.0;
+  workload->run_times = WORKLOAD_UNIFORM;
+  workload->run_a = 1;
+  workload->run_b = 10;
+  workload->run_max = INT_MAX / 2;
+  workload->priority_levels = 8;
+  for (int i = 0; i < workload->priority_levels; ++i) {
+    workload->priority_weights[i] = 1.0;
+  }
+}
+
+
+/**
+  Draws one run time.
+
+  @param workload a pointer to an instance of the workload_t data structure
+  @param state the state of the generator
+  @return the run time, between 1 and workload_t::run_max
+*/
+static int draw_run_time(const workload_t *workload, uint64_t *state) {
+  double run_time;
+
+  if (workload->run_times == WORKLOAD_UNIFORM) {
+    run_time = floor(workload->run_a + (1.0 - next_uniform(state)) * (workload->run_b - workload->run_a + 1));
+  }
+  else if (workload->run_times == WORKLOAD_EXPONENTIAL) {
+    run_time = floor(-log(next_uniform(state)) * workload->run_a + 0.5);
+  }
+  else {
+    run_time = ceil(workload->run_a * exp(-log(next_uniform(state)) / workload->run_b));
+  }
+
+  if (!(run_time < workload->run_max)) {
+    return workload->run_max;
+  }
+  return (run_time < 1) ? 1 : (int)run_time;
+}
+
+
+/**
+  Generates one chunk of the jobs of a workload.
+
+  Every chunk has its own random numbers, worked out from the seed and the
+  chunk number, so the chunks of a trace can be generated in any order and on
+  any number of threads and still give the same trace. Arrival times are
+  returned relative to the start of the chunk; workload_place_chunk() then
+  places the chunk after the ones before it.
+
+  @param workload a pointer to an instance of the workload_t data structure
+  @param chunk the number of the chunk, from 0
+  @param count the number of jobs of the chunk (WORKLOAD_CHUNK_JOBS but for the last chunk)
+  @param jobs the jobs to fill in, but for their arrival times
+  @param arrivals the arrival times to fill in, from the start of the chunk
+  @return the length of the chunk: the arrival time of its last job
+*/
+double workload_generate_chunk(const workload_t *workload, uint64_t chunk, int count, trace_job_t *jobs, double *arrivals) {
+  uint64_t state = workload->seed ^ ((chunk + 1) * 0xD1B54A32D192ED03ULL);
+  double cumulative[WORKLOAD_MAX_PRIORITIES];
+  double time = 0.0, total = 0.0;
+  long left = 0;
+  int i, level;
+
+  for (level = 0; level < workload->priority_levels; ++level) {
+    total += workload->priority_weights[level];
+    cumulative[level] = total;
+  }
+
+  for (i = 0; i < count; ++i) {
+    if (workload->arrivals == WORKLOAD_POISSON) {
+      time += -log(next_uniform(&state)) / workload->rate;
+    }
+    else {
+      if (left == 0) {
+        // Bursts arrive burst times less often, so the rate stays the same
+        time += -log(next_uniform(&state)) * workload->burst / workload->rate;
+        left = (workload->burst > 1) ? 1 + (long)floor(log(next_uniform(&state)) / log(1.0 - 1.0 / workload->burst)) : 1;
+      }
+      --left;
+    }
+    arrivals[i] = time;
+
+    jobs[i].run_time = draw_run_time(workload, &state);
+
+    double pick = (1.0 - next_uniform(&state)) * total;
+    level = 0;
+    while (level < workload->priority_levels - 1 && pick >= cumulative[level]) {
+      ++level;
+    }
+    jobs[i].priority = level;
+  }
+
+  return time;
+}
+
+
+/**
+  Sets the arrival times of a chunk of jobs generated by
+  workload_generate_chunk(), rounded down to whole time units.
+
+  @param jobs the jobs of the chunk
+  @param arrivals the arrival times of the chunk, from its start
+  @param count the number of jobs of the chunk
+  @param start the time the chunk starts at: the sum of the lengths of the chunks before it
+  @return 0 on success
+  @return -1 if an arrival time does not fit in an int
+*/
+int workload_place_chunk(trace_job_t *jobs, const double *arrivals, int count, double start) {
+  for (int i = 0; i < count; ++i) {
+    double arrival = start + arrivals[i];
+    if (!(arrival < INT_MAX)) {
+      return -1;
+    }
+    jobs[i].arrival_time = (int)arrival;
+  }
+  return 0;
+}
@@ -0,0 +1,88 @@
+/** @file libworkload.h
+ */
+
+#ifndef LIBWORKLOAD_H_
+#define LIBWORKLOAD_H_
+
+#include <stdint.h>
+
+#include "../libtrace/libtrace.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * \def WORKLOAD_CHUNK_JOBS
+ * \brief Number of jobs of every chunk but the last. Chunks are generated independently, so they can be generated in parallel
+ */
+#define WORKLOAD_CHUNK_JOBS 65536
+
+/**
+ * \def WORKLOAD_MAX_PRIORITIES
+ * \brief Largest number of priority levels of a workload_t
+ */
+#define WORKLOAD_MAX_PRIORITIES 64
+
+/**
+  How the jobs of a workload_t arrive
+*/
+typedef enum {
+  WORKLOAD_POISSON = 0,  // one at a time, with exponentially distributed gaps
+  WORKLOAD_BURSTY        // in bursts of geometrically distributed sizes, with exponentially distributed gaps between bursts
+} workload_arrivals_t;
+
+/**
+  How the run times of the jobs of a workload_t are distributed
+*/
+typedef enum {
+  WORKLOAD_UNIFORM = 0,  // uniform from run_a to run_b
+  WORKLOAD_EXPONENTIAL,  // exponential with a mean of run_a
+  WORKLOAD_PARETO        // Pareto (heavy tailed) with a minimum of run_a and a shape of run_b
+} workload_run_times_t;
+
+/** @struct workload_t
+ *  @brief Distributions of a synthetic trace
+ *  @var workload_t::seed
+ *  Member 'seed' contains the seed of the random numbers. The same workload_t always gives the same jobs.
+ *  @var workload_t::arrivals
+ *  Member 'arrivals' contains how the jobs arrive.
+ *  @var workload_t::rate
+ *  Member 'rate' contains the mean number of jobs that arrive per time unit.
+ *  @var workload_t::burst
+ *  Member 'burst' contains the mean number of jobs of a burst (WORKLOAD_BURSTY only).
+ *  @var workload_t::run_times
+ *  Member 'run_times' contains how the run times are distributed.
+ *  @var workload_t::run_a
+ *  Member 'run_a' contains the first parameter of the run time distribution.
+ *  @var workload_t::run_b
+ *  Member 'run_b' contains the second parameter of the run time distribution.
+ *  @var workload_t::run_max
+ *  Member 'run_max' contains the longest run time, that longer run times are cut down to.
+ *  @var workload_t::priority_levels
+ *  Member 'priority_levels' contains the number of priorities, from 0 to priority_levels - 1.
+ *  @var workload_t::priority_weights
+ *  Member 'priority_weights' contains the relative weight of each priority.
+ */
+typedef struct workload_t {
+  uint64_t seed;
+  workload_arrivals_t arrivals;
+  double rate;
+  double burst;
+  workload_run_times_t run_times;
+  double run_a;
+  double run_b;
+  int run_max;
+  int priority_levels;
+  double priority_weights[WORKLOAD_MAX_PRIORITIES];
+} workload_t;
+
+void workload_init(workload_t *workload);
+double workload_generate_chunk(const workload_t *workload, uint64_t chunk, int count, trace_job_t *jobs, double *arrivals);
+int workload_place_chunk(trace_job_t *jobs, const double *arrivals, int count, double start);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* LIBWORKLOAD_H_ */
@@ -0,0 +1,252 @@
+/** @file mergesweep.c
+ *  @brief Merges the summaries of the shards of a sweep into one report
+ */
+
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "libmetrics/libmetrics.h"
+#include "libscheduler/libscheduler.h"
+#include "libshard/libshard.h"
+
+/*
+ * The results of one configuration, merged over every trace.
+ */
+typedef struct _merged_config_t {
+  int cores, scheme, quantum;
+  int seen;    // whether a record of the configuration has been read
+  int status;  // exit status of the first simulation that failed, or 0
+  histogram_t waiting, response, turnaround;
+} merged_config_t;
+
+void print_usage(char *program_name) {
+  fprintf(stderr, "Usage: %s [-m] <summary file>...\n", program_name);
+  fprintf(stderr, "       %s shard0.sum shard1.sum shard2.sum\n", program_name);
+  fprintf(stderr, "\n");
+  fprintf(stderr, "Merges the summaries written by simulator --summary --shard <i>/<n>, one for\n");
+  fprintf(stderr, "every shard, into one table of each configuration over every trace.\n");
+  fprintf(stderr, "\n");
+  fprintf(stderr, "  -m  also print the p99 waiting and response times\n");
+}
+
+/*
+ * Writes the name of a scheme as it is given to -s (Eg: "psjf", "rr4", "mlfq2").
+ */
+void scheme_name(int scheme, int quantum, char *name) {
+  const char *names[] = {"fcfs", "sjf", "psjf", "pri", "ppri", "rr", "mlfq"};
+
+  if (scheme < FCFS || scheme > MLFQ)
+    strcpy(name, "?");
+  else if (scheme == RR || scheme == MLFQ)
+    sprintf(name, "%s%d", names[scheme], quantum);
+  else
+    strcpy(name, names[scheme]);
+}
+
+/*
+ * Reads the records of one summary into configs, checking that they belong
+ * to the sweep described by header and that no task is read twice.  Returns
+ * 0 on success or prints the problem and returns the exit status.
+ */
+int merge_summary(FILE *file,
+                  const char *file_name,
+                  const shard_header_t *header,
+                  merged_config_t *configs,
+                  char **trace_names,
+                  unsigned char *done) {
+  shard_record_t record;
+  int read;
+
+  while ((read = shard_read_record(file, &record)) == 1) {
+    int task = record.task;
+    if (task < 0 || task >= header->traces * header->configs || !shard_owns(task, header->shard, header->shards)) {
+      shard_record_destroy(&record);
+      read = -1;
+      break;
+    }
+
+    int trace = task / header->configs;
+    merged_config_t *config = &configs[task % header->configs];
+    if (done[task]) {
+      fprintf(stderr, "Summary \"%s\" repeats simulation %d, of \"%s\".\n", file_name, task, record.trace_name);
+      shard_record_destroy(&record);
+      return 2;
+    }
+    if ((config->seen && (config->cores != record.cores || config->scheme != record.scheme ||
+                          config->quantum != record.quantum)) ||
+        (trace_names[trace] != NULL && strcmp(trace_names[trace], record.trace_name) != 0)) {
+      fprintf(stderr, "Summary \"%s\" is not from the same sweep as the others.\n", file_name);
+      shard_record_destroy(&record);
+      return 2;
+    }
+
+    done[task] = 1;
+    config->cores = record.cores;
+    config->scheme = record.scheme;
+    config->quantum = record.quantum;
+    config->seen = 1;
+    if (trace_names[trace] == NULL) {
+      trace_names[trace] = record.trace_name;
+      record.trace_name = NULL;
+    }
+
+    if (record.status != 0) {
+      if (config->status == 0)
+        config->status = record.status;
+    }
+    else {
+      histogram_merge(&config->waiting, &record.metrics.waiting);
+      histogram_merge(&config->response, &record.metrics.response);
+      histogram_merge(&config->turnaround, &record.metrics.turnaround);
+    }
+    shard_record_destroy(&record);
+  }
+
+  if (read != 0) {
+    fprintf(stderr, "Illegal file format.\n");
+    return 2;
+  }
+  return 0;
+}
+
+int main(int argc, char **argv) {
+  int c, i, metrics = 0, status = 0;
+
+  while ((c = getopt(argc, argv, "m")) != -1) {
+    switch (c) {
+      case 'm':
+        metrics = 1;
+        break;
+
+      default:
+        print_usage(argv[0]);
+        return 1;
+    }
+  }
+
+  if (optind == argc) {
+    fprintf(stderr, "At least one summary file is required.\n");
+    print_usage(argv[0]);
+    return 1;
+  }
+
+  shard_header_t sweep;
+  memset(&sweep, 0, sizeof(sweep));
+  merged_config_t *configs = NULL;
+  char **trace_names = NULL;
+  unsigned char *done = NULL, *shard_done = NULL;
+
+  for (i = optind; i < argc && status == 0; i++) {
+    FILE *file;
+    shard_header_t header;
+    int opened = shard_open(&file, argv[i], &header);
+
+    if (opened == -1) {
+      fprintf(stderr, "Unable to open file \"%s\".\n", argv[i]);
+      status = 2;
+      break;
+    }
+    if (opened == -2) {
+      fprintf(stderr, "Illegal file format.\n");
+      status = 2;
+      break;
+    }
+
+    // The first summary describes the sweep
+    if (i == optind) {
+      sweep = header;
+      configs = calloc(sweep.configs + 1, sizeof(merged_config_t));
+      for (int j = 0; j < sweep.configs; j++) {
+        histogram_init(&configs[j].waiting);
+        histogram_init(&configs[j].response);
+        histogram_init(&configs[j].turnaround);
+      }
+      trace_names = calloc(sweep.traces + 1, sizeof(char *));
+      done = calloc((size_t)sweep.traces * sweep.configs + 1, 1);
+      shard_done = calloc(sweep.shards, 1);
+    }
+
+    if (header.shards != sweep.shards || header.traces != sweep.traces || header.configs != sweep.configs ||
+        header.per_core != sweep.per_core || header.aging != sweep.aging) {
+      fprintf(stderr, "Summary \"%s\" is not from the same sweep as the others.\n", argv[i]);
+      status = 2;
+    }
+    else if (shard_done[header.shard]) {
+      fprintf(stderr, "Summary \"%s\" is shard %d of %d again.\n", argv[i], header.shard, header.shards);
+      status = 2;
+    }
+    else {
+      shard_done[header.shard] = 1;
+      status = merge_summary(file, argv[i], &header, configs, trace_names, done);
+    }
+    fclose(file);
+  }
+
+  // Every simulation of the sweep has to be in one of the summaries
+  if (status == 0) {
+    for (i = 0; i < sweep.shards; i++) {
+      if (!shard_done[i]) {
+        fprintf(stderr, "Shard %d of %d is missing.\n", i, sweep.shards);
+        status = 2;
+      }
+    }
+    int missing = 0;
+    for (i = 0; i < sweep.traces * sweep.configs; i++)
+      missing += !done[i];
+    if (status == 0 && missing > 0) {
+      fprintf(stderr, "%d of %d simulation(s) are missing from the summaries.\n", missing, sweep.traces * sweep.configs);
+      status = 2;
+    }
+  }
+
+  if (status == 0) {
+    printf("Merged %d shard(s) of %d configuration(s) over %d trace(s)", sweep.shards, sweep.configs, sweep.traces);
+    if (sweep.aging > 0)
+      printf(" with aging every %d time units", sweep.aging);
+    if (sweep.per_core)
+      printf(" with per-core queues");
+    printf("...\n\n");
+
+    printf("%5s  %-8s  %10s  %10s  %10s  %10s", "Cores", "Scheme", "Jobs", "Waiting", "Turnaround", "Response");
+    if (metrics)
+      printf("  %11s  %12s", "p99 Waiting", "p99 Response");
+    printf("\n");
+    for (i = 0; i < sweep.configs; i++) {
+      merged_config_t *config = &configs[i];
+      char name[16];
+      scheme_name(config->scheme, config->quantum, name);
+
+      if (config->status != 0) {
+        printf("%5d  %-8s  %10s  %10s  %10s  %10s", config->cores, name, "failed", "failed", "failed", "failed");
+        if (metrics)
+          printf("  %11s  %12s", "failed", "failed");
+        status = config->status;
+      }
+      else {
+        printf("%5d  %-8s  %10llu  %10.2f  %10.2f  %10.2f",
+               config->cores,
+               name,
+               (unsigned long long)config->waiting.count,
+               histogram_mean(&config->waiting),
+               histogram_mean(&config->turnaround),
+               histogram_mean(&config->response));
+        if (metrics)
+          printf("  %11lld  %12lld",
+                 (long long)histogram_percentile(&config->waiting, 99),
+                 (long long)histogram_percentile(&config->response, 99));
+      }
+      printf("\n");
+    }
+  }
+
+  if (trace_names != NULL)
+    for (i = 0; i < sweep.traces; i++)
+      free(trace_names[i]);
+  free(trace_names);
+  free(configs);
+  free(done);
+  free(shard_done);
+  return status;
+}
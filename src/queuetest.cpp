@@ -7,6 +7,10 @@
 #include <stdlib.h>
 
 #include "libpriqueue/libpriqueue.h"
+#include "libpriqueue/libpriqueue.hpp"
+#include "libscheduler/libscheduler.hpp"
+
+#include <type_traits>
 
 #define CATCH_CONFIG_DEFAULT_REPORTER "compact"
 #define CATCH_CONFIG_MAIN
@@ -163,3 +167,580 @@ TEST_CASE("priqueue_remove works with 100 values", "[priqueue_size][priqueue_off
 
   delete[] values;
 }
+
+int compare_fifo(const void *a, const void *b) {
+  (void)a;
+  (void)b;
+  return -1;
+}
+
+TEST_CASE("Correct return values when heap queue is empty",
+          "[priqueue_init_backend][priqueue_size][priqueue_poll][priqueue_peek][priqueue_at][priqueue_remove]") {
+  priqueue_t q;
+  priqueue_init_backend(&q, compare1, PRIQUEUE_HEAP);
+  REQUIRE(priqueue_size(&q) == 0);
+  REQUIRE(priqueue_poll(&q) == NULL);
+  REQUIRE(priqueue_peek(&q) == NULL);
+  REQUIRE(priqueue_at(&q, 0) == NULL);
+  REQUIRE(priqueue_remove(&q, NULL) == 0);
+  REQUIRE(priqueue_remove_at(&q, 0) == NULL);
+  priqueue_destroy(&q);
+}
+
+TEST_CASE("Heap queue polls 1000 random values in sorted order", "[priqueue_init_backend][priqueue_offer][priqueue_poll]") {
+  int *values = new int[1000];
+
+  priqueue_t q;
+  srand(678);
+  for (unsigned int i = 0; i < 1000; i++) {
+    values[i] = rand() % 100;
+  }
+  priqueue_init_backend(&q, compare1, PRIQUEUE_HEAP);
+  for (unsigned int j = 0; j < 1000; ++j) {
+    priqueue_offer(&q, &values[j]);
+  }
+  REQUIRE(priqueue_size(&q) == 1000);
+  int last = -1;
+  for (unsigned int j = 0; j < 1000; ++j) {
+    int *value = (int *)priqueue_poll(&q);
+    REQUIRE(value != NULL);
+    REQUIRE(*value >= last);
+    last = *value;
+  }
+  REQUIRE(priqueue_size(&q) == 0);
+  priqueue_destroy(&q);
+
+  delete[] values;
+}
+
+TEST_CASE("Heap queue breaks ties the same way as the list queue",
+          "[priqueue_init_backend][priqueue_offer][priqueue_poll]") {
+  int *values = new int[500];
+
+  priqueue_t list;
+  priqueue_t heap;
+  srand(42);
+  for (unsigned int i = 0; i < 500; i++) {
+    values[i] = rand() % 10;
+  }
+  priqueue_init_backend(&list, compare1, PRIQUEUE_LIST);
+  priqueue_init_backend(&heap, compare1, PRIQUEUE_HEAP);
+  for (unsigned int j = 0; j < 500; ++j) {
+    priqueue_offer(&list, &values[j]);
+    priqueue_offer(&heap, &values[j]);
+    if (j % 3 == 0) {
+      REQUIRE(priqueue_poll(&list) == priqueue_poll(&heap));
+    }
+  }
+  REQUIRE(priqueue_size(&list) == priqueue_size(&heap));
+  while (priqueue_size(&list) > 0) {
+    REQUIRE(priqueue_poll(&list) == priqueue_poll(&heap));
+  }
+  priqueue_destroy(&list);
+  priqueue_destroy(&heap);
+
+  delete[] values;
+}
+
+TEST_CASE("priqueue_sorted lists the queue in the order it is polled",
+          "[priqueue_init_backend][priqueue_sorted][priqueue_poll]") {
+  int *values = new int[200];
+  void **elements = new void *[200];
+  priqueue_backend_t backends[] = {PRIQUEUE_LIST, PRIQUEUE_HEAP};
+
+  srand(7);
+  for (unsigned int i = 0; i < 200; i++) {
+    values[i] = rand() % 10;
+  }
+  for (priqueue_backend_t backend : backends) {
+    priqueue_t q;
+    priqueue_init_backend(&q, compare1, backend);
+    REQUIRE(priqueue_sorted(&q, elements) == 0);
+    for (unsigned int j = 0; j < 200; ++j) {
+      priqueue_offer(&q, &values[j]);
+      if (j % 4 == 0) {
+        priqueue_poll(&q);
+      }
+    }
+
+    unsigned int size = priqueue_size(&q);
+    REQUIRE(priqueue_sorted(&q, elements) == (int)size);
+    REQUIRE(priqueue_size(&q) == size);
+    for (unsigned int j = 0; j < size; ++j) {
+      REQUIRE(priqueue_poll(&q) == elements[j]);
+    }
+    priqueue_destroy(&q);
+  }
+
+  delete[] elements;
+  delete[] values;
+}
+
+TEST_CASE("Heap queue keeps FIFO order for a comparer that always returns -1",
+          "[priqueue_init_backend][priqueue_offer][priqueue_poll]") {
+  int *values = new int[100];
+
+  priqueue_t q;
+  priqueue_init_backend(&q, compare_fifo, PRIQUEUE_HEAP);
+  for (unsigned int j = 0; j < 100; ++j) {
+    values[j] = 100 - j;
+    REQUIRE(priqueue_offer(&q, &values[j]) == j);
+  }
+  for (unsigned int j = 0; j < 100; ++j) {
+    REQUIRE(priqueue_poll(&q) == &values[j]);
+  }
+  priqueue_destroy(&q);
+
+  delete[] values;
+}
+
+TEST_CASE("Heap queue priqueue_remove and priqueue_remove_at keep the heap ordered",
+          "[priqueue_init_backend][priqueue_at][priqueue_remove][priqueue_remove_at]") {
+  int *values = new int[100];
+
+  priqueue_t q;
+  for (unsigned int i = 0; i < 100; i++) {
+    values[i] = (i * 37) % 100;
+  }
+  priqueue_init_backend(&q, compare1, PRIQUEUE_HEAP);
+  for (unsigned int j = 0; j < 100; ++j) {
+    priqueue_offer(&q, &values[j]);
+  }
+  int removed_value = 23;
+  REQUIRE(priqueue_remove(&q, &removed_value) == 1);
+  REQUIRE(priqueue_size(&q) == 99);
+  REQUIRE(priqueue_remove_at(&q, 10) != NULL);
+  REQUIRE(priqueue_remove_at(&q, 200) == NULL);
+  REQUIRE(priqueue_size(&q) == 98);
+  int last = -1;
+  while (priqueue_size(&q) > 0) {
+    int *value = (int *)priqueue_poll(&q);
+    REQUIRE(*value != 23);
+    REQUIRE(*value > last);
+    last = *value;
+  }
+  priqueue_destroy(&q);
+
+  delete[] values;
+}
+
+TEST_CASE("priqueue_remove_handle removes arbitrary elements", "[priqueue_offer_handle][priqueue_remove_handle]") {
+  priqueue_backend_t backends[] = {PRIQUEUE_LIST, PRIQUEUE_HEAP};
+  for (priqueue_backend_t backend : backends) {
+    int *values = new int[100];
+    priqueue_handle_t *handles = new priqueue_handle_t[100];
+
+    priqueue_t q;
+    priqueue_init_backend(&q, compare1, backend);
+    for (unsigned int j = 0; j < 100; ++j) {
+      values[j] = (j * 37) % 100;
+      handles[j] = priqueue_offer_handle(&q, &values[j]);
+    }
+    for (unsigned int j = 0; j < 100; j += 2) {
+      REQUIRE(priqueue_remove_handle(&q, handles[j]) == &values[j]);
+    }
+    REQUIRE(priqueue_size(&q) == 50);
+    int last = -1;
+    while (priqueue_size(&q) > 0) {
+      int *value = (int *)priqueue_poll(&q);
+      REQUIRE(*value > last);
+      REQUIRE(((value - values) % 2) == 1);
+      last = *value;
+    }
+    priqueue_destroy(&q);
+
+    delete[] handles;
+    delete[] values;
+  }
+}
+
+TEST_CASE("priqueue_update_handle repositions elements after a key change",
+          "[priqueue_offer_handle][priqueue_update_handle]") {
+  priqueue_backend_t backends[] = {PRIQUEUE_LIST, PRIQUEUE_HEAP};
+  for (priqueue_backend_t backend : backends) {
+    int *values = new int[100];
+    priqueue_handle_t *handles = new priqueue_handle_t[100];
+
+    priqueue_t q;
+    priqueue_init_backend(&q, compare1, backend);
+    for (unsigned int j = 0; j < 100; ++j) {
+      values[j] = j + 100;
+      handles[j] = priqueue_offer_handle(&q, &values[j]);
+    }
+
+    // Decrease a key to the front, increase another to the back
+    values[50] = 0;
+    REQUIRE(priqueue_update_handle(&q, handles[50]) == 0);
+    values[0] = 1000;
+    priqueue_update_handle(&q, handles[0]);
+    REQUIRE(priqueue_peek(&q) == &values[50]);
+
+    int last = -1;
+    unsigned int count = 0;
+    while (priqueue_size(&q) > 0) {
+      int *value = (int *)priqueue_poll(&q);
+      REQUIRE(*value > last);
+      last = *value;
+      ++count;
+    }
+    REQUIRE(count == 100);
+    REQUIRE(last == 1000);
+    priqueue_destroy(&q);
+
+    delete[] handles;
+    delete[] values;
+  }
+}
+
+TEST_CASE("Pooled nodes are reused after elements leave the queue", "[priqueue_init_capacity][priqueue_offer_handle]") {
+  priqueue_backend_t backends[] = {PRIQUEUE_LIST, PRIQUEUE_HEAP};
+  for (priqueue_backend_t backend : backends) {
+    int *values = new int[64];
+
+    priqueue_t q;
+    priqueue_init_capacity(&q, compare1, backend, 64);
+    for (unsigned int j = 0; j < 64; ++j) {
+      values[j] = j;
+      priqueue_offer(&q, &values[j]);
+    }
+    REQUIRE(q.pool_size == 64);
+
+    // Round-robin style poll and re-offer must not grow the pool
+    for (unsigned int j = 0; j < 1000; ++j) {
+      int *value = (int *)priqueue_poll(&q);
+      priqueue_offer(&q, value);
+    }
+    REQUIRE(q.pool_size == 64);
+
+    priqueue_handle_t handle = priqueue_offer_handle(&q, &values[0]);
+    REQUIRE(q.pool_size > 64);
+    priqueue_remove_handle(&q, handle);
+    REQUIRE(priqueue_offer_handle(&q, &values[0]) == handle);
+    REQUIRE(priqueue_size(&q) == 65);
+    priqueue_destroy(&q);
+    REQUIRE(priqueue_size(&q) == 0);
+    REQUIRE(q.pool_size == 0);
+
+    delete[] values;
+  }
+}
+
+TEST_CASE("Operation counters are kept only when built with STATS", "[priqueue_stats]") {
+  int *values = new int[100];
+
+  priqueue_t list, fifo;
+  priqueue_init_backend(&list, compare1, PRIQUEUE_LIST);
+  priqueue_init_backend(&fifo, compare1, PRIQUEUE_FIFO);
+  for (unsigned int j = 0; j < 100; ++j) {
+    values[j] = j;
+    priqueue_offer(&list, &values[j]);
+    priqueue_offer(&fifo, &values[j]);
+  }
+  for (unsigned int j = 0; j < 50; ++j) {
+    priqueue_poll(&list);
+    priqueue_poll(&fifo);
+  }
+
+  const priqueue_stats_t *stats = priqueue_stats(&list);
+#ifdef STATS
+  // Ascending values are each walked past every element already queued
+  REQUIRE(stats->operations == 150);
+  REQUIRE(stats->traversed == 99 * 100 / 2);
+  REQUIRE(stats->comparisons == 99 * 100 / 2);
+  REQUIRE(stats->allocations > 0);
+  REQUIRE(stats->high_water == 100);
+  REQUIRE(priqueue_stats(&fifo)->comparisons == 0);
+  REQUIRE(priqueue_stats(&fifo)->high_water == 100);
+#else
+  REQUIRE(stats->operations == 0);
+  REQUIRE(stats->comparisons == 0);
+  REQUIRE(stats->high_water == 0);
+#endif
+
+  priqueue_destroy(&list);
+  priqueue_destroy(&fifo);
+  delete[] values;
+}
+
+TEST_CASE("FIFO queue serves elements in the same order as the list queue",
+          "[priqueue_init_backend][priqueue_offer][priqueue_poll][priqueue_remove_handle]") {
+  int *values = new int[500];
+  priqueue_handle_t *list_handles = new priqueue_handle_t[500];
+  priqueue_handle_t *fifo_handles = new priqueue_handle_t[500];
+
+  priqueue_t list;
+  priqueue_t fifo;
+  priqueue_init_backend(&list, compare_fifo, PRIQUEUE_LIST);
+  priqueue_init_backend(&fifo, compare_fifo, PRIQUEUE_FIFO);
+  for (unsigned int j = 0; j < 500; ++j) {
+    values[j] = j;
+    list_handles[j] = priqueue_offer_handle(&list, &values[j]);
+    fifo_handles[j] = priqueue_offer_handle(&fifo, &values[j]);
+    if (j % 3 == 0) {
+      REQUIRE(priqueue_poll(&list) == priqueue_poll(&fifo));
+    }
+    if (j % 7 == 6) {
+      // Remove the newest element, then move an older one to the back
+      REQUIRE(priqueue_remove_handle(&list, list_handles[j]) == priqueue_remove_handle(&fifo, fifo_handles[j]));
+      REQUIRE(priqueue_update_handle(&list, list_handles[j - 2]) ==
+              priqueue_update_handle(&fifo, fifo_handles[j - 2]));
+    }
+  }
+  REQUIRE(priqueue_size(&list) == priqueue_size(&fifo));
+  for (unsigned int j = 0; j < priqueue_size(&list); ++j) {
+    REQUIRE(priqueue_at(&list, j) == priqueue_at(&fifo, j));
+  }
+  while (priqueue_size(&list) > 0) {
+    REQUIRE(priqueue_poll(&list) == priqueue_poll(&fifo));
+  }
+  REQUIRE(priqueue_poll(&fifo) == NULL);
+
+  // The tail is reset once the queue empties
+  priqueue_offer(&fifo, &values[1]);
+  priqueue_offer(&fifo, &values[0]);
+  REQUIRE(priqueue_poll(&fifo) == &values[1]);
+  REQUIRE(priqueue_poll(&fifo) == &values[0]);
+  priqueue_destroy(&list);
+  priqueue_destroy(&fifo);
+
+  delete[] fifo_handles;
+  delete[] list_handles;
+  delete[] values;
+}
+
+TEST_CASE("priqueue_snapshot rebuilds a queue that serves elements in the same order",
+          "[priqueue_snapshot][priqueue_offer][priqueue_poll]") {
+  int *values = new int[300];
+  void **elements = new void *[300];
+  priqueue_backend_t backends[] = {PRIQUEUE_LIST, PRIQUEUE_HEAP, PRIQUEUE_FIFO};
+
+  srand(7);
+  for (unsigned int i = 0; i < 300; i++) {
+    values[i] = rand() % 10;
+  }
+  for (unsigned int b = 0; b < 3; ++b) {
+    priqueue_t q;
+    priqueue_t copy;
+    priqueue_init_backend(&q, compare1, backends[b]);
+    priqueue_init_backend(&copy, compare1, backends[b]);
+    for (unsigned int j = 0; j < 300; ++j) {
+      priqueue_offer(&q, &values[j]);
+      if (j % 4 == 0) {
+        priqueue_poll(&q);
+      }
+    }
+    int count = priqueue_snapshot(&q, elements);
+    REQUIRE(count == (int)priqueue_size(&q));
+    for (int j = 0; j < count; ++j) {
+      priqueue_offer(&copy, elements[j]);
+    }
+
+    // Ties are still broken by the original order after more offers
+    for (unsigned int j = 0; j < 50; ++j) {
+      priqueue_offer(&q, &values[j]);
+      priqueue_offer(&copy, &values[j]);
+    }
+    while (priqueue_size(&q) > 0) {
+      REQUIRE(priqueue_poll(&q) == priqueue_poll(&copy));
+    }
+    REQUIRE(priqueue_size(&copy) == 0);
+
+    // An empty queue has nothing to copy
+    REQUIRE(priqueue_snapshot(&q, elements) == 0);
+    priqueue_destroy(&q);
+    priqueue_destroy(&copy);
+  }
+
+  delete[] elements;
+  delete[] values;
+}
+
+TEST_CASE("Template queue serves elements in the same order as the heap queue", "[priqueue::queue]") {
+  struct item_t {
+    int key;
+    int id;
+  };
+  struct compare_key {
+    int operator()(const item_t &a, const item_t &b) const {
+      return a.key - b.key;
+    }
+  };
+  item_t *values = new item_t[500];
+
+  priqueue_t heap;
+  priqueue::queue<item_t, compare_key> q;
+  srand(42);
+  priqueue_init_backend(&heap, compare1, PRIQUEUE_HEAP);
+  for (unsigned int j = 0; j < 500; ++j) {
+    values[j].key = rand() % 10;
+    values[j].id = j;
+    priqueue_offer(&heap, &values[j]);
+    q.offer(values[j]);
+    if (j % 3 == 0) {
+      REQUIRE(q.poll().id == ((item_t *)priqueue_poll(&heap))->id);
+    }
+  }
+  REQUIRE(q.size() == (std::size_t)priqueue_size(&heap));
+  while (!q.empty()) {
+    REQUIRE(q.peek().id == ((item_t *)priqueue_peek(&heap))->id);
+    REQUIRE(q.poll().id == ((item_t *)priqueue_poll(&heap))->id);
+  }
+  priqueue_destroy(&heap);
+
+  delete[] values;
+}
+
+TEST_CASE("Template queue inlines the C comparers", "[priqueue::queue][priqueue::function_comparer]") {
+  priqueue::queue<int, priqueue::function_comparer<compare1> > q;
+  srand(7);
+  for (unsigned int j = 0; j < 1000; ++j) {
+    q.offer(rand());
+  }
+  int last = q.poll();
+  while (!q.empty()) {
+    int value = q.poll();
+    REQUIRE(value >= last);
+    last = value;
+  }
+  q.offer(1);
+  q.clear();
+  REQUIRE(q.empty());
+}
+
+TEST_CASE("Template FIFO queue keeps arrival order", "[priqueue::queue][priqueue::fifo]") {
+  priqueue::queue<int, priqueue::fifo> q;
+  for (int j = 0; j < 100; ++j) {
+    q.offer(100 - j);
+  }
+  REQUIRE(q.size() == 100);
+  for (int j = 0; j < 100; ++j) {
+    REQUIRE(q.peek() == 100 - j);
+    REQUIRE(q.poll() == 100 - j);
+  }
+  REQUIRE(q.empty());
+}
+
+TEST_CASE("Scheduler context makes the same decisions as the C API", "[scheduler::context]") {
+  const int cores = 3, quantum = 2;
+  const int job_count = 300;
+  std::vector<scheduler_arrival_t> jobs(job_count);
+  std::vector<int> arrival(job_count), remaining(job_count);
+  srand(11);
+  for (int j = 0, time = 0; j < job_count; ++j) {
+    time += rand() % 3;
+    arrival[j] = time;
+    jobs[j].job_number = j;
+    jobs[j].running_time = remaining[j] = 1 + rand() % 8;
+    jobs[j].priority = rand() % 4;
+  }
+
+  scheduler_t *reference = scheduler_create(cores, RR);
+  scheduler::context ctx(cores, RR);
+  std::vector<int> running(cores, -1), clock(cores, -1);
+  std::vector<scheduler::completion> finished;
+  std::vector<int> expired, reference_cores(job_count);
+  int next = 0, done = 0;
+
+  for (int time = 0; done < job_count; ++time) {
+    // The reference is driven the way simulator.c drives it
+    std::vector<scheduler::dispatch> expected;
+    for (std::size_t i = 0; i < finished.size(); ++i) {
+      int job = scheduler_job_finished_r(reference, finished[i].core_id, finished[i].job_number, time);
+      scheduler::dispatch decision = {finished[i].core_id, job, finished[i].job_number};
+      expected.push_back(decision);
+    }
+    for (std::size_t i = 0; i < expired.size(); ++i) {
+      int job = scheduler_quantum_expired_r(reference, expired[i], time);
+      scheduler::dispatch decision = {expired[i], job, running[expired[i]]};
+      expected.push_back(decision);
+    }
+    int first = next;
+    while (next < job_count && arrival[next] == time) {
+      ++next;
+    }
+    scheduler_new_jobs_r(reference, &jobs[first], next - first, time, &reference_cores[0]);
+    for (int j = first; j < next; ++j) {
+      if (reference_cores[j - first] != -1) {
+        scheduler::dispatch decision = {reference_cores[j - first], j, -1};
+        expected.push_back(decision);
+      }
+    }
+
+    scheduler::span<const scheduler_arrival_t> arrivals(next > first ? &jobs[first] : NULL, next - first);
+    scheduler::span<const scheduler::dispatch> decisions = ctx.step(time, finished, expired, arrivals);
+    REQUIRE(decisions.size() == expected.size());
+    for (std::size_t i = 0; i < decisions.size(); ++i) {
+      REQUIRE(decisions[i].core_id == expected[i].core_id);
+      REQUIRE(decisions[i].job_number == expected[i].job_number);
+      if (expected[i].previous != -1) {
+        REQUIRE(decisions[i].previous == expected[i].previous);
+      }
+      else {
+        REQUIRE(decisions[i].previous == running[decisions[i].core_id]);
+      }
+      running[decisions[i].core_id] = decisions[i].job_number;
+      clock[decisions[i].core_id] = quantum;
+    }
+
+    // Run the time unit
+    finished.clear();
+    expired.clear();
+    for (int core = 0; core < cores; ++core) {
+      REQUIRE(ctx.running(core) == running[core]);
+      if (running[core] == -1) {
+        continue;
+      }
+      --clock[core];
+      if (--remaining[running[core]] == 0) {
+        scheduler::completion completion = {core, running[core]};
+        finished.push_back(completion);
+        ++done;
+      }
+      else if (clock[core] == 0) {
+        expired.push_back(core);
+      }
+    }
+  }
+
+  REQUIRE(ctx.average_waiting_time() == scheduler_average_waiting_time_r(reference));
+  REQUIRE(ctx.average_turnaround_time() == scheduler_average_turnaround_time_r(reference));
+  REQUIRE(ctx.average_response_time() == scheduler_average_response_time_r(reference));
+  scheduler_destroy(reference);
+}
+
+TEST_CASE("Scheduler context is move-only", "[scheduler::context]") {
+  static_assert(!std::is_copy_constructible<scheduler::context>::value, "context must not be copyable");
+  static_assert(!std::is_copy_assignable<scheduler::context>::value, "context must not be copyable");
+  static_assert(std::is_nothrow_move_constructible<scheduler::context>::value, "context must be movable");
+
+  scheduler::context a(2, PSJF);
+  int placed = 0;
+  scheduler_arrival_t arrivals[] = {{0, 5, 0}, {1, 3, 0}, {2, 1, 0}};
+  a.step(0,
+         scheduler::span<const scheduler::completion>(),
+         scheduler::span<const int>(),
+         arrivals,
+         [&placed](const scheduler::dispatch &decision) {
+           REQUIRE(decision.core_id != -1);
+           ++placed;
+         });
+  // Job 2 preempts job 0 in the same batch, so job 0 is reported as waiting
+  REQUIRE(placed == 2);
+  REQUIRE(a.running(0) == 2);
+  REQUIRE(a.running(1) == 1);
+
+  scheduler::context b(std::move(a));
+  REQUIRE(!a);
+  REQUIRE(b);
+  REQUIRE(b.running(0) == 2);
+
+  scheduler::dispatch decision = b.job_finished(0, 2, 1);
+  REQUIRE(decision.core_id == 0);
+  REQUIRE(decision.job_number == 0);
+  REQUIRE(decision.previous == 2);
+
+  a = std::move(b);
+  REQUIRE(a);
+  REQUIRE(!b);
+  REQUIRE(a.running(0) == 0);
+}
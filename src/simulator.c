@@ -4,50 +4,370 @@
  */
 
 #include <assert.h>
+#include <getopt.h>
+#include <limits.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
 
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "libcheckpoint/libcheckpoint.h"
+#include "libeventlog/libeventlog.h"
+#include "libdiagram/libdiagram.h"
+#include "libmetrics/libmetrics.h"
 #include "libscheduler/libscheduler.h"
+#include "libshard/libshard.h"
+#include "libsweep/libsweep.h"
+#include "libtrace/libtrace.h"
+
+
+/*
+ * Jobs are stored as one array per field instead of one struct per job, so a
+ * scan over one field (Eg: the remaining time of the running jobs) streams
+ * through contiguous memory.  A job is the same index into every array.
+ */
+typedef struct _simulator_job_table_t {
+  int *job_id;
+  int *arrival_time;
+  int *run_time;        // total running time
+  int *remaining_time;  // time units left to run
+  int *priority;
+  int *core_id;         // core running the job, or -1
+  int *start_time;      // time the job first ran, or -1
+  int *arrived;
+  int *slot;            // slot in the active list, or -1 once finished
+} simulator_job_table_t;
+
+/*
+ * Each unfinished job owns a slot in an "active" list that is compacted by
+ * swapping the last slot into the place of a finished job.  Events that
+ * happen in the same time unit are delivered in slot order.
+ *
+ * Normally every job is loaded (and given a slot) before the simulation
+ * starts, and jobs are stored by job_id.  When streaming, jobs are read from
+ * the trace as simulated time reaches their arrival, are given a slot when
+ * they arrive, and are stored in a pool of in-flight jobs found through a
+ * hash of their job_id.  Arrivals are delivered in file order either way, but
+ * the slots differ, so jobs that finish in the same time unit on different
+ * cores may be delivered in another order when streaming, and a preemptive
+ * scheme or RR can then go on to schedule them differently.
+ */
+typedef struct _simulator_state_t {
+  simulator_job_table_t jobs;  // indexed by job_id, or the pool of in-flight jobs when streaming
+  int job_count;               // jobs loaded so far
+  int job_capacity;            // length of every array of jobs
+  int *active_slots;           // slot -> job_id, for the first active_jobs slots
+  int active_jobs;
+  int active_capacity;
+  int *running;                // core -> job_id, or -1 if idle
+  int *core_remaining;         // core -> time units left of the job it runs (the job table is only up to date for jobs off a core)
+
+  // Loaded traces
+  int *arrival_order;  // job_ids sorted by arrival time
+  int next_arrival;    // cursor into arrival_order
+
+  // Streamed traces
+  trace_reader_t *reader;
+  trace_job_t next_job;
+  int has_next_job;
+  int *job_index;  // open-addressed hash of job_id -> index into jobs, -1 if empty
+  int job_index_capacity;
+  int *free_jobs;  // stack of unused indices into jobs
+  int free_job_count;
+  int *arrivals;   // job_ids arriving in the current time unit
+  int arrivals_capacity;
+} simulator_state_t;
+
+typedef struct _simulator_options_t {
+  int cores, scheme, quantum;
+  int event_driven, quiet, compressed;
+  int per_core;  // give every core its own queue
+  char *export_name;
+  int metrics;  // collect percentiles, throughput and utilization
+  int aging;    // time units of waiting that raise the priority of a PRI or PPRI job by one, or 0
+  checkpoint_writer_t *checkpoint;  // writes checkpoints of the simulation, or NULL
+  FILE *resume;                     // checkpoint to resume the simulation from, positioned after its options, or NULL
+  int has_diagram;                  // whether the checkpoint to resume from has a timing diagram
+  eventlog_t *events;               // records every scheduling event, or NULL
+} simulator_options_t;
 
+/*
+ * Default number of seconds between two checkpoints.
+ */
+#define SIMULATOR_CHECKPOINT_INTERVAL 60
+
+/*
+ * Options of getopt_long() that only have a long form.
+ */
+enum { OPTION_CHECKPOINT = 256, OPTION_CHECKPOINT_INTERVAL, OPTION_RESUME, OPTION_EVENTS, OPTION_SHARD, OPTION_SUMMARY };
+
+typedef struct _simulator_result_t {
+  int status;  // exit status of the simulation, 0 on success
+  float waiting_time, turnaround_time, response_time;
+  metrics_t *metrics;  // NULL unless the options asked for metrics
+  scheduler_stats_t stats;  // all 0 unless built with STATS defined
+} simulator_result_t;
 
-typedef struct _simulator_job_list_t {
-  int job_id, arrival_time, run_time, priority;
-  int core_id, arrived;
-} simulator_job_list_t;
+/*
+ * A sweep simulates every configuration on its own copy of one shared trace.
+ */
+typedef struct _simulator_sweep_t {
+  const trace_t *trace;
+  simulator_options_t *configs;
+  simulator_result_t *results;
+} simulator_sweep_t;
 
 void print_usage(char *program_name) {
-  fprintf(stderr, "Usage: %s -c <cores> -s <scheme> <input file>\n", program_name);
+  fprintf(stderr, "Usage: %s -c <cores> -s <scheme> [-e] [-l] [-q [-d]] [-x <file>] [-j <threads>] [-p] [-m] [-a <interval>]\n", program_name);
+  fprintf(stderr, "         [--checkpoint <file> [--checkpoint-interval <seconds>]] [--events <file>] <input file>\n");
+  fprintf(stderr, "       %s --resume <file> [-e] [-q [-d]] [-x <file>] [-m] [--checkpoint <file> ...] [--events <file>]\n", program_name);
+  fprintf(stderr, "       %s -c <cores> -s <scheme> [-q] [-j <threads>] [-p] [-a <interval>] [--shard <i>/<n>]\n", program_name);
+  fprintf(stderr, "         --summary <file> <input file>...\n");
   fprintf(stderr, "       %s -c 2 -s fcfs examples/proc1.csv\n", program_name);
   fprintf(stderr, "\n");
-  fprintf(stderr, "Acceptable schemes are: fcfs, sjf, psjf, pri, ppri, rr#\n");
+  fprintf(stderr, "Acceptable schemes are: fcfs, sjf, psjf, pri, ppri, rr#, mlfq[#]\n");
+  fprintf(stderr, "(mlfq# has %d levels whose quanta start at # (default: %d) and double at each level,\n",
+          SCHEDULER_MLFQ_LEVELS, SCHEDULER_MLFQ_QUANTUM);
+  fprintf(stderr, "and boosts every job back to the top level every %d top level quanta)\n", SCHEDULER_MLFQ_BOOST_QUANTA);
+  fprintf(stderr, "\n");
+  fprintf(stderr, "  -e  event-driven: skip ahead to the next arrival, finish or quantum expiry\n");
+  fprintf(stderr, "      instead of printing every time unit\n");
+  fprintf(stderr, "  -l  stream the input file, reading each job when it arrives (the file must be\n");
+  fprintf(stderr, "      sorted by arrival time)\n");
+  fprintf(stderr, "  -q  quiet: print only the final averages (implies -e)\n");
+  fprintf(stderr, "  -d  with -q, also print the final timing diagram run-length encoded, as\n");
+  fprintf(stderr, "      job:time units\n");
+  fprintf(stderr, "  -x  export the final timing diagram to <file> as CSV, one\n");
+  fprintf(stderr, "      core,job_id,start,length line per run of a job (job_id -1 is idle)\n");
+  fprintf(stderr, "  -p  give every core its own queue; a core that runs out of work steals from\n");
+  fprintf(stderr, "      the others\n");
+  fprintf(stderr, "  -j  number of threads of a sweep (default: one per online CPU)\n");
+  fprintf(stderr, "  -m  also print the p50/p95/p99 waiting, response and turnaround times, the\n");
+  fprintf(stderr, "      throughput and the utilization of every core (p99s only in a sweep)\n");
+  fprintf(stderr, "  -a  age pri and ppri jobs: raise the priority of a waiting job by one every\n");
+  fprintf(stderr, "      <interval> time units it waits\n");
+  fprintf(stderr, "\n");
+  fprintf(stderr, "  --checkpoint           save the whole state of the simulation to <file> every\n");
+  fprintf(stderr, "                         --checkpoint-interval seconds (default: %d), written from\n", SIMULATOR_CHECKPOINT_INTERVAL);
+  fprintf(stderr, "                         a background thread\n");
+  fprintf(stderr, "  --resume               carry on the simulation saved in the checkpoint <file>, with\n");
+  fprintf(stderr, "                         the cores, scheme and trace it was started with\n");
+  fprintf(stderr, "  --events               record every arrival, dispatch, preemption, quantum expiry\n");
+  fprintf(stderr, "                         and finish to <file>, written from a background thread: a\n");
+  fprintf(stderr, "                         Chrome trace if <file> ends in .json, a binary log otherwise\n");
+  fprintf(stderr, "  --summary              sweep every configuration over every input file and write\n");
+  fprintf(stderr, "                         the metrics of each simulation to <file> for mergesweep\n");
+  fprintf(stderr, "  --shard                with --summary, only simulate shard <i> (from 0 to <n> - 1)\n");
+  fprintf(stderr, "                         of <n>, every <n>th pair of an input file and a configuration\n");
+  fprintf(stderr, "\n");
+  fprintf(stderr, "-c and -s also take comma separated lists and ranges (Eg: -c 1-4,8 -s fcfs,rr1-4).\n");
+  fprintf(stderr, "With more than one configuration, the trace is loaded once and every\n");
+  fprintf(stderr, "configuration is simulated on a pool of threads, printing one table of averages.\n");
+  fprintf(stderr, "\n");
+  fprintf(stderr, "The input file is either a CSV job file or a binary trace written by csv2trace.\n");
 }
 
-int set_active_job(int job_id, int core_id, simulator_job_list_t *jobs, int active_jobs) {
-  int i;
-  for (i = 0; i < active_jobs; i++) {
-    if (jobs[i].job_id == job_id && jobs[i].arrived) {
-      jobs[i].core_id = core_id;
-      return 1;
+/*
+ * Resizes every array of a job table to capacity jobs.
+ */
+void job_table_resize(simulator_job_table_t *table, int capacity) {
+  table->job_id = realloc(table->job_id, capacity * sizeof(int));
+  table->arrival_time = realloc(table->arrival_time, capacity * sizeof(int));
+  table->run_time = realloc(table->run_time, capacity * sizeof(int));
+  table->remaining_time = realloc(table->remaining_time, capacity * sizeof(int));
+  table->priority = realloc(table->priority, capacity * sizeof(int));
+  table->core_id = realloc(table->core_id, capacity * sizeof(int));
+  table->start_time = realloc(table->start_time, capacity * sizeof(int));
+  table->arrived = realloc(table->arrived, capacity * sizeof(int));
+  table->slot = realloc(table->slot, capacity * sizeof(int));
+}
+
+void job_table_free(simulator_job_table_t *table) {
+  free(table->job_id);
+  free(table->arrival_time);
+  free(table->run_time);
+  free(table->remaining_time);
+  free(table->priority);
+  free(table->core_id);
+  free(table->start_time);
+  free(table->arrived);
+  free(table->slot);
+}
+
+unsigned int hash_job_id(int job_id, int capacity) {
+  return ((unsigned int)job_id * 2654435761u) & (unsigned int)(capacity - 1);
+}
+
+void index_insert(simulator_state_t *state, int job_id, int index) {
+  unsigned int i = hash_job_id(job_id, state->job_index_capacity);
+  while (state->job_index[i] != -1)
+    i = (i + 1) & (state->job_index_capacity - 1);
+  state->job_index[i] = index;
+}
+
+void index_remove(simulator_state_t *state, int job_id) {
+  unsigned int mask = state->job_index_capacity - 1;
+  unsigned int i = hash_job_id(job_id, state->job_index_capacity);
+  while (state->jobs.job_id[state->job_index[i]] != job_id)
+    i = (i + 1) & mask;
+
+  // Backward-shift the following entries so lookups never hit a hole
+  unsigned int hole = i;
+  for (i = (hole + 1) & mask; state->job_index[i] != -1; i = (i + 1) & mask) {
+    unsigned int home = hash_job_id(state->jobs.job_id[state->job_index[i]], state->job_index_capacity);
+    if (((i - home) & mask) >= ((i - hole) & mask)) {
+      state->job_index[hole] = state->job_index[i];
+      hole = i;
     }
   }
+  state->job_index[hole] = -1;
+}
 
-  return 0;
+/*
+ * Returns the index of a job into the job table, or -1 if there is no such
+ * job.
+ */
+int find_job(simulator_state_t *state, int job_id) {
+  if (state->reader == NULL)
+    return (job_id >= 0 && job_id < state->job_count) ? job_id : -1;
+
+  unsigned int i = hash_job_id(job_id, state->job_index_capacity);
+  while (state->job_index[i] != -1) {
+    if (state->jobs.job_id[state->job_index[i]] == job_id)
+      return state->job_index[i];
+    i = (i + 1) & (state->job_index_capacity - 1);
+  }
+
+  return -1;
+}
+
+/*
+ * Adds a job read from the trace and gives it the next job_id and slot.
+ */
+int add_job(simulator_state_t *state, trace_job_t *trace_job) {
+  int i, index;
+
+  if (state->active_jobs == state->active_capacity) {
+    state->active_capacity *= 2;
+    state->active_slots = realloc(state->active_slots, state->active_capacity * sizeof(int));
+  }
+
+  if (state->reader == NULL) {
+    if (state->job_count == state->job_capacity) {
+      state->job_capacity *= 2;
+      job_table_resize(&state->jobs, state->job_capacity);
+    }
+    index = state->job_count;
+  }
+  else {
+    if (state->free_job_count == 0) {
+      // Grow the pool of in-flight jobs and rebuild the index at twice its size
+      int old_capacity = state->job_capacity;
+      state->job_capacity *= 2;
+      job_table_resize(&state->jobs, state->job_capacity);
+      state->free_jobs = realloc(state->free_jobs, state->job_capacity * sizeof(int));
+      for (i = state->job_capacity; i > old_capacity; i--)
+        state->free_jobs[state->free_job_count++] = i - 1;
+
+      // The pool was full, so every old entry is an in-flight job
+      state->job_index_capacity = 2 * state->job_capacity;
+      state->job_index = realloc(state->job_index, state->job_index_capacity * sizeof(int));
+      for (i = 0; i < state->job_index_capacity; i++)
+        state->job_index[i] = -1;
+      for (i = 0; i < old_capacity; i++)
+        index_insert(state, state->jobs.job_id[i], i);
+    }
+    index = state->free_jobs[--state->free_job_count];
+  }
+
+  simulator_job_table_t *jobs = &state->jobs;
+  int job_id = state->job_count++;
+  jobs->job_id[index] = job_id;
+  jobs->arrival_time[index] = trace_job->arrival_time;
+  jobs->run_time[index] = trace_job->run_time;
+  jobs->remaining_time[index] = trace_job->run_time;
+  jobs->priority[index] = trace_job->priority;
+  jobs->core_id[index] = -1;
+  jobs->start_time[index] = -1;
+  jobs->arrived[index] = 0;
+  jobs->slot[index] = state->active_jobs;
+  state->active_slots[state->active_jobs++] = job_id;
+
+  if (state->reader != NULL)
+    index_insert(state, job_id, index);
+
+  return job_id;
+}
+
+int set_active_job(int job_id, int core_id, int time, simulator_state_t *state) {
+  simulator_job_table_t *jobs = &state->jobs;
+  int job = find_job(state, job_id);
+
+  if (job == -1 || jobs->slot[job] == -1 || !jobs->arrived[job])
+    return 0;
+
+  // A job can only run on one core at a time
+  if (jobs->core_id[job] != -1 && state->running[jobs->core_id[job]] == job_id) {
+    jobs->remaining_time[job] = state->core_remaining[jobs->core_id[job]];
+    state->running[jobs->core_id[job]] = -1;
+  }
+
+  jobs->core_id[job] = core_id;
+  if (jobs->start_time[job] == -1)
+    jobs->start_time[job] = time;
+  state->running[core_id] = job_id;
+  state->core_remaining[core_id] = jobs->remaining_time[job];
+  return 1;
+}
+
+void clear_core(int core_id, simulator_state_t *state) {
+  if (state->running[core_id] != -1) {
+    int job = find_job(state, state->running[core_id]);
+    state->jobs.core_id[job] = -1;
+    state->jobs.remaining_time[job] = state->core_remaining[core_id];
+    state->running[core_id] = -1;
+  }
+}
+
+void finish_job(int job_id, simulator_state_t *state) {
+  simulator_job_table_t *jobs = &state->jobs;
+  int job = find_job(state, job_id);
+  int last = state->active_slots[state->active_jobs - 1];
+
+  if (jobs->core_id[job] != -1 && state->running[jobs->core_id[job]] == job_id)
+    state->running[jobs->core_id[job]] = -1;
+
+  // Delete the finished job by moving the last active slot into its place
+  state->active_slots[jobs->slot[job]] = last;
+  jobs->slot[find_job(state, last)] = jobs->slot[job];
+  state->active_jobs--;
+  jobs->slot[job] = -1;
+
+  // Streamed jobs are forgotten as soon as they finish
+  if (state->reader != NULL) {
+    index_remove(state, job_id);
+    state->free_jobs[state->free_job_count++] = job;
+  }
 }
 
-void print_available_jobs(simulator_job_list_t *jobs, int active_jobs) {
+void print_available_jobs(simulator_state_t *state) {
   printf("Active jobs are: ");
 
   int i, first = 1;
-  for (i = 0; i < active_jobs; i++) {
-    if (jobs[i].arrived) {
+  for (i = 0; i < state->active_jobs; i++) {
+    int job = find_job(state, state->active_slots[i]);
+    if (state->jobs.arrived[job]) {
       if (first) {
-        printf("%d", jobs[i].job_id);
+        printf("%d", state->jobs.job_id[job]);
         first = 0;
       }
       else
-        printf(", %d", jobs[i].job_id);
+        printf(", %d", state->jobs.job_id[job]);
     }
   }
 
@@ -55,273 +375,620 @@ void print_available_jobs(simulator_job_list_t *jobs, int active_jobs) {
     printf("\n");
 }
 
-void print_available_cores(int cores) {
-  printf("Active cores are: ");
-
-  int i;
-  for (i = 0; i < cores; i++) {
-    if (i == cores - 1)
-      printf("%d\n", i);
-    else
-      printf("%d, ", i);
+/*
+ * Sorts up to cores job_ids by their current slot.
+ */
+void sort_by_slot(int *job_ids, int count, simulator_state_t *state) {
+  int i, j;
+  for (i = 1; i < count; i++) {
+    int job_id = job_ids[i];
+    for (j = i; j > 0 && state->jobs.slot[find_job(state, job_ids[j - 1])] > state->jobs.slot[find_job(state, job_id)]; j--)
+      job_ids[j] = job_ids[j - 1];
+    job_ids[j] = job_id;
   }
 }
 
+/*
+ * Returns the arrival time of the next job that has not arrived yet, or -1 if
+ * there is none.
+ */
+int next_arrival_time(simulator_state_t *state) {
+  if (state->reader != NULL)
+    return state->has_next_job ? state->next_job.arrival_time : -1;
 
-int main(int argc, char **argv) {
-  int c;
-  int cores = 0, scheme = -1, quantum = 0;
-  char *file_name;
+  if (state->next_arrival < state->job_count)
+    return state->jobs.arrival_time[state->arrival_order[state->next_arrival]];
 
-  /*
-	 * Parse command line options.
-	 */
-  while ((c = getopt(argc, argv, "c:s:")) != -1) {
-    switch (c) {
-      case 'c':
-        cores = atoi(optarg);
+  return -1;
+}
 
-        if (cores <= 0) {
-          fprintf(stderr, "Option -c <cores> require a positive number.\n");
-          print_usage(argv[0]);
-          return 1;
-        }
-        break;
+/*
+ * Reads one job ahead of a streamed trace.  Returns 0 on success or -1 if
+ * the trace is malformed or not sorted by arrival time.
+ */
+int read_next_job(simulator_state_t *state) {
+  int last_arrival_time = state->has_next_job ? state->next_job.arrival_time : 0;
+  int result = trace_read(state->reader, &state->next_job);
 
-      case 's':
-        if (strcasecmp(optarg, "FCFS") == 0) {
-          scheme = FCFS;
-        }
-        else if (strcasecmp(optarg, "SJF") == 0) {
-          scheme = SJF;
-        }
-        else if (strcasecmp(optarg, "PSJF") == 0) {
-          scheme = PSJF;
-        }
-        else if (strcasecmp(optarg, "PRI") == 0) {
-          scheme = PRI;
-        }
-        else if (strcasecmp(optarg, "PPRI") == 0) {
-          scheme = PPRI;
-        }
-        else if (strncasecmp(optarg, "RR", 2) == 0) {
-          scheme = RR;
-          quantum = atoi(optarg + 2);
-
-          if (quantum <= 0) {
-            fprintf(stderr, "Option -s <scheme> requires a positive number for the quantum of RR. (Eg: -s RR2)\n");
-            print_usage(argv[0]);
-            return 1;
-          }
-        }
-        break;
+  state->has_next_job = (result == 1);
+  if (result == -1 || (result == 1 && state->next_job.arrival_time < last_arrival_time))
+    return -1;
 
-      case '?':
-        print_usage(argv[0]);
-        return 1;
+  return 0;
+}
 
-      default:
-        printf("....\n");
-        break;
+/*
+ * Collects the job_ids of the jobs arriving at time, in the order they are to
+ * be delivered.  Returns the number of arrivals, or -1 if a streamed trace is
+ * malformed or not sorted by arrival time.
+ */
+int collect_arrivals(simulator_state_t *state, int time, int **arrivals) {
+  int count = 0;
+
+  if (state->reader == NULL) {
+    while (state->next_arrival + count < state->job_count &&
+           state->jobs.arrival_time[state->arrival_order[state->next_arrival + count]] == time)
+      count++;
+
+    // Simultaneous arrivals are delivered in file order, the order a streamed trace reads them in
+    *arrivals = &state->arrival_order[state->next_arrival];
+    state->next_arrival += count;
+    return count;
+  }
+
+  while (state->has_next_job && state->next_job.arrival_time == time) {
+    if (count == state->arrivals_capacity) {
+      state->arrivals_capacity *= 2;
+      state->arrivals = realloc(state->arrivals, state->arrivals_capacity * sizeof(int));
     }
+    state->arrivals[count++] = add_job(state, &state->next_job);
+
+    if (read_next_job(state) == -1)
+      return -1;
   }
 
-  if (cores == 0) {
-    fprintf(stderr, "Required option -c <cores> is not present.\n");
-    print_usage(argv[0]);
-    return 1;
+  *arrivals = state->arrivals;
+  return count;
+}
+
+/*
+ * Returns the number of time units until the next event (an arrival, a job
+ * finishing or a quantum expiring) that follows the current time.
+ */
+int time_until_next_event(int time, int scheme, int cores, int *quantum_clock, simulator_state_t *state) {
+  int i, delta = -1;
+
+  if (next_arrival_time(state) != -1)
+    delta = next_arrival_time(state) - time;
+
+  for (i = 0; i < cores; i++) {
+    if (state->running[i] != -1) {
+      int until = state->core_remaining[i];
+      if (until > 0 && (delta <= 0 || until < delta))
+        delta = until;
+
+      if ((scheme == RR || scheme == MLFQ) && quantum_clock[i] > 0 && (delta <= 0 || quantum_clock[i] < delta))
+        delta = quantum_clock[i];
+    }
   }
 
-  if (scheme == -1) {
-    fprintf(stderr, "Required option -s <scheme> is not present.\n");
-    print_usage(argv[0]);
-    return 1;
+  return (delta <= 0) ? 1 : delta;
+}
+
+/*
+ * Runs every busy core for delta time units, decrementing the time left of
+ * its job and its quantum.  Sets the bit of each busy core whose job finished
+ * in finished, and of each busy core whose quantum expired in expired (both
+ * of (cores + 63) / 64 words), and returns the number of busy cores.
+ */
+int run_cores(int cores, int delta, const int *running, int *remaining, int *quantum_clock, uint64_t *finished, uint64_t *expired) {
+  int i, busy = 0;
+
+  for (i = 0; i < (cores + 63) / 64; i++) {
+    finished[i] = 0;
+    expired[i] = 0;
   }
 
-  if (optind == argc - 1)
-    file_name = argv[optind];
-  else {
-    fprintf(stderr, "A single input file is required.\n");
-    print_usage(argv[0]);
-    return 1;
+  i = 0;
+#ifdef __SSE2__
+  // Four cores at a time; idle cores step by 0 and are masked out of the bits
+  const __m128i step = _mm_set1_epi32(delta);
+  const __m128i no_job = _mm_set1_epi32(-1);
+  const __m128i zero = _mm_setzero_si128();
+  for (; i + 4 <= cores; i += 4) {
+    __m128i idle = _mm_cmpeq_epi32(_mm_loadu_si128((const __m128i *)&running[i]), no_job);
+    __m128i busy_step = _mm_andnot_si128(idle, step);
+    __m128i left = _mm_sub_epi32(_mm_loadu_si128((const __m128i *)&remaining[i]), busy_step);
+    __m128i quantum = _mm_sub_epi32(_mm_loadu_si128((const __m128i *)&quantum_clock[i]), busy_step);
+    _mm_storeu_si128((__m128i *)&remaining[i], left);
+    _mm_storeu_si128((__m128i *)&quantum_clock[i], quantum);
+
+    uint64_t busy_bits = ~_mm_movemask_ps(_mm_castsi128_ps(idle)) & 0xf;
+    uint64_t finished_bits = _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(left, zero))) & busy_bits;
+    uint64_t expired_bits = _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(quantum, zero))) & busy_bits;
+    finished[i / 64] |= finished_bits << (i % 64);
+    expired[i / 64] |= expired_bits << (i % 64);
+    busy += __builtin_popcountll(busy_bits);
+  }
+#endif
+
+  for (; i < cores; i++) {
+    if (running[i] != -1) {
+      busy++;
+      remaining[i] -= delta;
+      quantum_clock[i] -= delta;
+      if (remaining[i] == 0)
+        finished[i / 64] |= (uint64_t)1 << (i % 64);
+      if (quantum_clock[i] == 0)
+        expired[i / 64] |= (uint64_t)1 << (i % 64);
+    }
   }
 
+  return busy;
+}
 
-  /*
-	 * Open the file, read the file, and populate the jobs data structure.
-	 */
-  FILE *file = fopen(file_name, "r");
-  if (file == NULL) {
-    fprintf(stderr, "Unable to open file \"%s\".\n", file_name);
-    return 2;
+typedef struct _simulator_arrival_t {
+  int arrival_time, job_id;
+} simulator_arrival_t;
+
+int compare_arrival(const void *a, const void *b) {
+  const simulator_arrival_t *lhs = (const simulator_arrival_t *)a;
+  const simulator_arrival_t *rhs = (const simulator_arrival_t *)b;
+
+  if (lhs->arrival_time != rhs->arrival_time)
+    return (lhs->arrival_time < rhs->arrival_time) ? -1 : 1;
+  return lhs->job_id - rhs->job_id;
+}
+
+/*
+ * Fills arrival_order with the job_ids sorted by arrival time (ties in file
+ * order).  Traces are normally already sorted, so that case is checked first.
+ */
+void build_arrival_order(simulator_state_t *state) {
+  int i, sorted = 1;
+
+  for (i = 1; i < state->job_count && sorted; i++)
+    sorted = state->jobs.arrival_time[i - 1] <= state->jobs.arrival_time[i];
+
+  if (sorted) {
+    for (i = 0; i < state->job_count; i++)
+      state->arrival_order[i] = i;
+    return;
+  }
+
+  simulator_arrival_t *arrivals = malloc(state->job_count * sizeof(simulator_arrival_t));
+  for (i = 0; i < state->job_count; i++) {
+    arrivals[i].arrival_time = state->jobs.arrival_time[i];
+    arrivals[i].job_id = i;
   }
+  qsort(arrivals, state->job_count, sizeof(simulator_arrival_t), compare_arrival);
+  for (i = 0; i < state->job_count; i++)
+    state->arrival_order[i] = arrivals[i].job_id;
+  free(arrivals);
+}
 
+void print_available_cores(int cores) {
+  printf("Active cores are: ");
 
-  int job_id = 0;
-  int jobs_ct = 10;
-  simulator_job_list_t *jobs = malloc(jobs_ct * sizeof(simulator_job_list_t));
+  int i;
+  for (i = 0; i < cores; i++) {
+    if (i == cores - 1)
+      printf("%d\n", i);
+    else
+      printf("%d, ", i);
+  }
+}
 
-  char line[1024 + 1];
-  fgets(line, 1024, file);  // Ignore the first (header) line
-  while (fgets(line, 1024, file) != NULL) {
-    char *arrival_time = strtok(line, ",");
-    char *run_time = strtok(NULL, ",");
-    char *priority = strtok(NULL, ",");
 
-    if (arrival_time != NULL && run_time != NULL && priority != NULL) {
-      if (job_id == jobs_ct) {
-        jobs_ct *= 2;
-        jobs = realloc(jobs, jobs_ct * sizeof(simulator_job_list_t));
+void init_state(simulator_state_t *state, int cores) {
+  state->job_count = 0;
+  state->job_capacity = 16;
+  memset(&state->jobs, 0, sizeof(simulator_job_table_t));
+  job_table_resize(&state->jobs, state->job_capacity);
+  state->active_jobs = 0;
+  state->active_capacity = 16;
+  state->active_slots = malloc(state->active_capacity * sizeof(int));
+  state->running = malloc(cores * sizeof(int));
+  state->core_remaining = malloc(cores * sizeof(int));
+  state->arrival_order = NULL;
+  state->next_arrival = 0;
+  state->reader = NULL;
+  state->has_next_job = 0;
+  state->job_index = NULL;
+  state->free_jobs = NULL;
+  state->free_job_count = 0;
+  state->arrivals = NULL;
+}
 
-        if (!jobs) {
-          fprintf(stderr, "Out of memory.\n");
-          return 2;
-        }
-      }
+/*
+ * Gives a state its own copy of every job of a loaded trace.
+ */
+void load_jobs(simulator_state_t *state, const trace_t *trace) {
+  int i;
 
-      jobs[job_id].job_id = job_id;
-      jobs[job_id].arrival_time = atoi(arrival_time);
-      jobs[job_id].run_time = atoi(run_time);
-      jobs[job_id].priority = atoi(priority);
-      jobs[job_id].core_id = -1;
-      jobs[job_id].arrived = 0;
+  state->job_capacity = trace->count + 1;
+  job_table_resize(&state->jobs, state->job_capacity);
+  for (i = 0; i < trace->count; i++)
+    add_job(state, &trace->jobs[i]);
 
-      job_id++;
-    }
-    else {
-      fprintf(stderr, "Illegal file format.\n");
-      return 2;
+  state->arrival_order = malloc((state->job_count + 1) * sizeof(int));
+  build_arrival_order(state);
+}
+
+void free_state(simulator_state_t *state) {
+  job_table_free(&state->jobs);
+  free(state->active_slots);
+  free(state->running);
+  free(state->core_remaining);
+  free(state->arrival_order);
+  free(state->job_index);
+  free(state->free_jobs);
+  free(state->arrivals);
+}
+
+/*
+ * Writes the whole state of a simulation to a checkpoint: the options it
+ * cannot be resumed without, the job table, the cores, the clock and pending
+ * events of the main loop, the timing diagram (if one is kept) and the
+ * scheduler.  Only loaded traces are checkpointed, so the job table is
+ * indexed by job_id.
+ */
+void save_checkpoint(FILE *file,
+                     simulator_options_t *options,
+                     simulator_state_t *state,
+                     int time,
+                     int jobs_alive,
+                     int *quantum_clock,
+                     uint64_t *finished_cores,
+                     uint64_t *expired_cores,
+                     diagram_t *diagram,
+                     scheduler_t *scheduler) {
+  simulator_job_table_t *jobs = &state->jobs;
+  int cores = options->cores, has_diagram = (diagram != NULL);
+
+  CHECKPOINT_SAVE(file, options->cores);
+  CHECKPOINT_SAVE(file, options->scheme);
+  CHECKPOINT_SAVE(file, options->quantum);
+  CHECKPOINT_SAVE(file, options->per_core);
+  CHECKPOINT_SAVE(file, options->aging);
+  CHECKPOINT_SAVE(file, has_diagram);
+
+  CHECKPOINT_SAVE(file, state->job_count);
+  CHECKPOINT_SAVE_ARRAY(file, jobs->arrival_time, state->job_count);
+  CHECKPOINT_SAVE_ARRAY(file, jobs->run_time, state->job_count);
+  CHECKPOINT_SAVE_ARRAY(file, jobs->remaining_time, state->job_count);
+  CHECKPOINT_SAVE_ARRAY(file, jobs->priority, state->job_count);
+  CHECKPOINT_SAVE_ARRAY(file, jobs->core_id, state->job_count);
+  CHECKPOINT_SAVE_ARRAY(file, jobs->start_time, state->job_count);
+  CHECKPOINT_SAVE_ARRAY(file, jobs->arrived, state->job_count);
+  CHECKPOINT_SAVE_ARRAY(file, jobs->slot, state->job_count);
+  CHECKPOINT_SAVE(file, state->active_jobs);
+  CHECKPOINT_SAVE_ARRAY(file, state->active_slots, state->active_jobs);
+  CHECKPOINT_SAVE(file, state->next_arrival);
+  CHECKPOINT_SAVE_ARRAY(file, state->arrival_order, state->job_count);
+  CHECKPOINT_SAVE_ARRAY(file, state->running, cores);
+  CHECKPOINT_SAVE_ARRAY(file, state->core_remaining, cores);
+
+  CHECKPOINT_SAVE(file, time);
+  CHECKPOINT_SAVE(file, jobs_alive);
+  CHECKPOINT_SAVE_ARRAY(file, quantum_clock, cores);
+  CHECKPOINT_SAVE_ARRAY(file, finished_cores, (cores + 63) / 64);
+  CHECKPOINT_SAVE_ARRAY(file, expired_cores, (cores + 63) / 64);
+
+  if (diagram != NULL)
+    diagram_save(diagram, file);
+  scheduler_save_r(scheduler, file);
+}
+
+/*
+ * Reads the options saved at the start of a checkpoint, and whether it has a
+ * timing diagram, into options.  Returns 0 on success or -1 if the checkpoint
+ * is malformed.
+ */
+int load_checkpoint_options(FILE *file, simulator_options_t *options) {
+  if (CHECKPOINT_LOAD(file, options->cores) != 1 || CHECKPOINT_LOAD(file, options->scheme) != 1 ||
+      CHECKPOINT_LOAD(file, options->quantum) != 1 || CHECKPOINT_LOAD(file, options->per_core) != 1 ||
+      CHECKPOINT_LOAD(file, options->aging) != 1 || CHECKPOINT_LOAD(file, options->has_diagram) != 1)
+    return -1;
+
+  if (options->cores <= 0 || options->scheme < FCFS || options->scheme > MLFQ || options->quantum < 0)
+    return -1;
+
+  return 0;
+}
+
+/*
+ * Reads the rest of a checkpoint, after load_checkpoint_options(), into a
+ * state set up by init_state() and the clock and pending events of the main
+ * loop.  The timing diagram is read into diagram, or skipped if diagram is
+ * NULL.  Returns the scheduler, or NULL if the checkpoint is malformed, in
+ * which case diagram is left uninitialized.
+ */
+scheduler_t *load_checkpoint(FILE *file,
+                             simulator_options_t *options,
+                             simulator_state_t *state,
+                             int *time,
+                             int *jobs_alive,
+                             int *quantum_clock,
+                             uint64_t *finished_cores,
+                             uint64_t *expired_cores,
+                             diagram_t *diagram) {
+  simulator_job_table_t *jobs = &state->jobs;
+  int i, count, cores = options->cores;
+  diagram_t skipped;
+
+  if (CHECKPOINT_LOAD(file, count) != 1 || count < 0 || count == INT_MAX)
+    return NULL;
+
+  state->job_count = count;
+  state->job_capacity = count + 1;
+  job_table_resize(jobs, state->job_capacity);
+  state->active_capacity = count + 1;
+  state->active_slots = realloc(state->active_slots, state->active_capacity * sizeof(int));
+  state->arrival_order = malloc((count + 1) * sizeof(int));
+  for (i = 0; i < count; i++)
+    jobs->job_id[i] = i;
+
+  if (CHECKPOINT_LOAD_ARRAY(file, jobs->arrival_time, count) != (size_t)count ||
+      CHECKPOINT_LOAD_ARRAY(file, jobs->run_time, count) != (size_t)count ||
+      CHECKPOINT_LOAD_ARRAY(file, jobs->remaining_time, count) != (size_t)count ||
+      CHECKPOINT_LOAD_ARRAY(file, jobs->priority, count) != (size_t)count ||
+      CHECKPOINT_LOAD_ARRAY(file, jobs->core_id, count) != (size_t)count ||
+      CHECKPOINT_LOAD_ARRAY(file, jobs->start_time, count) != (size_t)count ||
+      CHECKPOINT_LOAD_ARRAY(file, jobs->arrived, count) != (size_t)count ||
+      CHECKPOINT_LOAD_ARRAY(file, jobs->slot, count) != (size_t)count ||
+      CHECKPOINT_LOAD(file, state->active_jobs) != 1 || state->active_jobs < 0 || state->active_jobs > count ||
+      CHECKPOINT_LOAD_ARRAY(file, state->active_slots, state->active_jobs) != (size_t)state->active_jobs ||
+      CHECKPOINT_LOAD(file, state->next_arrival) != 1 || state->next_arrival < 0 || state->next_arrival > count ||
+      CHECKPOINT_LOAD_ARRAY(file, state->arrival_order, count) != (size_t)count ||
+      CHECKPOINT_LOAD_ARRAY(file, state->running, cores) != (size_t)cores ||
+      CHECKPOINT_LOAD_ARRAY(file, state->core_remaining, cores) != (size_t)cores)
+    return NULL;
+
+  // Every job_id in the state indexes the job table
+  for (i = 0; i < count; i++)
+    if (state->arrival_order[i] < 0 || state->arrival_order[i] >= count || jobs->slot[i] < -1 ||
+        jobs->slot[i] >= state->active_jobs || jobs->core_id[i] < -1 || jobs->core_id[i] >= cores)
+      return NULL;
+  for (i = 0; i < state->active_jobs; i++)
+    if (state->active_slots[i] < 0 || state->active_slots[i] >= count)
+      return NULL;
+  for (i = 0; i < cores; i++)
+    if (state->running[i] < -1 || state->running[i] >= count)
+      return NULL;
+
+  if (CHECKPOINT_LOAD(file, *time) != 1 || CHECKPOINT_LOAD(file, *jobs_alive) != 1 ||
+      CHECKPOINT_LOAD_ARRAY(file, quantum_clock, cores) != (size_t)cores ||
+      CHECKPOINT_LOAD_ARRAY(file, finished_cores, (cores + 63) / 64) != (size_t)(cores + 63) / 64 ||
+      CHECKPOINT_LOAD_ARRAY(file, expired_cores, (cores + 63) / 64) != (size_t)(cores + 63) / 64)
+    return NULL;
+
+  if (options->has_diagram) {
+    diagram_t *target = (diagram != NULL) ? diagram : &skipped;
+    int loaded = diagram_load(target, file);
+    int diagram_cores = target->cores;
+    if (loaded != 0 || diagram_cores != cores) {
+      diagram_destroy(target);
+      return NULL;
     }
+    if (diagram == NULL)
+      diagram_destroy(&skipped);
   }
 
-  fclose(file);
+  scheduler_t *scheduler = scheduler_load(file);
+  if (scheduler == NULL && diagram != NULL && options->has_diagram)
+    diagram_destroy(diagram);
+  return scheduler;
+}
 
+/*
+ * Returns the quantum a core starts with when it is given a job: the quantum
+ * of RR, or the quantum of the job's level under MLFQ.
+ */
+int start_quantum(scheduler_t *scheduler, int scheme, int quantum, int core_id) {
+  return (scheme == MLFQ) ? scheduler_quantum_r(scheduler, core_id) : quantum;
+}
 
-  /*
-	 * Run the simulation.
-	 */
+/*
+ * Records in events, unless it is NULL, that job_id arrived on core_id and
+ * preempted the job running there, if there is one.
+ */
+void record_preemption(eventlog_t *events, int time, int core_id, int job_id, simulator_state_t *state) {
+  if (events == NULL)
+    return;
+  if (state->running[core_id] != -1)
+    eventlog_record(events, EVENTLOG_PREEMPT, time, core_id, state->running[core_id]);
+  eventlog_record(events, EVENTLOG_DISPATCH, time, core_id, job_id);
+}
 
-  printf("Loaded %d core(s) and %d job(s) using ", cores, job_id);
-  if (scheme == FCFS) {
-    printf("First Come First Served (FCFS)");
-  }
-  else if (scheme == SJF) {
-    printf("Non-preemptive Shortest Job First (SJF)");
-  }
-  else if (scheme == PSJF) {
-    printf("Preemptive Shortest Job First (PSJF)");
-  }
-  else if (scheme == PRI) {
-    printf("Non-preemptive Priority (PRI)");
-  }
-  else if (scheme == PPRI) {
-    printf("Preemptive Priority (PPRI)");
-  }
-  else if (scheme == RR) {
-    printf("Round Robin (RR) with a quantum of %d", quantum);
+/*
+ * Runs a whole simulation of the jobs in state with its own scheduler_t.
+ * Returns the exit status of the simulator (0 on success, 2 for a malformed
+ * streamed trace, 3 if the scheduler misbehaved) and fills in result.
+ */
+int simulate(simulator_options_t *options, simulator_state_t *state, simulator_result_t *result) {
+  int cores = options->cores, scheme = options->scheme, quantum = options->quantum;
+  int event_driven = options->event_driven, quiet = options->quiet, compressed = options->compressed;
+  char *export_name = options->export_name;
+  simulator_job_table_t *jobs = &state->jobs;
+  int i, j, status = 0;
+
+  result->metrics = NULL;
+
+  scheduler_t *scheduler = NULL;
+  if (options->resume == NULL) {
+    scheduler = scheduler_create_mode(cores, scheme, options->per_core ? SCHEDULER_PER_CORE_QUEUES : SCHEDULER_GLOBAL_QUEUE);
+    if (scheme == MLFQ)
+      scheduler_set_mlfq_r(scheduler, SCHEDULER_MLFQ_LEVELS, quantum, SCHEDULER_MLFQ_BOOST_QUANTA * quantum);
+    if (scheme == PRI || scheme == PPRI)
+      scheduler_set_aging_r(scheduler, options->aging);
   }
-  printf(" scheduling...\n\n");
 
-  scheduler_start_up(cores, scheme);
 
 
-  int time = 0, i, j;
-  int active_jobs = job_id, jobs_alive = 0;
+  int time = 0;
+  int jobs_alive = 0;
 
   int *quantum_clock = malloc(cores * sizeof(int));
-  char **core_timing_diagram = malloc(cores * sizeof(char *));
-  int core_timing_diagram_size = 1024;
+  int *events = malloc(cores * sizeof(int));
+  uint64_t *finished_cores = calloc((cores + 63) / 64, sizeof(uint64_t));
+  uint64_t *expired_cores = calloc((cores + 63) / 64, sizeof(uint64_t));
+  scheduler_arrival_t *batch = NULL;
+  int *batch_cores = NULL;
+  int batch_capacity = 0;
+  diagram_t diagram;
+
+  // Quiet mode only keeps a diagram that will be printed or exported
+  int keep_diagram = !quiet || compressed || export_name != NULL;
+  if (keep_diagram && options->resume == NULL)
+    diagram_init(&diagram, cores);
 
   for (i = 0; i < cores; i++) {
     quantum_clock[i] = -1;
-    core_timing_diagram[i] = malloc(core_timing_diagram_size + 1);
-    core_timing_diagram[i][0] = '\0';
+    state->running[i] = -1;
   }
 
-  while (active_jobs > 0) {
-    printf("=== [TIME %d] ===\n", time);
+  // A resumed simulation carries on from the top of the loop, where the checkpoint was taken
+  if (options->resume != NULL) {
+    scheduler = load_checkpoint(options->resume,
+                                options,
+                                state,
+                                &time,
+                                &jobs_alive,
+                                quantum_clock,
+                                finished_cores,
+                                expired_cores,
+                                keep_diagram ? &diagram : NULL);
+    if (scheduler == NULL) {
+      fprintf(stderr, "Illegal checkpoint format.\n");
+      status = 2;
+      goto cleanup;
+    }
+
+    // The jobs running when the checkpoint was taken start their slices again
+    if (options->events != NULL)
+      for (i = 0; i < cores; i++)
+        if (state->running[i] != -1)
+          eventlog_record(options->events, EVENTLOG_DISPATCH, time, i, state->running[i]);
+  }
+
+  while (state->active_jobs > 0 || state->has_next_job) {
+    FILE *checkpoint;
+    if (options->checkpoint != NULL && (checkpoint = checkpoint_begin(options->checkpoint)) != NULL) {
+      save_checkpoint(checkpoint,
+                      options,
+                      state,
+                      time,
+                      jobs_alive,
+                      quantum_clock,
+                      finished_cores,
+                      expired_cores,
+                      keep_diagram ? &diagram : NULL,
+                      scheduler);
+      checkpoint_commit(options->checkpoint);
+    }
+
+    if (!quiet)
+      printf("=== [TIME %d] ===\n", time);
 
     /*
 		 * 1. Check if any jobs finished in the last time unit.
 		 */
-    for (i = 0; i < active_jobs; i++) {
-      if (jobs[i].run_time == 0) {
-        // Notify the scheduler has finished
-        int job_id = jobs[i].job_id;
-        int core_id = jobs[i].core_id;
-        int new_job_id = scheduler_job_finished(jobs[i].core_id, jobs[i].job_id, time);
-
-        if (scheme == RR)
-          quantum_clock[jobs[i].core_id] = quantum;
-
-        // Delete the finished jobs, decrease the number of active jobs
-        if (i != active_jobs - 1)
-          memcpy(&jobs[i], &jobs[active_jobs - 1], sizeof(simulator_job_list_t));
-        active_jobs--;
-        jobs_alive--;
-        i--;
-
-        // Set the new job
-        if (new_job_id != -1 && !set_active_job(new_job_id, core_id, jobs, active_jobs)) {
-          printf("The scheduler_job_finished() selected an invalid job (job_id == %d).\n", new_job_id);
-          print_available_jobs(jobs, active_jobs);
-          return 3;
-        }
-        else {
-          printf("Job %d, running on core %d, finished. Core %d is now running job %d.\n",
-                 job_id,
-                 core_id,
-                 core_id,
-                 new_job_id);
-          printf("  Queue: ");
-          scheduler_show_queue();
-          printf("\n\n");
-        }
+    int event_count = 0;
+    for (i = 0; i < (cores + 63) / 64; i++)
+      for (uint64_t bits = finished_cores[i]; bits != 0; bits &= bits - 1)
+        events[event_count++] = state->running[i * 64 + __builtin_ctzll(bits)];
+
+    while (event_count > 0) {
+      // Deliver the finished job in the lowest slot first; finishing a job moves another job into its slot
+      sort_by_slot(events, event_count, state);
+      int job_id = events[0];
+      int core_id = jobs->core_id[find_job(state, job_id)];
+      memmove(events, events + 1, --event_count * sizeof(int));
+
+      // Notify the scheduler has finished
+      int new_job_id = scheduler_job_finished_r(scheduler, core_id, job_id, time);
+
+      if (scheme == RR || scheme == MLFQ)
+        quantum_clock[core_id] = start_quantum(scheduler, scheme, quantum, core_id);
+
+      // Delete the finished jobs, decrease the number of active jobs
+      finish_job(job_id, state);
+      jobs_alive--;
+
+      if (options->events != NULL) {
+        eventlog_record(options->events, EVENTLOG_FINISH, time, core_id, job_id);
+        if (new_job_id != -1)
+          eventlog_record(options->events, EVENTLOG_DISPATCH, time, core_id, new_job_id);
+      }
+
+      // Set the new job
+      if (new_job_id != -1 && !set_active_job(new_job_id, core_id, time, state)) {
+        printf("The scheduler_job_finished() selected an invalid job (job_id == %d).\n", new_job_id);
+        print_available_jobs(state);
+        status = 3;
+        goto cleanup;
+      }
+      else if (!quiet) {
+        printf("Job %d, running on core %d, finished. Core %d is now running job %d.\n",
+               job_id,
+               core_id,
+               core_id,
+               new_job_id);
+        printf("  Queue: ");
+        scheduler_show_queue_r(scheduler);
+        printf("\n\n");
       }
     }
 
     /*
 		 * Check to see if we finished our last job.  (If we don't check here, we would run an extra time unit that will be totally idle.)
 		 */
-    if (active_jobs == 0)
+    if (state->active_jobs == 0 && !state->has_next_job)
       break;
 
     /*
 		 * 2. Check of any quantums expired in the last time unit.
 		 */
-    if (scheme == RR) {
-      for (i = 0; i < cores; i++) {
-        if (quantum_clock[i] == 0) {
-          for (j = 0; j < active_jobs; j++) {
-            if (jobs[j].core_id == i) {
-              // Notify the scheduler the quantum has expired
-              int core_id = jobs[j].core_id;
-              int old_job_id = jobs[j].job_id;
-              int new_job_id = scheduler_quantum_expired(jobs[j].core_id, time);
-
-              jobs[j].core_id = -1;
-
-              quantum_clock[core_id] = quantum;
-
-              // Set the new job
-              if (new_job_id != -1 && !set_active_job(new_job_id, core_id, jobs, active_jobs)) {
-                printf("The scheduler_quantum_expired() selected an invalid job (job_id == %d).\n", new_job_id);
-                print_available_jobs(jobs, active_jobs);
-                return 3;
-              }
-              else {
-                printf("Job %d, running on core %d, had its quantum expire. Core %d is now running job %d.\n",
-                       old_job_id,
-                       core_id,
-                       core_id,
-                       new_job_id);
-                printf("  Queue: ");
-                scheduler_show_queue();
-                printf("\n\n");
-              }
-
-              break;
-            }
+    if (scheme == RR || scheme == MLFQ) {
+      for (i = 0; i < (cores + 63) / 64; i++) {
+        for (uint64_t bits = expired_cores[i]; bits != 0; bits &= bits - 1) {
+          int core_id = i * 64 + __builtin_ctzll(bits);
+
+          // A core emptied by a finished job in step 1 has a fresh quantum or no job
+          if (quantum_clock[core_id] != 0 || state->running[core_id] == -1)
+            continue;
+
+          // Notify the scheduler the quantum has expired
+          int old_job_id = state->running[core_id];
+          int new_job_id = scheduler_quantum_expired_r(scheduler, core_id, time);
+
+          clear_core(core_id, state);
+
+          quantum_clock[core_id] = start_quantum(scheduler, scheme, quantum, core_id);
+
+          if (options->events != NULL) {
+            eventlog_record(options->events, EVENTLOG_EXPIRE, time, core_id, old_job_id);
+            if (new_job_id != -1)
+              eventlog_record(options->events, EVENTLOG_DISPATCH, time, core_id, new_job_id);
+          }
+
+          // Set the new job
+          if (new_job_id != -1 && !set_active_job(new_job_id, core_id, time, state)) {
+            printf("The scheduler_quantum_expired() selected an invalid job (job_id == %d).\n", new_job_id);
+            print_available_jobs(state);
+            status = 3;
+            goto cleanup;
+          }
+          else if (!quiet) {
+            printf("Job %d, running on core %d, had its quantum expire. Core %d is now running job %d.\n",
+                   old_job_id,
+                   core_id,
+                   core_id,
+                   new_job_id);
+            printf("  Queue: ");
+            scheduler_show_queue_r(scheduler);
+            printf("\n\n");
           }
         }
       }
@@ -331,118 +998,133 @@ int main(int argc, char **argv) {
     /*
 		 * 3. Check for any new jobs that arrive in this time unit
 		 */
-    for (i = 0; i < active_jobs; i++) {
-      if (jobs[i].arrival_time == time) {
-        int new_job_core_id = scheduler_new_job(jobs[i].job_id, time, jobs[i].run_time, jobs[i].priority);
-        jobs[i].arrived = 1;
+    int *arrivals;
+    int arrival_count = collect_arrivals(state, time, &arrivals);
+    if (arrival_count == -1) {
+      fprintf(stderr, "Illegal file format.\n");
+      status = 2;
+      goto cleanup;
+    }
+
+    if (quiet) {
+      // Nothing is printed between the arrivals, so they go to the scheduler in one batch
+      if (arrival_count > batch_capacity) {
+        batch_capacity = arrival_count;
+        batch = realloc(batch, batch_capacity * sizeof(scheduler_arrival_t));
+        batch_cores = realloc(batch_cores, batch_capacity * sizeof(int));
+      }
+      for (j = 0; j < arrival_count; j++) {
+        int job = find_job(state, arrivals[j]);
+        batch[j].job_number = arrivals[j];
+        batch[j].running_time = jobs->run_time[job];
+        batch[j].priority = jobs->priority[job];
+        jobs->arrived[job] = 1;
+        if (options->events != NULL)
+          eventlog_record(options->events, EVENTLOG_ARRIVE, time, -1, arrivals[j]);
+      }
+      jobs_alive += arrival_count;
+      scheduler_new_jobs_r(scheduler, batch, arrival_count, time, batch_cores);
+
+      for (j = 0; j < arrival_count; j++) {
+        int new_job_core_id = batch_cores[j];
+        if (new_job_core_id < -1 || new_job_core_id >= cores) {
+          printf("The scheduler_new_jobs() selected an invalid core (core_id == %d).\n", new_job_core_id);
+          print_available_cores(cores);
+          status = 3;
+          goto cleanup;
+        }
+        else if (new_job_core_id != -1) {
+          record_preemption(options->events, time, new_job_core_id, arrivals[j], state);
+          clear_core(new_job_core_id, state);
+          set_active_job(arrivals[j], new_job_core_id, time, state);
+
+          if (scheme == RR || scheme == MLFQ)
+            quantum_clock[new_job_core_id] = start_quantum(scheduler, scheme, quantum, new_job_core_id);
+        }
+      }
+    }
+    else {
+      for (j = 0; j < arrival_count; j++) {
+        int job_id = arrivals[j];
+        int job = find_job(state, job_id);
+        int new_job_core_id = scheduler_new_job_r(scheduler, job_id, time, jobs->run_time[job], jobs->priority[job]);
+        jobs->arrived[job] = 1;
         jobs_alive++;
+        if (options->events != NULL)
+          eventlog_record(options->events, EVENTLOG_ARRIVE, time, -1, job_id);
 
         if (new_job_core_id >= 0 && new_job_core_id < cores) {
           printf("A new job, job %d (running time=%d, priority=%d), arrived. Job %d is now running on core %d.\n",
-                 jobs[i].job_id,
-                 jobs[i].run_time,
-                 jobs[i].priority,
-                 jobs[i].job_id,
+                 job_id,
+                 jobs->run_time[job],
+                 jobs->priority[job],
+                 job_id,
                  new_job_core_id);
           printf("  Queue: ");
-          scheduler_show_queue();
+          scheduler_show_queue_r(scheduler);
           printf("\n\n");
 
           // Find if anyone is currently using the core.
-          for (j = 0; j < active_jobs; j++)
-            if (jobs[j].core_id == new_job_core_id)
-              jobs[j].core_id = -1;
+          record_preemption(options->events, time, new_job_core_id, job_id, state);
+          clear_core(new_job_core_id, state);
 
           // Assign the core to the new job
-          jobs[i].core_id = new_job_core_id;
+          set_active_job(job_id, new_job_core_id, time, state);
 
-          if (scheme == RR)
-            quantum_clock[new_job_core_id] = quantum;
+          if (scheme == RR || scheme == MLFQ)
+            quantum_clock[new_job_core_id] = start_quantum(scheduler, scheme, quantum, new_job_core_id);
         }
         else if (new_job_core_id == -1) {
           printf("A new job, job %d (running time=%d, priority=%d), arrived. Job %d is set to idle (-1).\n",
-                 jobs[i].job_id,
-                 jobs[i].run_time,
-                 jobs[i].priority,
-                 jobs[i].job_id);
+                 job_id,
+                 jobs->run_time[job],
+                 jobs->priority[job],
+                 job_id);
           printf("  Queue: ");
-          scheduler_show_queue();
+          scheduler_show_queue_r(scheduler);
           printf("\n\n");
         }
         else {
           printf("The scheduler_new_job() selected an invalid core (core_id == %d).\n", new_job_core_id);
           print_available_cores(cores);
-          return 3;
+          status = 3;
+          goto cleanup;
         }
       }
     }
 
 
     /*
-		 * 4. Run the time unit.
+		 * 4. Run the time unit.  (In event-driven mode, run every time unit up to the next event at once.)
 		 */
-    char time_string[cores][11];
-    int cores_working = 0;
-
-    for (i = 0; i < cores; i++)
-      time_string[i][0] = '\0';
-
-    for (i = 0; i < active_jobs; i++) {
-      if (jobs[i].core_id != -1) {
-        cores_working++;
-        jobs[i].run_time--;
-        quantum_clock[jobs[i].core_id]--;
-
-        assert(time_string[jobs[i].core_id][0] == '\0');
-
-        if (jobs[i].job_id < 10)
-          sprintf(time_string[jobs[i].core_id], "%d", jobs[i].job_id);
-        else if (jobs[i].job_id < 10 + 26)
-          sprintf(time_string[jobs[i].core_id], "%c", jobs[i].job_id - 10 + 'a');
-        else if (jobs[i].job_id < 10 + 26 + 26)
-          sprintf(time_string[jobs[i].core_id], "%c", jobs[i].job_id - 10 - 26 + 'A');
-        else
-          snprintf(time_string[jobs[i].core_id], 10, "(%d)", jobs[i].job_id);
-      }
-    }
-
-    for (i = 0; i < cores; i++) {
-      // If the core is idle, print a '-'
-      if (time_string[i][0] == '\0')
-        strcpy(time_string[i], "-");
-
-      // Ensure we have enough memory
-      while (strlen(core_timing_diagram[i]) + strlen(time_string[i]) >= (unsigned int)core_timing_diagram_size) {
-        core_timing_diagram_size *= 2;
+    int delta = event_driven ? time_until_next_event(time, scheme, cores, quantum_clock, state) : 1;
+    int cores_working = run_cores(cores, delta, state->running, state->core_remaining, quantum_clock, finished_cores, expired_cores);
 
-        for (j = 0; j < cores; j++) {
-          core_timing_diagram[j] = realloc(core_timing_diagram[j], core_timing_diagram_size + 1);
-
-          if (core_timing_diagram[j] == NULL) {
-            fprintf(stderr, "Out of memory.\n");
-            return 3;
-          }
-        }
-      }
-
-      strcat(core_timing_diagram[i], time_string[i]);
-    }
+    // An idle core is drawn as '-'
+    if (keep_diagram)
+      for (i = 0; i < cores; i++)
+        diagram_append(&diagram, i, state->running[i], delta);
 
 
     /*
 		 * 5. Print data!
 		 */
-    printf("At the end of time unit %d...\n", time);
+    if (!quiet) {
+      printf("At the end of time unit %d...\n", time + delta - 1);
 
-    for (i = 0; i < cores; i++)
-      printf("  Core %2d: %s\n", i, core_timing_diagram[i]);
+      for (i = 0; i < cores; i++) {
+        printf("  Core %2d: ", i);
+        diagram_print_core(&diagram, i, stdout);
+        printf("\n");
+      }
 
-    printf("\n");
+      printf("\n");
 
-    printf("  Queue: ");
-    scheduler_show_queue();
-    printf("\n");
-    printf("\n");
+      printf("  Queue: ");
+      scheduler_show_queue_r(scheduler);
+      printf("\n");
+      printf("\n");
+    }
 
 
     /*
@@ -452,35 +1134,851 @@ int main(int argc, char **argv) {
 		 */
     if (jobs_alive > 0 && cores_working == 0) {
       printf("All cores are idle and at least one job remains unscheduled.\n");
-      print_available_jobs(jobs, active_jobs);
-      return 3;
+      print_available_jobs(state);
+      status = 3;
+      goto cleanup;
     }
 
 
     /*
 		 * 7. Increase time
 		 */
-    time++;
+    time += delta;
   }
 
 
-  printf("FINAL TIMING DIAGRAM:\n");
-  for (i = 0; i < cores; i++)
-    printf("  Core %2d: %s\n", i, core_timing_diagram[i]);
+  if (!quiet) {
+    printf("FINAL TIMING DIAGRAM:\n");
+    for (i = 0; i < cores; i++) {
+      printf("  Core %2d: ", i);
+      diagram_print_core(&diagram, i, stdout);
+      printf("\n");
+    }
 
-  printf("\n");
-  printf("Average Waiting Time: %.2f\n", scheduler_average_waiting_time());
-  printf("Average Turnaround Time: %.2f\n", scheduler_average_turnaround_time());
-  printf("Average Response Time: %.2f\n", scheduler_average_response_time());
+    printf("\n");
+  }
+  else if (compressed) {
+    printf("FINAL TIMING DIAGRAM:\n");
+    diagram_print_compressed(&diagram, stdout);
+
+    printf("\n");
+  }
 
-  scheduler_clean_up();
+  if (export_name != NULL) {
+    FILE *export_file = fopen(export_name, "w");
+    if (export_file == NULL || diagram_export(&diagram, export_file) != 0) {
+      fprintf(stderr, "Unable to write file \"%s\".\n", export_name);
+      if (export_file != NULL)
+        fclose(export_file);
+      status = 2;
+      goto cleanup;
+    }
+    fclose(export_file);
+  }
 
+  result->waiting_time = scheduler_average_waiting_time_r(scheduler);
+  result->turnaround_time = scheduler_average_turnaround_time_r(scheduler);
+  result->response_time = scheduler_average_response_time_r(scheduler);
+  scheduler_stats_r(scheduler, &result->stats);
+  if (options->metrics) {
+    result->metrics = malloc(sizeof(metrics_t));
+    metrics_init(result->metrics, cores);
+    metrics_merge(result->metrics, scheduler_metrics_r(scheduler));
+  }
+
+cleanup:
+  // A resumed simulation has no scheduler or diagram if its checkpoint could not be loaded
+  if (scheduler != NULL) {
+    scheduler_destroy(scheduler);
+    if (keep_diagram)
+      diagram_destroy(&diagram);
+  }
 
   free(quantum_clock);
-  for (i = 0; i < cores; i++)
-    free(core_timing_diagram[i]);
-  free(core_timing_diagram);
-  free(jobs);
+  free(events);
+  free(finished_cores);
+  free(expired_cores);
+  free(batch);
+  free(batch_cores);
 
-  return 0;
+  return status;
+}
+
+/*
+ * Prints the operation counters of a scheduler and its queues.
+ */
+void print_stats(const scheduler_stats_t *stats, FILE *file) {
+  const char *names[] = {"Queue", "Running Set"};
+  const priqueue_stats_t *queues[] = {&stats->queues, &stats->running};
+
+  fprintf(file, "Dispatches: %lu (%lu context switches)\n", stats->dispatches, stats->context_switches);
+  fprintf(file, "Preemptions: %lu\n", stats->preemptions);
+  fprintf(file, "Quantum Expirations: %lu\n", stats->quantum_expirations);
+  fprintf(file, "Job Allocations: %lu\n", stats->allocations);
+  fprintf(file, "Waiting Jobs High-Water Mark: %u\n", stats->waiting_high_water);
+  for (int i = 0; i < 2; i++) {
+    const priqueue_stats_t *queue = queues[i];
+    fprintf(file,
+            "%s: %lu operations, %lu comparisons, %.2f nodes traversed per operation, %lu allocations, high-water mark %u\n",
+            names[i],
+            queue->operations,
+            queue->comparisons,
+            (queue->operations == 0) ? 0.0 : (double)queue->traversed / (double)queue->operations,
+            queue->allocations,
+            queue->high_water);
+  }
+}
+
+void sweep_task(int task, void *arg) {
+  simulator_sweep_t *sweep = (simulator_sweep_t *)arg;
+  simulator_state_t state;
+
+  init_state(&state, sweep->configs[task].cores);
+  load_jobs(&state, sweep->trace);
+  sweep->results[task].status = simulate(&sweep->configs[task], &state, &sweep->results[task]);
+  free_state(&state);
+}
+
+/*
+ * Simulates the share of shard of shards of the sweep of every configuration
+ * over every trace, one trace at a time, and writes the metrics of each
+ * simulation to the summary summary_name.  configs[0..config_count - 1] are
+ * the configurations; their metrics are always collected.  Returns the exit
+ * status of the simulator.
+ */
+int run_shard(char **trace_names,
+              int trace_count,
+              simulator_options_t *configs,
+              int config_count,
+              int shard,
+              int shards,
+              int threads,
+              int quiet,
+              char *summary_name) {
+  int i, t, status = 0, write_failed = 0;
+
+  FILE *summary = fopen(summary_name, "wb");
+  if (summary == NULL) {
+    fprintf(stderr, "Unable to write file \"%s\".\n", summary_name);
+    return 2;
+  }
+  // The magic is filled in by shard_write_header()
+  shard_header_t header = {"", shard, shards, trace_count, config_count, configs[0].per_core, configs[0].aging};
+  write_failed = (shard_write_header(summary, &header) != 0);
+
+  int task_count = 0;
+  for (i = 0; i < trace_count * config_count; i++)
+    task_count += shard_owns(i, shard, shards);
+  if (!quiet)
+    printf("Shard %d of %d: simulating %d of %d configuration(s) over %d trace(s) on %d thread(s)...\n",
+           shard,
+           shards,
+           task_count,
+           trace_count * config_count,
+           trace_count,
+           threads);
+
+  // Only the configurations of this shard are simulated, each trace loaded once
+  simulator_options_t *owned = malloc(config_count * sizeof(simulator_options_t));
+  int *tasks = malloc(config_count * sizeof(int));
+  simulator_result_t *results = malloc(config_count * sizeof(simulator_result_t));
+  for (t = 0; t < trace_count; t++) {
+    int owned_count = 0;
+    for (i = 0; i < config_count; i++) {
+      if (shard_owns(t * config_count + i, shard, shards)) {
+        tasks[owned_count] = t * config_count + i;
+        owned[owned_count++] = configs[i];
+      }
+    }
+    if (owned_count == 0)
+      continue;
+
+    trace_t trace;
+    int loaded = trace_load(&trace, trace_names[t], 0);
+    if (loaded == -1) {
+      fprintf(stderr, "Unable to open file \"%s\".\n", trace_names[t]);
+      status = 2;
+      break;
+    }
+    if (loaded == -2) {
+      fprintf(stderr, "Illegal file format.\n");
+      status = 2;
+      break;
+    }
+
+    simulator_sweep_t sweep_state = {&trace, owned, results};
+    sweep_run(owned_count, threads, sweep_task, &sweep_state);
+
+    for (i = 0; i < owned_count; i++) {
+      shard_record_t record;
+      record.task = tasks[i];
+      record.cores = owned[i].cores;
+      record.scheme = owned[i].scheme;
+      record.quantum = owned[i].quantum;
+      record.status = results[i].status;
+      record.trace_name = trace_names[t];
+      if (results[i].metrics != NULL) {
+        record.metrics = *results[i].metrics;
+        free(results[i].metrics);
+      }
+      else
+        metrics_init(&record.metrics, 0);
+
+      write_failed |= (shard_write_record(summary, &record) != 0);
+      if (results[i].status != 0)
+        status = results[i].status;
+      metrics_destroy(&record.metrics);
+    }
+    trace_free(&trace);
+  }
+
+  // A summary that could not be written is worse than a failed simulation
+  if (fclose(summary) != 0 || write_failed) {
+    fprintf(stderr, "Unable to write file \"%s\".\n", summary_name);
+    status = 2;
+  }
+  free(owned);
+  free(tasks);
+  free(results);
+  return status;
+}
+
+/*
+ * Parses the argument of -c: a comma separated list of core counts and
+ * ranges of core counts (Eg: "1-4,8,16").  Returns the number of core counts,
+ * or -1 if one is not positive.
+ */
+int parse_cores(char *arg, int **cores) {
+  int count = 0, capacity = 16;
+  char *save, *token;
+
+  *cores = realloc(*cores, capacity * sizeof(int));
+  for (token = strtok_r(arg, ",", &save); token != NULL; token = strtok_r(NULL, ",", &save)) {
+    char *dash = strchr(token, '-');
+    int first = atoi(token);
+    int last = (dash != NULL) ? atoi(dash + 1) : first;
+
+    if (first <= 0 || last < first)
+      return -1;
+
+    for (; first <= last; first++) {
+      if (count == capacity) {
+        capacity *= 2;
+        *cores = realloc(*cores, capacity * sizeof(int));
+      }
+      (*cores)[count++] = first;
+    }
+  }
+
+  return (count == 0) ? -1 : count;
+}
+
+/*
+ * Parses the argument of -s: a comma separated list of schemes, where RR is
+ * followed by a quantum or a range of quanta (Eg: "fcfs,psjf,rr1-4"), and
+ * MLFQ may be followed by the quantum of its top level or a range of them.
+ * Unknown schemes are skipped.  Returns the number of schemes, or -1 if a
+ * quantum of RR or MLFQ is not positive or is too large.
+ */
+int parse_schemes(char *arg, int **schemes, int **quanta) {
+  int count = 0, capacity = 16;
+  char *save, *token;
+
+  *schemes = realloc(*schemes, capacity * sizeof(int));
+  *quanta = realloc(*quanta, capacity * sizeof(int));
+  for (token = strtok_r(arg, ",", &save); token != NULL; token = strtok_r(NULL, ",", &save)) {
+    int scheme = -1, first = 0, last = 0;
+
+    if (strcasecmp(token, "FCFS") == 0) {
+      scheme = FCFS;
+    }
+    else if (strcasecmp(token, "SJF") == 0) {
+      scheme = SJF;
+    }
+    else if (strcasecmp(token, "PSJF") == 0) {
+      scheme = PSJF;
+    }
+    else if (strcasecmp(token, "PRI") == 0) {
+      scheme = PRI;
+    }
+    else if (strcasecmp(token, "PPRI") == 0) {
+      scheme = PPRI;
+    }
+    else if (strncasecmp(token, "RR", 2) == 0) {
+      char *dash = strchr(token, '-');
+      scheme = RR;
+      first = atoi(token + 2);
+      last = (dash != NULL) ? atoi(dash + 1) : first;
+
+      if (first <= 0 || last < first)
+        return -1;
+    }
+    else if (strncasecmp(token, "MLFQ", 4) == 0) {
+      char *dash = strchr(token, '-');
+      scheme = MLFQ;
+      first = (token[4] != '\0') ? atoi(token + 4) : SCHEDULER_MLFQ_QUANTUM;
+      last = (dash != NULL) ? atoi(dash + 1) : first;
+
+      // The boost period is a multiple of the quantum, so it has to fit in an int too
+      if (first <= 0 || last < first || last > INT_MAX / SCHEDULER_MLFQ_BOOST_QUANTA)
+        return -1;
+    }
+
+    if (scheme == -1)
+      continue;
+
+    for (; first <= last; first++) {
+      if (count == capacity) {
+        capacity *= 2;
+        *schemes = realloc(*schemes, capacity * sizeof(int));
+        *quanta = realloc(*quanta, capacity * sizeof(int));
+      }
+      (*schemes)[count] = scheme;
+      (*quanta)[count++] = first;
+    }
+  }
+
+  return count;
+}
+
+/*
+ * Writes the name of a scheme as it is given to -s (Eg: "psjf", "rr4", "mlfq2").
+ */
+void scheme_name(int scheme, int quantum, char *name) {
+  const char *names[] = {"fcfs", "sjf", "psjf", "pri", "ppri", "rr", "mlfq"};
+
+  if (scheme == RR || scheme == MLFQ)
+    sprintf(name, "%s%d", names[scheme], quantum);
+  else
+    strcpy(name, names[scheme]);
+}
+
+int main(int argc, char **argv) {
+  int c;
+  int cores = 0, scheme = -1, quantum = 0, event_driven = 0, streaming = 0, quiet = 0, compressed = 0, per_core = 0, metrics = 0, aging = 0;
+  int core_count = 0, scheme_count = 0, threads = 0;
+  int *core_list = NULL, *scheme_list = NULL, *quantum_list = NULL;
+  char *export_name = NULL, *checkpoint_name = NULL, *resume_name = NULL, *events_name = NULL, *summary_name = NULL;
+  int shard = 0, shards = 1, sharded = 0;
+  int checkpoint_interval = SIMULATOR_CHECKPOINT_INTERVAL;
+  char *file_name;
+  struct option long_options[] = {{"checkpoint", required_argument, NULL, OPTION_CHECKPOINT},
+                                  {"checkpoint-interval", required_argument, NULL, OPTION_CHECKPOINT_INTERVAL},
+                                  {"resume", required_argument, NULL, OPTION_RESUME},
+                                  {"events", required_argument, NULL, OPTION_EVENTS},
+                                  {"shard", required_argument, NULL, OPTION_SHARD},
+                                  {"summary", required_argument, NULL, OPTION_SUMMARY},
+                                  {NULL, 0, NULL, 0}};
+
+  /*
+	 * Parse command line options.
+	 */
+  while ((c = getopt_long(argc, argv, "c:s:elqdx:j:pma:", long_options, NULL)) != -1) {
+    switch (c) {
+      case 'c':
+        core_count = parse_cores(optarg, &core_list);
+
+        if (core_count == -1) {
+          fprintf(stderr, "Option -c <cores> require a positive number.\n");
+          print_usage(argv[0]);
+          return 1;
+        }
+        break;
+
+      case 's':
+        scheme_count = parse_schemes(optarg, &scheme_list, &quantum_list);
+
+        if (scheme_count == -1) {
+          fprintf(stderr, "Option -s <scheme> requires a positive number for the quantum of RR or MLFQ. (Eg: -s RR2)\n");
+          print_usage(argv[0]);
+          return 1;
+        }
+        break;
+
+      case 'e':
+        event_driven = 1;
+        break;
+
+      case 'l':
+        streaming = 1;
+        break;
+
+      case 'q':
+        quiet = 1;
+        break;
+
+      case 'd':
+        compressed = 1;
+        break;
+
+      case 'x':
+        export_name = optarg;
+        break;
+
+      case 'p':
+        per_core = 1;
+        break;
+
+      case 'm':
+        metrics = 1;
+        break;
+
+      case 'a':
+        aging = atoi(optarg);
+
+        if (aging <= 0) {
+          fprintf(stderr, "Option -a <interval> requires a positive number.\n");
+          print_usage(argv[0]);
+          return 1;
+        }
+        break;
+
+      case OPTION_CHECKPOINT:
+        checkpoint_name = optarg;
+        break;
+
+      case OPTION_CHECKPOINT_INTERVAL:
+        checkpoint_interval = atoi(optarg);
+
+        if (checkpoint_interval < 0 || (checkpoint_interval == 0 && strcmp(optarg, "0") != 0)) {
+          fprintf(stderr, "Option --checkpoint-interval <seconds> requires a number.\n");
+          print_usage(argv[0]);
+          return 1;
+        }
+        break;
+
+      case OPTION_RESUME:
+        resume_name = optarg;
+        break;
+
+      case OPTION_EVENTS:
+        events_name = optarg;
+        break;
+
+      case OPTION_SHARD:
+        sharded = 1;
+
+        if (shard_parse(optarg, &shard, &shards) != 0) {
+          fprintf(stderr, "Option --shard <i>/<n> requires a shard index from 0 to n - 1. (Eg: --shard 3/16)\n");
+          print_usage(argv[0]);
+          return 1;
+        }
+        break;
+
+      case OPTION_SUMMARY:
+        summary_name = optarg;
+        break;
+
+      case 'j':
+        threads = atoi(optarg);
+
+        if (threads <= 0) {
+          fprintf(stderr, "Option -j <threads> requires a positive number.\n");
+          print_usage(argv[0]);
+          return 1;
+        }
+        break;
+
+      case '?':
+        print_usage(argv[0]);
+        return 1;
+
+      default:
+        printf("....\n");
+        break;
+    }
+  }
+
+  if (resume_name != NULL && (core_count != 0 || scheme_count != 0 || streaming || per_core || aging != 0)) {
+    fprintf(stderr, "Options -c, -s, -l, -p and -a cannot be used with --resume, they are restored from the checkpoint.\n");
+    print_usage(argv[0]);
+    return 1;
+  }
+
+  if (core_count == 0 && resume_name == NULL) {
+    fprintf(stderr, "Required option -c <cores> is not present.\n");
+    print_usage(argv[0]);
+    return 1;
+  }
+
+  if (scheme_count == 0 && resume_name == NULL) {
+    fprintf(stderr, "Required option -s <scheme> is not present.\n");
+    print_usage(argv[0]);
+    return 1;
+  }
+
+  if (compressed && !quiet) {
+    fprintf(stderr, "Option -d requires option -q.\n");
+    print_usage(argv[0]);
+    return 1;
+  }
+
+  if (sharded && summary_name == NULL) {
+    fprintf(stderr, "Option --shard requires option --summary.\n");
+    print_usage(argv[0]);
+    return 1;
+  }
+
+  if (summary_name != NULL && (resume_name != NULL || streaming || compressed || export_name != NULL ||
+                               checkpoint_name != NULL || events_name != NULL)) {
+    fprintf(stderr, "Options --resume, -l, -d, -x, --checkpoint and --events cannot be used with --summary.\n");
+    print_usage(argv[0]);
+    return 1;
+  }
+
+  int sweep = (core_count * scheme_count > 1);
+  if (sweep && (streaming || compressed || export_name != NULL || checkpoint_name != NULL || events_name != NULL)) {
+    fprintf(stderr, "Options -l, -d, -x, --checkpoint and --events cannot be used with more than one configuration.\n");
+    print_usage(argv[0]);
+    return 1;
+  }
+
+  if (streaming && checkpoint_name != NULL) {
+    fprintf(stderr, "Option --checkpoint cannot be used with -l.\n");
+    print_usage(argv[0]);
+    return 1;
+  }
+
+  if (resume_name == NULL) {
+    cores = core_list[0];
+    scheme = scheme_list[0];
+    quantum = quantum_list[0];
+  }
+
+  // Nothing is printed between events, so skip straight to them
+  if (quiet)
+    event_driven = 1;
+
+  if (resume_name != NULL) {
+    file_name = resume_name;
+    if (optind != argc) {
+      fprintf(stderr, "Option --resume does not take an input file.\n");
+      print_usage(argv[0]);
+      return 1;
+    }
+  }
+  else if (summary_name != NULL && optind == argc) {
+    fprintf(stderr, "At least one input file is required.\n");
+    print_usage(argv[0]);
+    return 1;
+  }
+  else if (optind == argc - 1 || summary_name != NULL)
+    file_name = argv[optind];
+  else {
+    fprintf(stderr, "A single input file is required.\n");
+    print_usage(argv[0]);
+    return 1;
+  }
+
+
+  if (summary_name != NULL) {
+    /*
+     * Sweep this shard of every configuration over every input file.
+     */
+    int config_count = core_count * scheme_count;
+    simulator_options_t *configs = malloc(config_count * sizeof(simulator_options_t));
+
+    for (int i = 0; i < config_count; i++) {
+      configs[i].cores = core_list[i / scheme_count];
+      configs[i].scheme = scheme_list[i % scheme_count];
+      configs[i].quantum = quantum_list[i % scheme_count];
+      configs[i].event_driven = 1;
+      configs[i].quiet = 1;
+      configs[i].compressed = 0;
+      configs[i].per_core = per_core;
+      configs[i].export_name = NULL;
+      configs[i].metrics = 1;
+      configs[i].aging = aging;
+      configs[i].checkpoint = NULL;
+      configs[i].resume = NULL;
+      configs[i].has_diagram = 0;
+      configs[i].events = NULL;
+    }
+
+    int status = run_shard(&argv[optind],
+                           argc - optind,
+                           configs,
+                           config_count,
+                           shard,
+                           shards,
+                           (threads == 0) ? sweep_threads() : threads,
+                           quiet,
+                           summary_name);
+    free(configs);
+    free(core_list);
+    free(scheme_list);
+    free(quantum_list);
+    return status;
+  }
+
+
+  /*
+	 * Open the file, read the file, and populate the jobs data structure.
+	 */
+  trace_reader_t reader;
+  trace_t trace;
+  FILE *resume_file = NULL;
+  simulator_options_t resumed;
+  int loaded = 0;
+
+  memset(&resumed, 0, sizeof(resumed));
+  if (resume_name != NULL) {
+    // Only the options are read now, the rest of the checkpoint is read by simulate()
+    loaded = checkpoint_open(&resume_file, file_name);
+    if (loaded == 0 && load_checkpoint_options(resume_file, &resumed) != 0) {
+      fclose(resume_file);
+      loaded = -2;
+    }
+  }
+  else if (streaming)
+    loaded = trace_open(&reader, file_name);
+  else
+    loaded = trace_load(&trace, file_name, 0);
+
+  if (loaded == -1) {
+    fprintf(stderr, "Unable to open file \"%s\".\n", file_name);
+    return 2;
+  }
+  if (loaded == -2) {
+    fprintf(stderr, "Illegal file format.\n");
+    return 2;
+  }
+
+  int i;
+
+  if (resume_name != NULL) {
+    cores = resumed.cores;
+    scheme = resumed.scheme;
+    quantum = resumed.quantum;
+    per_core = resumed.per_core;
+    aging = resumed.aging;
+
+    if (!resumed.has_diagram && (!quiet || compressed || export_name != NULL)) {
+      fprintf(stderr, "The checkpoint has no timing diagram, so it can only be resumed with -q and without -d or -x.\n");
+      print_usage(argv[0]);
+      return 1;
+    }
+  }
+
+  if (sweep) {
+    /*
+     * Sweep every configuration over the loaded trace, which is shared read-only.
+     */
+    int config_count = core_count * scheme_count;
+    simulator_options_t *configs = malloc(config_count * sizeof(simulator_options_t));
+    simulator_result_t *results = malloc(config_count * sizeof(simulator_result_t));
+    simulator_sweep_t sweep_state = {&trace, configs, results};
+    int status = 0;
+
+    for (i = 0; i < config_count; i++) {
+      configs[i].cores = core_list[i / scheme_count];
+      configs[i].scheme = scheme_list[i % scheme_count];
+      configs[i].quantum = quantum_list[i % scheme_count];
+      configs[i].event_driven = 1;
+      configs[i].quiet = 1;
+      configs[i].compressed = 0;
+      configs[i].per_core = per_core;
+      configs[i].export_name = NULL;
+      configs[i].metrics = metrics;
+      configs[i].aging = aging;
+      configs[i].checkpoint = NULL;
+      configs[i].resume = NULL;
+      configs[i].has_diagram = 0;
+      configs[i].events = NULL;
+    }
+
+    if (threads == 0)
+      threads = sweep_threads();
+    if (!quiet)
+      printf("Loaded %d job(s) and sweeping %d configuration(s) on %d thread(s)...\n\n",
+             trace.count,
+             config_count,
+             (threads < config_count) ? threads : config_count);
+
+    sweep_run(config_count, threads, sweep_task, &sweep_state);
+
+    printf("%5s  %-8s  %10s  %10s  %10s", "Cores", "Scheme", "Waiting", "Turnaround", "Response");
+    if (metrics)
+      printf("  %11s  %12s", "p99 Waiting", "p99 Response");
+    printf("\n");
+    for (i = 0; i < config_count; i++) {
+      char name[16];
+      scheme_name(configs[i].scheme, configs[i].quantum, name);
+
+      if (results[i].status != 0) {
+        printf("%5d  %-8s  %10s  %10s  %10s", configs[i].cores, name, "failed", "failed", "failed");
+        if (metrics)
+          printf("  %11s  %12s", "failed", "failed");
+        status = results[i].status;
+      }
+      else {
+        printf("%5d  %-8s  %10.2f  %10.2f  %10.2f",
+               configs[i].cores,
+               name,
+               results[i].waiting_time,
+               results[i].turnaround_time,
+               results[i].response_time);
+        if (metrics)
+          printf("  %11lld  %12lld",
+                 (long long)histogram_percentile(&results[i].metrics->waiting, 99),
+                 (long long)histogram_percentile(&results[i].metrics->response, 99));
+      }
+      printf("\n");
+
+      if (results[i].metrics != NULL) {
+        metrics_destroy(results[i].metrics);
+        free(results[i].metrics);
+      }
+    }
+
+    trace_free(&trace);
+    free(configs);
+    free(results);
+    free(core_list);
+    free(scheme_list);
+    free(quantum_list);
+    return status;
+  }
+
+  simulator_state_t state;
+  init_state(&state, cores);
+
+  if (streaming) {
+    // Only the first job is read now, the rest are read as they arrive
+    state.reader = &reader;
+    state.job_index_capacity = 2 * state.job_capacity;
+    state.job_index = malloc(state.job_index_capacity * sizeof(int));
+    for (i = 0; i < state.job_index_capacity; i++)
+      state.job_index[i] = -1;
+    state.free_jobs = malloc(state.job_capacity * sizeof(int));
+    for (i = state.job_capacity; i > 0; i--)
+      state.free_jobs[state.free_job_count++] = i - 1;
+    state.arrivals_capacity = 16;
+    state.arrivals = malloc(state.arrivals_capacity * sizeof(int));
+
+    if (read_next_job(&state) == -1) {
+      fprintf(stderr, "Illegal file format.\n");
+      return 2;
+    }
+  }
+  else if (resume_name == NULL) {
+    load_jobs(&state, &trace);
+    trace_free(&trace);
+  }
+
+
+  /*
+	 * Run the simulation.
+	 */
+
+  if (!quiet) {
+    if (resume_name != NULL)
+      printf("Resuming %d core(s) from \"%s\" using ", cores, resume_name);
+    else if (streaming)
+      printf("Loaded %d core(s) and streaming jobs using ", cores);
+    else
+      printf("Loaded %d core(s) and %d job(s) using ", cores, state.job_count);
+    if (scheme == FCFS) {
+      printf("First Come First Served (FCFS)");
+    }
+    else if (scheme == SJF) {
+      printf("Non-preemptive Shortest Job First (SJF)");
+    }
+    else if (scheme == PSJF) {
+      printf("Preemptive Shortest Job First (PSJF)");
+    }
+    else if (scheme == PRI) {
+      printf("Non-preemptive Priority (PRI)");
+    }
+    else if (scheme == PPRI) {
+      printf("Preemptive Priority (PPRI)");
+    }
+    else if (scheme == RR) {
+      printf("Round Robin (RR) with a quantum of %d", quantum);
+    }
+    else if (scheme == MLFQ) {
+      printf("Multi-level Feedback Queue (MLFQ) with %d levels, a quantum of %d doubling at each level and a boost every %d",
+             SCHEDULER_MLFQ_LEVELS,
+             quantum,
+             SCHEDULER_MLFQ_BOOST_QUANTA * quantum);
+    }
+    if (aging > 0 && (scheme == PRI || scheme == PPRI))
+      printf(" with aging every %d time units", aging);
+    if (per_core)
+      printf(" with per-core queues");
+    printf(" scheduling...\n\n");
+  }
+
+  checkpoint_writer_t checkpoint;
+  if (checkpoint_name != NULL)
+    checkpoint_writer_init(&checkpoint, checkpoint_name, checkpoint_interval);
+
+  // A .json file is a Chrome trace, anything else the compact binary format
+  eventlog_t events;
+  if (events_name != NULL) {
+    size_t length = strlen(events_name);
+    int chrome = (length >= 5 && strcmp(events_name + length - 5, ".json") == 0);
+    if (eventlog_open(&events, events_name, chrome ? EVENTLOG_CHROME : EVENTLOG_BINARY) != 0) {
+      fprintf(stderr, "Unable to write file \"%s\".\n", events_name);
+      return 2;
+    }
+  }
+
+  simulator_options_t options = {cores,
+                                 scheme,
+                                 quantum,
+                                 event_driven,
+                                 quiet,
+                                 compressed,
+                                 per_core,
+                                 export_name,
+                                 metrics,
+                                 aging,
+                                 (checkpoint_name != NULL) ? &checkpoint : NULL,
+                                 resume_file,
+                                 resumed.has_diagram,
+                                 (events_name != NULL) ? &events : NULL};
+  simulator_result_t result;
+  int status = simulate(&options, &state, &result);
+
+  // A checkpoint or event log that could not be written does not spoil the results, but is still an error
+  int checkpoint_failed = 0;
+  if (resume_file != NULL)
+    fclose(resume_file);
+  if (checkpoint_name != NULL && checkpoint_writer_destroy(&checkpoint) != 0) {
+    fprintf(stderr, "Unable to write file \"%s\".\n", checkpoint_name);
+    checkpoint_failed = 1;
+  }
+  if (events_name != NULL && eventlog_close(&events) != 0) {
+    fprintf(stderr, "Unable to write file \"%s\".\n", events_name);
+    checkpoint_failed = 1;
+  }
+  if (status != 0)
+    return status;
+
+  printf("Average Waiting Time: %.2f\n", result.waiting_time);
+  printf("Average Turnaround Time: %.2f\n", result.turnaround_time);
+  printf("Average Response Time: %.2f\n", result.response_time);
+  if (result.metrics != NULL) {
+    printf("\n");
+    metrics_print(result.metrics, stdout);
+    metrics_destroy(result.metrics);
+    free(result.metrics);
+  }
+#ifdef STATS
+  // On stderr, so the output can still be compared with the examples
+  fprintf(stderr, "\n");
+  print_stats(&result.stats, stderr);
+#endif
+
+
+  if (streaming)
+    trace_close(&reader);
+
+  free_state(&state);
+  free(core_list);
+  free(scheme_list);
+  free(quantum_list);
+
+  return checkpoint_failed ? 2 : 0;
 }